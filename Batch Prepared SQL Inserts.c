@@ -14,38 +14,40 @@
   limitations under the License.
 */
 
+/*
+  Loads flights with batches of prepared INSERTs. Besides the sources of
+  the other loaders (see flight_reader.h) it needs the throttle, the
+  retries and the batch sizing:
+
+    cc "Batch Prepared SQL Inserts.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c \
+       csv_scan.c flight_direct.c flight_decompress.c flight_schema.c flight_binder.c load_parts.c load_rollup.c \
+       load_options.c load_cluster.c load_stats.c latency_histogram.c load_checkpoint.c load_throttle.c \
+       load_retry.c load_batch.c -lcassandra -lz -lzstd -lpthread
+*/
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "cassandra.h"
 
-struct Flight_ { 
-	int		id;
-	int		year;
-	int		day_of_month;
-	char	fl_date[11];
-	int 	airline_id;
-	char 	carrier[3];
-	int 	fl_num;
-	int 	origin_airport_id;
-	char 	origin[4];
-	char	origin_city_name[20];
-	char	origin_state_abr[4];
-	char	dest[4];
-	char	dest_city_name[20];
-	char	dest_state_abr[4];
-	int		dep_time;
-	int		arr_time;
-	int		actual_elapsed_time;
-	int		air_time;
-	int		distance;
-} ;        
-
-typedef struct Flight_ Flight;
+#include "flight_binder.h"
+#include "flight_pipeline.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_batch.h"
+#include "load_checkpoint.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_parts.h"
+#include "load_rollup.h"
+#include "load_retry.h"
+#include "load_stats.h"
+#include "load_throttle.h"
 
 void print_error(CassFuture* future) {
   CassString message = cass_future_error_message(future);
@@ -53,12 +55,6 @@ void print_error(CassFuture* future) {
 }
 
 
-CassCluster* create_cluster() {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, "127.0.0.1");
-  return cluster;
-}
-
 CassError connect_session(CassCluster* cluster, CassSession** output) {
   CassError rc = CASS_OK;
   CassFuture* future = cass_cluster_connect(cluster);
@@ -82,6 +78,8 @@ CassError execute_stmt(CassSession* session, const char* query) {
   CassFuture* future = NULL;
   CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
 
+  load_cluster_apply(statement);
+
   future = cass_session_execute(session, statement);
   cass_future_wait(future);
 
@@ -116,51 +114,589 @@ CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared
 	return rc;
 }
 
-CassError batch_add_prepared_stmt(CassBatch* batch, const CassPrepared * prepared, Flight* flight) {
+/*
+  A batch being built and the pooled statements it references. The batch
+  holds references to its statements, so they go back to the binder only
+  once the batch has been executed. The rows themselves are needed to
+  replay the batch or reject its rows, so they must stay valid until it
+  has been sent for good.
+*/
+struct PendingBatch_ {
+	CassBatchType type;
+	CassBatch* batch;
+	CassStatement* statements[LOAD_BATCH_MAX_ROWS];
+	const Flight* flights[LOAD_BATCH_MAX_ROWS];
+	int num_rows;
+	size_t bytes;
+} ;
+
+typedef struct PendingBatch_ PendingBatch;
+
+void pending_batch_init(PendingBatch* pending, CassBatchType type) {
+	pending->type = type;
+	pending->batch = cass_batch_new(type);
+	load_cluster_apply_batch(pending->batch);
+	pending->num_rows = 0;
+	pending->bytes = 0;
+}
+
+void batch_add_prepared_stmt(PendingBatch* pending, FlightBinder* binder, const Flight* flight, size_t row_bytes) {
+	long long start = load_stats_now();
+	CassStatement* statement = flight_binder_acquire(binder);
+
+	flight_binder_bind(binder, statement, flight);
+	cass_batch_add_statement(pending->batch, statement);
+	load_stats_stage(LOAD_STAGE_BIND, start);
+
+	pending->statements[pending->num_rows] = statement;
+	pending->flights[pending->num_rows++] = flight;
+	pending->bytes += row_bytes;
+}
+
+/* Binds the rows of a batch that has been sent into a new batch of the same type. */
+void pending_batch_rebind(PendingBatch* pending, FlightBinder* binder) {
+	int num_rows = pending->num_rows;
+	size_t bytes = pending->bytes;
+	int i;
+
+	pending_batch_init(pending, pending->type);
+	for(i = 0; i < num_rows; ++i) {
+		batch_add_prepared_stmt(pending, binder, pending->flights[i], 0);
+	}
+	pending->bytes = bytes;
+}
+
+CassError execute_batch(CassSession* session, CassBatch* batch) {
 	CassError rc = CASS_OK;
-	CassStatement* statement = NULL;
-
-	statement = cass_prepared_bind(prepared);
-
-	cass_statement_bind_int32(statement, 0, flight->id);
-	cass_statement_bind_int32(statement, 1, flight->year);
-	cass_statement_bind_int32(statement, 2, flight->day_of_month);
-	cass_statement_bind_string(statement, 3, cass_string_init(flight->fl_date));
-	cass_statement_bind_int32(statement, 4, flight->airline_id);
-	cass_statement_bind_string(statement, 5, cass_string_init(flight->carrier));
-	cass_statement_bind_int32(statement, 6, flight->fl_num);
-	cass_statement_bind_int32(statement, 7, flight->origin_airport_id);
-	cass_statement_bind_string(statement, 8, cass_string_init(flight->origin));
-	cass_statement_bind_string(statement, 9, cass_string_init(flight->origin_city_name));
-	cass_statement_bind_string(statement, 10, cass_string_init(flight->origin_state_abr));
-	cass_statement_bind_string(statement, 11, cass_string_init(flight->dest));
-	cass_statement_bind_string(statement, 12, cass_string_init(flight->dest_city_name));
-	cass_statement_bind_string(statement, 13, cass_string_init(flight->dest_state_abr));
-	cass_statement_bind_int32(statement, 14, flight->dep_time);
-	cass_statement_bind_int32(statement, 15, flight->arr_time);
-	cass_statement_bind_int32(statement, 16, flight->actual_elapsed_time);
-	cass_statement_bind_int32(statement, 17, flight->air_time);
-	cass_statement_bind_int32(statement, 18, flight->distance);
-	cass_statement_bind_int32(statement, 19, (flight->air_time/10));
-  
-  	cass_batch_add_statement(batch, statement);
+	long long start = load_stats_now();
+	long long t = 0;
+	CassFuture* future = cass_session_execute_batch(session, batch);
+
+	t = load_stats_stage(LOAD_STAGE_SUBMIT, start);
+	cass_future_wait(future);
+	load_stats_stage(LOAD_STAGE_AWAIT, t);
+
+	rc = cass_future_error_code(future);
+	load_stats_request(start, rc);
+	if(rc != CASS_OK) {
+		print_error(future);
+	}
+
+	cass_future_free(future);
+
+	return rc;
+}
+
+double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+struct LoadContext_ {
+	CassSession* session;
+	const CassPrepared* prepared;
+	int partition_batches;
+	double max_batch_age;
+	int adaptive_batches;
+	size_t max_batch_bytes;
+	double target_latency;
+	LoadThrottle* throttle;
+	LoadRetry* retry;
+
+	pthread_mutex_t lock;
+	LoadBatchSizer totals;
+	double final_row_limits;
+	int num_sizers;
+} ;
+
+typedef struct LoadContext_ LoadContext;
+
+/* Folds a finished thread's sizer into the summary. */
+void batch_sizer_merge(LoadContext* context, const LoadBatchSizer* sizer) {
+	pthread_mutex_lock(&context->lock);
+	load_batch_sizer_merge(&context->totals, sizer);
+	context->final_row_limits += sizer->row_limit;
+	context->num_sizers++;
+	pthread_mutex_unlock(&context->lock);
+}
+
+void sleep_until(long long due) {
+	long long wait = due - load_stats_now();
+	struct timespec ts;
+
+	if(wait > 0) {
+		ts.tv_sec = (time_t)(wait / 1000000000LL);
+		ts.tv_nsec = (long)(wait % 1000000000LL);
+		nanosleep(&ts, NULL);
+	}
+}
+
+/* Failed batches a thread keeps for replay before it stops reading to wait for them. */
+#define BATCH_REPLAY_MAX 8
+
+/*
+  A batch that failed with a transient error and waits out its backoff.
+  It keeps copies of its rows, since the buffer it was built from is
+  reused, and is bound again into a new batch when it is replayed. rows
+  is kept for the next batch parked here.
+*/
+struct ParkedBatch_ {
+	PendingBatch pending;
+	FlightRow* rows;
+	size_t first;		/* input offset of its oldest row */
+	int attempts;
+	long long due;
+	int busy;
+} ;
+
+typedef struct ParkedBatch_ ParkedBatch;
+
+/* What a thread sends its batches with, including the batches parked for replay. */
+struct BatchSender_ {
+	LoadContext*		context;
+	LoadBatchSizer*		sizer;
+	FlightBinder*		binder;
+	ParkedBatch			parked[BATCH_REPLAY_MAX];
+	int					num_parked;
+} ;
+
+typedef struct BatchSender_ BatchSender;
+
+void batch_sender_init(BatchSender* sender, LoadContext* context, LoadBatchSizer* sizer, FlightBinder* binder) {
+	memset(sender, 0, sizeof(BatchSender));
+	sender->context = context;
+	sender->sizer = sizer;
+	sender->binder = binder;
+}
+
+void batch_sender_destroy(BatchSender* sender) {
+	int i;
+
+	for(i = 0; i < BATCH_REPLAY_MAX; ++i) {
+		free(sender->parked[i].rows);
+	}
+}
+
+/*
+  Executes the batch once, feeding its latency to the sizer, and recycles
+  its statements. The rows stay in pending for a retry or a reject.
+*/
+CassError send_pending(BatchSender* sender, PendingBatch* pending) {
+	LoadContext* context = sender->context;
+	double start = 0;
+	CassError rc = CASS_OK;
+	long long t = load_stats_now();
+	int i;
+
+	load_throttle_rate(context->throttle, pending->num_rows, pending->bytes);
+	load_throttle_begin(context->throttle);
+	load_stats_stage(LOAD_STAGE_AWAIT, t);
+
+	start = now_seconds();
+	rc = execute_batch(context->session, pending->batch);
+	load_throttle_end(context->throttle, rc);
+
+	load_batch_sizer_update(sender->sizer, rc, now_seconds() - start, pending->num_rows, pending->bytes);
+
+	cass_batch_free(pending->batch);
+	pending->batch = NULL;
+
+	for(i = 0; i < pending->num_rows; ++i) {
+		flight_binder_release(sender->binder, pending->statements[i]);
+	}
+
+	return rc;
+}
+
+void batch_reject(BatchSender* sender, const PendingBatch* pending, CassError rc) {
+	int i;
+
+	for(i = 0; i < pending->num_rows; ++i) {
+		load_retry_reject(sender->context->retry, pending->flights[i], cass_error_desc(rc));
+	}
+}
+
+/* Sends a parked batch again, and keeps it parked if it may be retried once more. */
+void batch_replay(BatchSender* sender, ParkedBatch* parked) {
+	LoadRetry* retry = sender->context->retry;
+	CassError rc = CASS_OK;
+
+	pending_batch_rebind(&parked->pending, sender->binder);
+	rc = send_pending(sender, &parked->pending);
+	parked->attempts++;
+
+	if(rc != CASS_OK && load_retry_should_retry(retry, rc, parked->attempts)) {
+		parked->due = load_retry_due(retry, parked->attempts);
+		return;
+	}
+	if(rc != CASS_OK) {
+		batch_reject(sender, &parked->pending, rc);
+	}
+	parked->busy = 0;
+	sender->num_parked--;
+}
+
+/* Replays every parked batch whose backoff has passed; called between reads. */
+void batch_replay_due(BatchSender* sender) {
+	long long now = load_stats_now();
+	int i;
+
+	for(i = 0; i < BATCH_REPLAY_MAX; ++i) {
+		if(sender->parked[i].busy && sender->parked[i].due <= now) {
+			batch_replay(sender, &sender->parked[i]);
+		}
+	}
+}
+
+/* Waits for the parked batch that is due first and replays it. */
+void batch_replay_next(BatchSender* sender) {
+	ParkedBatch* next = NULL;
+	long long t = 0;
+	int i;
+
+	for(i = 0; i < BATCH_REPLAY_MAX; ++i) {
+		if(sender->parked[i].busy && (next == NULL || sender->parked[i].due < next->due)) {
+			next = &sender->parked[i];
+		}
+	}
+	if(next == NULL) {
+		return;
+	}
+
+	t = load_stats_now();
+	sleep_until(next->due);
+	load_stats_stage(LOAD_STAGE_AWAIT, t);
+	batch_replay(sender, next);
+}
+
+/*
+  Copies the rows of a batch that failed after attempts tries into a
+  parked entry, waiting for a replay first if every entry is taken; this
+  is the only time a thread stops reading for its retries. Returns 0, or
+  -1 if the rows cannot be copied and must be retried while they are valid.
+*/
+int batch_park(BatchSender* sender, const PendingBatch* pending, size_t first, int attempts) {
+	ParkedBatch* parked = NULL;
+	int i;
+
+	while(sender->num_parked == BATCH_REPLAY_MAX) {
+		batch_replay_next(sender);
+	}
+	for(i = 0; parked == NULL; ++i) {
+		if(!sender->parked[i].busy) {
+			parked = &sender->parked[i];
+		}
+	}
+
+	if(parked->rows == NULL) {
+		parked->rows = malloc(LOAD_BATCH_MAX_ROWS * sizeof(FlightRow));
+		if(parked->rows == NULL) {
+			return -1;
+		}
+	}
+	for(i = 0; i < pending->num_rows; ++i) {
+		if(flight_row_copy(&parked->rows[i], pending->flights[i]) != 0) {
+			return -1;
+		}
+		parked->pending.flights[i] = &parked->rows[i].flight;
+	}
+	parked->pending.type = pending->type;
+	parked->pending.num_rows = pending->num_rows;
+	parked->pending.bytes = pending->bytes;
+	parked->first = first;
+	parked->attempts = attempts;
+	parked->due = load_retry_due(sender->context->retry, attempts);
+	parked->busy = 1;
+	sender->num_parked++;
+
+	return 0;
+}
+
+/*
+  Sends the batch, whose oldest row starts at input offset first. A batch
+  that fails with a transient error is parked and replayed after its
+  backoff while the thread goes on reading; a batch whose rows cannot be
+  copied for that is retried in place instead. Rows of a batch that fails
+  for good go to the reject file.
+*/
+void send_batch(BatchSender* sender, PendingBatch* pending, size_t first) {
+	LoadRetry* retry = sender->context->retry;
+	CassError rc = send_pending(sender, pending);
+	long long t = 0;
+	int attempts = 1;
+
+	while(rc != CASS_OK && load_retry_should_retry(retry, rc, attempts)) {
+		if(batch_park(sender, pending, first, attempts) == 0) {
+			return;
+		}
+		t = load_stats_now();
+		sleep_until(load_retry_due(retry, attempts));
+		load_stats_stage(LOAD_STAGE_AWAIT, t);
+		pending_batch_rebind(pending, sender->binder);
+		rc = send_pending(sender, pending);
+		attempts++;
+	}
+
+	if(rc != CASS_OK) {
+		batch_reject(sender, pending, rc);
+	}
+}
+
+/* Offset below which every row is sent: done, or the oldest parked row if it starts earlier. */
+size_t batch_done_offset(const BatchSender* sender, size_t done) {
+	int i;
+
+	for(i = 0; i < BATCH_REPLAY_MAX; ++i) {
+		if(sender->parked[i].busy && sender->parked[i].first < done) {
+			done = sender->parked[i].first;
+		}
+	}
+
+	return done;
+}
+
+void send_partition(void* data, FlightRow* const* rows, int num_rows, size_t first) {
+	BatchSender* sender = (BatchSender*)data;
+	PendingBatch pending;
+	int i;
+
+	pending_batch_init(&pending, CASS_BATCH_TYPE_UNLOGGED);
+	for(i = 0; i < num_rows; ++i) {
+		batch_add_prepared_stmt(&pending, sender->binder, &rows[i]->flight,
+			flight_payload_bytes(&rows[i]->flight));
+	}
+	send_batch(sender, &pending, first);
+}
+
+/*
+  Buffers each row with the others for its carrier so every batch stays
+  within one partition and can skip the batchlog.
+*/
+void load_part_by_partition(LoadPart* part, BatchSender* sender) {
+	LoadContext* context = (LoadContext*)part->context;
+	LoadPartitions partitions;
+	Flight flight;
+	size_t row_bytes = 0;
+	size_t read = flight_reader_offset(part->reader);
+	size_t begin = 0;
+
+	load_partitions_init(&partitions, sender->sizer, context->max_batch_age, send_partition, sender);
+
+	while(load_stats_next(part->reader, &flight)) {
+		load_rollup_add(&part->rollup, &flight);
+		begin = read;
+		read = flight_reader_offset(part->reader);
+		part->rows++;
+		row_bytes = flight_payload_bytes(&flight);
+
+		if(sender->num_parked > 0) {
+			batch_replay_due(sender);
+		}
+
+		if(load_partitions_add(&partitions, &flight, row_bytes, begin) != 0) {
+			/* Cannot be buffered; send it on its own, which is still one partition. */
+			PendingBatch pending;
+			pending_batch_init(&pending, CASS_BATCH_TYPE_UNLOGGED);
+			batch_add_prepared_stmt(&pending, sender->binder, &flight, row_bytes);
+			send_batch(sender, &pending, begin);
+		}
+
+		/* Also after a row sent on its own, so aging and checkpoints never skip a turn. */
+		if(part->rows % LOAD_BATCH_AGE_CHECK_ROWS == 0) {
+			load_partitions_age(&partitions);
+			load_checkpoint_update(part->checkpoint, part->part,
+				batch_done_offset(sender, load_partitions_done(&partitions, read)));
+		}
+	}
+
+	load_partitions_finish(&partitions);
+	while(sender->num_parked > 0) {
+		batch_replay_next(sender);
+	}
+	load_checkpoint_update(part->checkpoint, part->part, read);
+}
+
+/* Rows are copied while they wait in the batch, in case it has to be replayed or rejected. */
+void load_part_in_file_order(LoadPart* part, BatchSender* sender) {
+	FlightRow* rows = NULL;
+	Flight flight;
+	size_t row_bytes = 0;
+	size_t read = flight_reader_offset(part->reader);
+	size_t begin = 0;
+	size_t first = read;
+	PendingBatch pending;
+
+	rows = malloc(LOAD_BATCH_MAX_ROWS * sizeof(FlightRow));
+	if(rows == NULL) {
+		part->failed = 1;
+		return;
+	}
+	pending_batch_init(&pending, CASS_BATCH_TYPE_LOGGED);
+
+	while(load_stats_next(part->reader, &flight)) {
+		load_rollup_add(&part->rollup, &flight);
+		begin = read;
+		read = flight_reader_offset(part->reader);
+		row_bytes = flight_payload_bytes(&flight);
+		part->rows++;
+
+		if(sender->num_parked > 0) {
+			batch_replay_due(sender);
+		}
+
+		if ( load_batch_sizer_full(sender->sizer, pending.num_rows, pending.bytes, row_bytes)) {
+			send_batch(sender, &pending, first);
+			pending_batch_init(&pending, CASS_BATCH_TYPE_LOGGED);
+			/* Every row before this one was in the batch just sent, unless it is parked. */
+			load_checkpoint_update(part->checkpoint, part->part, batch_done_offset(sender, begin));
+		}
+
+		if(flight_row_copy(&rows[pending.num_rows], &flight) != 0) {
+			/* Cannot be kept; send it on its own while its view is still valid. */
+			PendingBatch single;
+			pending_batch_init(&single, CASS_BATCH_TYPE_LOGGED);
+			batch_add_prepared_stmt(&single, sender->binder, &flight, row_bytes);
+			send_batch(sender, &single, begin);
+			continue;
+		}
+
+		if(pending.num_rows == 0) {
+			first = begin;
+		}
+		batch_add_prepared_stmt(&pending, sender->binder, &rows[pending.num_rows].flight, row_bytes);
+
+		/* if (part->rows > 2478) break; */
+	}
+
+	if ( pending.num_rows > 0) {
+		send_batch(sender, &pending, first);
+	} else {
+		cass_batch_free(pending.batch);
+	}
+	while(sender->num_parked > 0) {
+		batch_replay_next(sender);
+	}
+	load_checkpoint_update(part->checkpoint, part->part, read);
+	free(rows);
+}
+
+/* Inserts one part of the file; runs on its own thread with --threads. */
+void load_part(LoadPart* part) {
+	LoadContext* context = (LoadContext*)part->context;
+	FlightBinder binder;
+	LoadBatchSizer sizer;
+	BatchSender sender;
+
+	if(flight_binder_init(&binder, context->prepared, LOAD_BATCH_MAX_ROWS) != 0) {
+		part->failed = 1;
+		return;
+	}
+	load_batch_sizer_init(&sizer, LOAD_BATCH_ROWS, context->adaptive_batches, context->max_batch_bytes,
+		context->target_latency);
+	batch_sender_init(&sender, context, &sizer, &binder);
 
-  	return rc;
+	if(context->partition_batches) {
+		load_part_by_partition(part, &sender);
+	} else {
+		load_part_in_file_order(part, &sender);
+	}
+
+	batch_sender_destroy(&sender);
+	batch_sizer_merge(context, &sizer);
+	flight_binder_destroy(&binder);
 }
 
-int main() {
-	Flight flight; 
-	/* char sql[1024]; */
+int main(int argc, char* argv[]) {
 	time_t start, stop;
+	char query[1024];
+	int num_threads = 1;
+	int num_parsers = 0;
+	int direct_io = 0;
+	double stats_interval = 10.0;
+	int partition_batches = 0;
+	int max_batch_age_ms = 1000;
+	int adaptive_batches = 0;
+	int max_batch_bytes = 5 * 1024;
+	int target_latency_ms = 20;
+	double max_rows_per_sec = 0.0;
+	double max_mb_per_sec = 0.0;
+	int failed = 0;
+	long rows = 0;
+	int resume = 0;
+	int rollup = 0;
+	const char* checkpoint_path = "flights_checkpoint.txt";
+	double checkpoint_interval = 5.0;
+	const char* input = "/Users/carybourgeois/flights_exercise/flights_from_pg.csv";
+	LoadCheckpoint checkpoint;
+	int max_retries = 5;
+	double retry_delay_ms = 100.0;
+	const char* reject_path = "flights_rejects.csv";
+	LoadContext context;
+	LoadThrottle throttle;
+	LoadRetry retry;
 
-	FILE *fp = fopen("/Users/carybourgeois/flights_exercise/flights_from_pg.csv", "r") ; 
-	
 	CassError rc = CASS_OK;
-	CassCluster* cluster = create_cluster();
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
 	CassSession* session = NULL;
 	CassFuture* close_future = NULL;
 	const CassPrepared* prepared = NULL;
 
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "flights CSV (optionally .gz or .zst, - for stdin), or a file from the binary converter" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "split the input across N threads" },
+		{ "--parser-threads", LOAD_OPTION_INT, &num_parsers, "parse the input ahead of the inserts on N more threads per reader" },
+		{ "--direct-io", LOAD_OPTION_FLAG, &direct_io, "read the input with O_DIRECT and io_uring read-ahead, bypassing the page cache" },
+		{ "--stats-interval", LOAD_OPTION_DOUBLE, &stats_interval, "print a stats line every N seconds, 0 for none" },
+		{ "--partition-batches", LOAD_OPTION_FLAG, &partition_batches,
+			"UNLOGGED batches of one carrier each instead of LOGGED batches in file order" },
+		{ "--batch-age-ms", LOAD_OPTION_INT, &max_batch_age_ms,
+			"with --partition-batches, send a partial batch after N ms (default 1000)" },
+		{ "--adaptive-batches", LOAD_OPTION_FLAG, &adaptive_batches,
+			"size batches from a byte budget and observed latency" },
+		{ "--batch-bytes", LOAD_OPTION_INT, &max_batch_bytes,
+			"with --adaptive-batches, payload budget per batch (default 5120)" },
+		{ "--batch-latency-ms", LOAD_OPTION_INT, &target_latency_ms,
+			"with --adaptive-batches, round trip to stay under (default 20)" },
+		{ "--max-rows-per-sec", LOAD_OPTION_DOUBLE, &max_rows_per_sec, "insert at most N rows per second, 0 for no limit" },
+		{ "--max-mb-per-sec", LOAD_OPTION_DOUBLE, &max_mb_per_sec, "send at most N MB of row data per second, 0 for no limit" },
+		{ "--max-retries", LOAD_OPTION_INT, &max_retries, "send a batch that failed with a transient error up to N more times" },
+		{ "--retry-delay-ms", LOAD_OPTION_DOUBLE, &retry_delay_ms, "backoff before the first retry, doubling per attempt" },
+		{ "--reject-file", LOAD_OPTION_STRING, &reject_path, "append rows that fail for good to this CSV file" },
+		{ "--resume", LOAD_OPTION_FLAG, &resume, "continue from the checkpoint file instead of dropping the table" },
+		{ "--checkpoint-file", LOAD_OPTION_STRING, &checkpoint_path, "where to save load progress (default flights_checkpoint.txt)" },
+		{ "--checkpoint-interval", LOAD_OPTION_DOUBLE, &checkpoint_interval, "save progress every N seconds, 0 for only at start and end" },
+		{ "--rollup", LOAD_OPTION_FLAG, &rollup, "also sum flights by carrier, origin and month into summary tables" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	flight_reader_set_parsers(num_parsers);
+	flight_reader_set_direct(direct_io);
+	if(rollup && resume) {
+		fprintf(stderr, "Error: --rollup needs the whole input, so it cannot be used with --resume\n");
+		return -1;
+	}
+	load_rollup_set_enabled(rollup);
+	if(load_checkpoint_init(&checkpoint, checkpoint_path, input, num_threads, resume) != 0) {
+		return -1;
+	}
+	if(load_throttle_init(&throttle, max_rows_per_sec, max_mb_per_sec * 1e6,
+		num_threads > 1 ? num_threads : 1) != 0) {
+		return -1;
+	}
+	if(load_retry_init(&retry, max_retries, retry_delay_ms, retry_delay_ms * 64, reject_path) != 0) {
+		return -1;
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
 	rc = connect_session(cluster, &session);
 	if(rc != CASS_OK) {
 		return -1;
@@ -173,83 +709,69 @@ int main() {
 	execute_stmt(session,
 					"USE exercise;");
 						
-	execute_stmt(session,
-					"DROP TABLE IF EXISTS flights;");
+	/* A resumed load keeps the rows already written; overlapping inserts just overwrite them. */
+	if(!resume) {
+		execute_stmt(session,
+						"DROP TABLE IF EXISTS flights;");
 					
-	execute_stmt(session,
-					"CREATE TABLE flights ( \
-						id int, year int, day_of_month int, fl_date varchar, \
-						airline_id int, carrier varchar, fl_num int, origin_airport_id int, \
-						origin varchar, origin_city_name varchar, origin_state_abr varchar, dest varchar, \
-						dest_city_name varchar, dest_state_abr varchar, dep_time int, arr_time int, \
-						actual_elapsed_time int, air_time int, distance int, air_time_grp int, \
-						PRIMARY KEY (carrier, origin, air_time_grp, id));");
+		execute_stmt(session,
+						"CREATE TABLE flights (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (" FLIGHT_SCHEMA_KEY "));");
+	}
+	if(rollup && load_rollup_create_tables(session) != 0) {
+		return -1;
+	}
 
  	time(&start);
  	
- 	if(prepare_stmt(session, "INSERT INTO flights \
- 								(id, year, day_of_month, fl_date, \
- 								airline_id, carrier, fl_num, origin_airport_id, \
- 								origin, origin_city_name, origin_state_abr, dest, \
- 								dest_city_name, dest_state_abr, dep_time, arr_time, \
- 								actual_elapsed_time, air_time, distance, air_time_grp) \
- 								VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);", 
- 								&prepared) != CASS_OK) { 
+ 	if(flight_schema_insert(query, sizeof(query), "flights") != 0 ||
+ 		prepare_stmt(session, query, &prepared) != CASS_OK) { 
  		return -1;
  	}
  	
- 	if ( fp != NULL ) {
- 		int rows = 0;
- 		int batch_rows = 0;
- 		CassFuture* future = NULL;
- 		CassBatch* batch = cass_batch_new(CASS_BATCH_TYPE_LOGGED);  
-   		while(!feof(fp)) {
-                  
-   			fscanf(fp, "%d, %d, %d, %[^,], %d, %[^,], %d, %d, %[^,], %[^,], %[^,], %[^,], %[^,], %[^,], %d, %d, %d, %d, %d \n", 
-      			&flight.id, &flight.year, &flight.day_of_month, flight.fl_date, 
-      			&flight.airline_id, flight.carrier, &flight.fl_num, &flight.origin_airport_id,
-      			flight.origin, flight.origin_city_name, flight.origin_state_abr, flight.dest,
-      			flight.dest_city_name, flight.dest_state_abr, &flight.dep_time, &flight.arr_time,
-      			&flight.actual_elapsed_time, &flight.air_time, &flight.distance);
-      			
-      		batch_add_prepared_stmt(batch, prepared, &flight);
-      		
-      		rows++;
-      		batch_rows++;
-      		if ( batch_rows == 100) {
-      			future = cass_session_execute_batch(session, batch);
-  				cass_future_wait(future);
-
-  				if(cass_future_error_code(future) != CASS_OK) {
-    				print_error(future);
-  				}
-
-  				cass_future_free(future);
-  				cass_batch_free(batch);
-  				
-  				batch = cass_batch_new(CASS_BATCH_TYPE_LOGGED);
-  				batch_rows = 0;
-      		}
-           
-        	/* if (rows > 2478) break; */
-                               
-		}  /* EOF */
-		
-		if ( batch_rows > 0) {
-      		future = cass_session_execute_batch(session, batch);
-  			cass_future_wait(future);
-
-  			if(cass_future_error_code(future) != CASS_OK) {
-    			print_error(future);
-  			}
-
-  			cass_future_free(future);
-  			cass_batch_free(batch);
-      	}
-      	 
-		printf("%d Records loaded.\n", rows);
-   
-	}  /* File exists */ 
+ 	context.session = session;
+ 	context.prepared = prepared;
+ 	context.partition_batches = partition_batches;
+ 	context.max_batch_age = max_batch_age_ms / 1000.0;
+ 	context.adaptive_batches = adaptive_batches;
+ 	context.max_batch_bytes = (size_t)max_batch_bytes;
+ 	context.target_latency = target_latency_ms / 1000.0;
+ 	context.throttle = &throttle;
+ 	context.retry = &retry;
+ 	pthread_mutex_init(&context.lock, NULL);
+ 	memset(&context.totals, 0, sizeof(context.totals));
+ 	context.final_row_limits = 0;
+ 	context.num_sizers = 0;
+ 	
+ 	load_checkpoint_start(&checkpoint, checkpoint_interval);
+ 	load_stats_start(stats_interval);
+ 	rows = load_parts_run(input, num_threads, &checkpoint, &context, load_part, &failed);
+	load_stats_stop();
+	if(rollup && load_rollup_write(session) != 0) {
+		failed = 1;
+	}
+	load_checkpoint_stop(&checkpoint);
+	printf("%ld Records loaded.\n", rows);
+	if(rollup) {
+		load_rollup_report();
+	}
+	flight_binder_report(rows);
+	load_stats_report();
+	load_cluster_report(&cluster_settings, stdout);
+	flight_pipeline_report();
+	load_throttle_report(&throttle);
+	load_retry_report(&retry);
+	printf("%ld Batches executed.\n", context.totals.batches);
+	if(context.totals.batches > 0) {
+		printf("Rows per batch min %d avg %.1f max %d; payload bytes per batch avg %.0f max %lu.\n",
+			context.totals.min_rows, (double)context.totals.rows / context.totals.batches,
+			context.totals.max_rows, context.totals.bytes / context.totals.batches,
+			(unsigned long)context.totals.max_batch_bytes);
+	}
+	if(adaptive_batches && context.num_sizers > 0) {
+		printf("Adaptive row limit ended at %.1f rows per batch (average over threads).\n",
+			context.final_row_limits / context.num_sizers);
+	}
+	load_checkpoint_report(&checkpoint);
 	
 	time(&stop);
  
@@ -259,9 +781,10 @@ int main() {
   	cass_future_wait(close_future);
 	cass_future_free(close_future);
 	cass_cluster_free(cluster);
+	load_checkpoint_destroy(&checkpoint);
+	load_throttle_destroy(&throttle);
+	load_retry_destroy(&retry);
 	
-	fclose( fp ); 
-	
-	return 0;   
+	return failed || retry.rejected > 0 ? -1 : 0;   
   
 }
@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Compares the fscanf format the loaders used to parse flights_from_pg.csv
+  with flight_reader using each csv_scan kernel, and optionally with the
+  same rows converted by "Flights Binary Converter.c". No cluster is needed:
+
+    cc -O2 "CSV Parse Benchmark.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c flight_direct.c \
+       flight_decompress.c csv_scan.c -lz -lzstd -lpthread
+    ./a.out [file] [iterations] [binary file]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "csv_scan.h"
+#include "flight_reader.h"
+
+#define DEFAULT_INPUT "/Users/carybourgeois/flights_exercise/flights_from_pg.csv"
+
+/* The char array layout Flight had before flight_reader, widened so long city names cannot overflow. */
+struct LegacyFlight_ {
+	int		id;
+	int		year;
+	int		day_of_month;
+	char	fl_date[32];
+	int 	airline_id;
+	char 	carrier[32];
+	int 	fl_num;
+	int 	origin_airport_id;
+	char 	origin[32];
+	char	origin_city_name[64];
+	char	origin_state_abr[32];
+	char	dest[32];
+	char	dest_city_name[64];
+	char	dest_state_abr[32];
+	int		dep_time;
+	int		arr_time;
+	int		actual_elapsed_time;
+	int		air_time;
+	int		distance;
+} ;
+
+typedef struct LegacyFlight_ LegacyFlight;
+
+struct BenchResult_ {
+	long			rows;
+	long long		checksum;
+	double			seconds;
+	unsigned long long	cycles;
+} ;
+
+typedef struct BenchResult_ BenchResult;
+
+static double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned long long now_cycles() {
+#if defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static void bench_fscanf(const char* data, size_t size, BenchResult* result) {
+	LegacyFlight flight;
+	FILE* fp = fmemopen((void*)data, size, "r");
+
+	memset(result, 0, sizeof(BenchResult));
+	if(fp == NULL) {
+		return;
+	}
+
+	result->seconds = now_seconds();
+	result->cycles = now_cycles();
+
+	while(!feof(fp)) {
+		if(fscanf(fp, "%d, %d, %d, %[^,], %d, %[^,], %d, %d, %[^,], %[^,], %[^,], %[^,], %[^,], %[^,], %d, %d, %d, %d, %d \n",
+			&flight.id, &flight.year, &flight.day_of_month, flight.fl_date,
+			&flight.airline_id, flight.carrier, &flight.fl_num, &flight.origin_airport_id,
+			flight.origin, flight.origin_city_name, flight.origin_state_abr, flight.dest,
+			flight.dest_city_name, flight.dest_state_abr, &flight.dep_time, &flight.arr_time,
+			&flight.actual_elapsed_time, &flight.air_time, &flight.distance) != 19) {
+			break;
+		}
+		result->rows++;
+		result->checksum += flight.id + flight.distance + (long long)strlen(flight.origin_city_name);
+	}
+
+	result->cycles = now_cycles() - result->cycles;
+	result->seconds = now_seconds() - result->seconds;
+	fclose(fp);
+}
+
+static void bench_reader(const char* path, BenchResult* result) {
+	Flight flight;
+	FlightReader* reader = flight_reader_open(path);
+
+	memset(result, 0, sizeof(BenchResult));
+	if(reader == NULL) {
+		return;
+	}
+
+	result->seconds = now_seconds();
+	result->cycles = now_cycles();
+
+	while(flight_reader_next(reader, &flight)) {
+		result->rows++;
+		result->checksum += flight.id + flight.distance + (long long)flight.origin_city_name.length;
+	}
+
+	result->cycles = now_cycles() - result->cycles;
+	result->seconds = now_seconds() - result->seconds;
+	flight_reader_close(reader);
+}
+
+static void report(const char* name, const BenchResult* result, size_t bytes) {
+	printf("%-8s %10ld rows %12.0f rows/sec %9.1f MB/s", name, result->rows,
+		result->rows / result->seconds, bytes / result->seconds / 1e6);
+	if(result->cycles > 0) {
+		printf(" %6.3f bytes/cycle", (double)bytes / (double)result->cycles);
+	}
+	printf("  checksum %lld\n", result->checksum);
+}
+
+int main(int argc, char* argv[]) {
+	const char* path = argc > 1 ? argv[1] : DEFAULT_INPUT;
+	int iterations = argc > 2 ? atoi(argv[2]) : 3;
+	const char* binary_path = argc > 3 ? argv[3] : NULL;
+	struct stat st;
+	CsvScanImpl impls[] = { CSV_SCAN_SCALAR, CSV_SCAN_SSE2, CSV_SCAN_AVX2 };
+	BenchResult best, result;
+	char* data = NULL;
+	size_t size = 0;
+	FILE* fp = NULL;
+	int i, j;
+
+	fp = fopen(path, "rb");
+	if(fp == NULL) {
+		fprintf(stderr, "Error: unable to open %s\n", path);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = (size_t)ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	data = malloc(size + 1);
+	if(data == NULL || fread(data, 1, size, fp) != size) {
+		fprintf(stderr, "Error: unable to read %s\n", path);
+		return -1;
+	}
+	fclose(fp);
+
+	/* Best of N, so the page cache and branch predictors are warm for everyone. */
+	memset(&best, 0, sizeof(best));
+	for(i = 0; i < iterations; ++i) {
+		bench_fscanf(data, size, &result);
+		if(i == 0 || result.seconds < best.seconds) {
+			best = result;
+		}
+	}
+	report("fscanf", &best, size);
+
+	for(j = 0; j < (int)(sizeof(impls) / sizeof(impls[0])); ++j) {
+		if(csv_scan_set_impl(impls[j]) != impls[j]) {
+			printf("%-8s not supported on this CPU\n", csv_scan_impl_name(impls[j]));
+			continue;
+		}
+		for(i = 0; i < iterations; ++i) {
+			bench_reader(path, &result);
+			if(i == 0 || result.seconds < best.seconds) {
+				best = result;
+			}
+		}
+		report(csv_scan_impl_name(impls[j]), &best, size);
+	}
+
+	if(binary_path != NULL && stat(binary_path, &st) == 0) {
+		for(i = 0; i < iterations; ++i) {
+			bench_reader(binary_path, &result);
+			if(i == 0 || result.seconds < best.seconds) {
+				best = result;
+			}
+		}
+		report("binary", &best, (size_t)st.st_size);
+	}
+
+	free(data);
+	return 0;
+}
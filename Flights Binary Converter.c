@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Converts flights_from_pg.csv to the binary format of flight_binary.h.
+  Extracts that are reloaded many times are parsed once here; the loaders
+  then read the binary file through the same --input option and bind rows
+  straight from its mapping. No cluster is needed:
+
+    cc -O2 "Flights Binary Converter.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c \
+       flight_direct.c flight_decompress.c csv_scan.c load_options.c -lz -lzstd -lpthread
+    ./a.out --input flights_from_pg.csv --output flights.bin
+    "./Prepared SQL Inserts" --input flights.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "flight_binary.h"
+#include "flight_reader.h"
+#include "load_options.h"
+
+#define DEFAULT_INPUT "/Users/carybourgeois/flights_exercise/flights_from_pg.csv"
+#define DEFAULT_OUTPUT "flights_from_pg.bin"
+
+static double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long file_size(const char* path) {
+	struct stat st;
+	return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+int main(int argc, char* argv[]) {
+	const char* input = DEFAULT_INPUT;
+	const char* output = DEFAULT_OUTPUT;
+	FlightReader* reader = NULL;
+	FlightBinaryWriter* writer = NULL;
+	Flight flight;
+	long rows = 0;
+	long skipped = 0;
+	double start = 0;
+	int rc = 0;
+
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "flights CSV to convert, optionally .gz or .zst, - for stdin" },
+		{ "--output", LOAD_OPTION_STRING, &output, "binary file to write (default " DEFAULT_OUTPUT ")" }
+	};
+
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+
+	reader = flight_reader_open(input);
+	if(reader == NULL) {
+		return -1;
+	}
+	writer = flight_binary_create(output);
+	if(writer == NULL) {
+		flight_reader_close(reader);
+		return -1;
+	}
+
+	start = now_seconds();
+	while(flight_reader_next(reader, &flight)) {
+		rc = flight_binary_write(writer, &flight);
+		if(rc < 0) {
+			break;
+		}
+		if(rc > 0) {
+			fprintf(stderr, "Error: skipping row %d, a column is longer than 255 bytes\n", flight.id);
+			skipped++;
+			rc = 0;
+			continue;
+		}
+		rows++;
+	}
+
+	if(flight_binary_close(writer) != 0) {
+		rc = -1;
+	}
+	skipped += (long)flight_reader_errors(reader);
+	flight_reader_close(reader);
+
+	printf("%ld Records converted, %ld skipped, in %.2f seconds.\n", rows, skipped, now_seconds() - start);
+	printf("%ld bytes of CSV became %ld bytes of binary.\n", file_size(input), file_size(output));
+
+	return rc < 0 || skipped > 0 ? -1 : 0;
+}
@@ -0,0 +1,647 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Writes synthetic flights in the layout of flights_from_pg.csv, or in the
+  binary format of flight_binary.h, for parser and loader benchmarks that
+  need inputs of a given size without the original extract. No cluster is
+  needed:
+
+    cc -O2 "Flights Data Generator.c" flight_binary.c flight_intern.c flight_schema.c load_options.c -lpthread -lm
+    ./a.out --output flights_10g.csv --gigabytes 10 --seed 7
+    ./a.out --output - --rows 50000000 | zstd > flights_50m.csv.zst
+
+  Rows look like a year of US domestic flights: 14 carriers with their real
+  market shares, 60 airports weighted by traffic and boosted at each
+  carrier's hubs, distances from the airports' coordinates, air times that
+  follow the distance, and departures bunched into the daytime. Carriers,
+  origins and air_time_grp partitions are therefore as skewed as in the
+  real data, and city names vary in length as they do there.
+
+  Every row is a function of --seed and its id alone. --threads generate
+  chunks of rows in parallel and the output is written in id order, so the
+  same seed, size and format give the same file on any machine and with
+  any number of threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "flight_binary.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_options.h"
+
+#define DEFAULT_OUTPUT "flights_synthetic.csv"
+
+/* Rows are generated and written in chunks of this many. */
+#define CHUNK_ROWS 16384
+
+/* Room for a CSV row, i.e. flight_schema_csv_bytes() of any generated row. */
+#define CSV_ROW_SIZE 256
+
+#define MAX_AIRPORTS 64
+#define MAX_CARRIERS 16
+
+/* Flights from a carrier's hubs are this many times as likely as the airport's traffic suggests. */
+#define HUB_BOOST 8.0
+
+struct Airport_ {
+	const char*	code;
+	int			id;
+	const char*	city_name;
+	const char*	state_abr;
+	double		latitude;
+	double		longitude;
+	double		traffic;	/* relative departures */
+} ;
+
+typedef struct Airport_ Airport;
+
+struct Carrier_ {
+	const char*	code;
+	int			airline_id;
+	double		share;		/* percent of flights */
+	const char*	hubs;		/* airport codes */
+} ;
+
+typedef struct Carrier_ Carrier;
+
+static const Airport airports[] = {
+	{ "ATL", 10397, "Atlanta GA", "GA", 33.64, -84.43, 100 },
+	{ "ORD", 13930, "Chicago IL", "IL", 41.98, -87.90, 80 },
+	{ "DFW", 11298, "Dallas/Fort Worth TX", "TX", 32.90, -97.04, 70 },
+	{ "DEN", 11292, "Denver CO", "CO", 39.86, -104.67, 65 },
+	{ "LAX", 12892, "Los Angeles CA", "CA", 33.94, -118.41, 60 },
+	{ "SFO", 14771, "San Francisco CA", "CA", 37.62, -122.38, 45 },
+	{ "PHX", 14107, "Phoenix AZ", "AZ", 33.43, -112.01, 43 },
+	{ "IAH", 12266, "Houston TX", "TX", 29.98, -95.34, 42 },
+	{ "LAS", 12889, "Las Vegas NV", "NV", 36.08, -115.15, 40 },
+	{ "MSP", 13487, "Minneapolis MN", "MN", 44.88, -93.22, 35 },
+	{ "SEA", 14747, "Seattle WA", "WA", 47.45, -122.31, 33 },
+	{ "MCO", 13204, "Orlando FL", "FL", 28.43, -81.31, 33 },
+	{ "DTW", 11433, "Detroit MI", "MI", 42.21, -83.35, 32 },
+	{ "BOS", 10721, "Boston MA", "MA", 42.36, -71.01, 30 },
+	{ "EWR", 11618, "Newark NJ", "NJ", 40.69, -74.17, 30 },
+	{ "CLT", 11057, "Charlotte NC", "NC", 35.21, -80.94, 29 },
+	{ "LGA", 12953, "New York NY", "NY", 40.78, -73.87, 29 },
+	{ "SLC", 14869, "Salt Lake City UT", "UT", 40.79, -111.98, 28 },
+	{ "JFK", 12478, "New York NY", "NY", 40.64, -73.78, 27 },
+	{ "BWI", 10821, "Baltimore MD", "MD", 39.18, -76.67, 24 },
+	{ "MDW", 13232, "Chicago IL", "IL", 41.79, -87.75, 21 },
+	{ "DCA", 11278, "Washington DC", "VA", 38.85, -77.04, 20 },
+	{ "FLL", 11697, "Fort Lauderdale FL", "FL", 26.07, -80.15, 19 },
+	{ "SAN", 14679, "San Diego CA", "CA", 32.73, -117.19, 18 },
+	{ "MIA", 13303, "Miami FL", "FL", 25.79, -80.29, 17 },
+	{ "PHL", 14100, "Philadelphia PA", "PA", 39.87, -75.24, 17 },
+	{ "TPA", 15304, "Tampa FL", "FL", 27.98, -82.53, 16 },
+	{ "DAL", 11259, "Dallas TX", "TX", 32.85, -96.85, 15 },
+	{ "HOU", 12191, "Houston TX", "TX", 29.65, -95.28, 14 },
+	{ "BNA", 10693, "Nashville TN", "TN", 36.12, -86.68, 13 },
+	{ "PDX", 14057, "Portland OR", "OR", 45.59, -122.60, 13 },
+	{ "STL", 15016, "St. Louis MO", "MO", 38.75, -90.37, 12 },
+	{ "OAK", 13796, "Oakland CA", "CA", 37.72, -122.22, 11 },
+	{ "AUS", 10423, "Austin TX", "TX", 30.19, -97.67, 11 },
+	{ "MCI", 13198, "Kansas City MO", "MO", 39.30, -94.71, 10 },
+	{ "SMF", 14893, "Sacramento CA", "CA", 38.70, -121.59, 9 },
+	{ "SJC", 14831, "San Jose CA", "CA", 37.36, -121.93, 9 },
+	{ "MSY", 13495, "New Orleans LA", "LA", 29.99, -90.26, 9 },
+	{ "RDU", 14492, "Raleigh/Durham NC", "NC", 35.88, -78.79, 9 },
+	{ "SNA", 14908, "Santa Ana CA", "CA", 33.68, -117.87, 8 },
+	{ "IAD", 12264, "Washington DC", "VA", 38.95, -77.46, 8 },
+	{ "CLE", 11042, "Cleveland OH", "OH", 41.41, -81.85, 7 },
+	{ "SAT", 14683, "San Antonio TX", "TX", 29.53, -98.47, 7 },
+	{ "HNL", 12173, "Honolulu HI", "HI", 21.32, -157.92, 7 },
+	{ "PIT", 14122, "Pittsburgh PA", "PA", 40.49, -80.23, 6 },
+	{ "IND", 12339, "Indianapolis IN", "IN", 39.72, -86.29, 6 },
+	{ "CMH", 11066, "Columbus OH", "OH", 40.00, -82.89, 6 },
+	{ "MKE", 13342, "Milwaukee WI", "WI", 42.95, -87.90, 5 },
+	{ "ABQ", 10140, "Albuquerque NM", "NM", 35.04, -106.61, 4 },
+	{ "ANC", 10299, "Anchorage AK", "AK", 61.17, -150.00, 4 },
+	{ "BDL", 10529, "Hartford CT", "CT", 41.94, -72.68, 4 },
+	{ "OMA", 13871, "Omaha NE", "NE", 41.30, -95.89, 3 },
+	{ "BUF", 10792, "Buffalo NY", "NY", 42.94, -78.73, 3 },
+	{ "BOI", 10713, "Boise ID", "ID", 43.56, -116.22, 2 },
+	{ "TUS", 15376, "Tucson AZ", "AZ", 32.12, -110.94, 2 },
+	{ "ELP", 11540, "El Paso TX", "TX", 31.81, -106.38, 2 },
+	{ "OKC", 13851, "Oklahoma City OK", "OK", 35.39, -97.60, 2 },
+	{ "RNO", 14570, "Reno NV", "NV", 39.50, -119.77, 2 },
+	{ "SAV", 14685, "Savannah GA", "GA", 32.13, -81.20, 1 },
+	{ "JAC", 12441, "Jackson WY", "WY", 43.61, -110.74, 1 }
+};
+
+static const Carrier carriers[] = {
+	{ "WN", 19393, 22.0, "MDW,BWI,LAS,DAL,HOU,PHX,DEN,OAK" },
+	{ "DL", 19790, 14.0, "ATL,DTW,MSP,SLC,JFK,LGA" },
+	{ "EV", 20366, 11.0, "ATL,IAH,EWR,ORD" },
+	{ "OO", 20304, 10.0, "DEN,ORD,SLC,LAX,SFO" },
+	{ "AA", 19805, 10.0, "DFW,ORD,MIA,LAX,JFK" },
+	{ "UA", 19977, 8.0, "ORD,IAH,EWR,SFO,DEN,IAD" },
+	{ "US", 20355, 7.0, "CLT,PHL,PHX,DCA" },
+	{ "MQ", 20398, 7.0, "DFW,ORD,LGA,MIA" },
+	{ "B6", 20409, 5.0, "JFK,BOS,FLL,MCO" },
+	{ "AS", 19930, 3.0, "SEA,PDX,ANC,SFO" },
+	{ "F9", 20436, 1.5, "DEN" },
+	{ "FL", 20437, 1.5, "ATL,MCO,BWI" },
+	{ "HA", 19690, 1.0, "HNL" },
+	{ "VX", 21171, 1.0, "SFO,LAX" }
+};
+
+#define NUM_AIRPORTS ((int)(sizeof(airports) / sizeof(airports[0])))
+#define NUM_CARRIERS ((int)(sizeof(carriers) / sizeof(carriers[0])))
+
+/* Relative departures by hour of the day. */
+static const double departure_hours[24] = {
+	0.3, 0.1, 0.05, 0.05, 0.1, 1.5, 5.5, 6.5, 6.5, 6.0, 5.5, 5.5,
+	5.5, 5.5, 5.5, 5.5, 5.5, 6.0, 6.0, 5.5, 4.5, 3.0, 1.5, 0.8
+};
+
+/*
+  Lookup tables built once from the ones above; generator threads only
+  read them. Distributions are cumulative weights, normalized to 1.
+*/
+struct Model_ {
+	double		carrier_cdf[MAX_CARRIERS];
+	double		airport_cdf[MAX_CARRIERS][MAX_AIRPORTS];	/* by carrier */
+	double		hour_cdf[24];
+	int			distances[MAX_AIRPORTS][MAX_AIRPORTS];		/* miles */
+	int			num_days;
+	char		dates[366][20];	/* 10 used, room for what snprintf could write */
+	int			days_of_month[366];
+	int			year;
+	unsigned long long	seed;
+} ;
+
+typedef struct Model_ Model;
+
+/* A chunk of rows from the time a thread starts generating it until it is written. */
+struct Chunk_ {
+	long long	expected;	/* the index of the chunk this slot takes next */
+	int			ready;
+	int			num_rows;
+	size_t		bytes;		/* CSV length; binary sizes depend on the writer's dictionary */
+	char*		text;
+	Flight*		flights;
+} ;
+
+typedef struct Chunk_ Chunk;
+
+struct Generator_ {
+	const Model*	model;
+	int				binary;
+	long long		first_id;
+	long long		num_rows;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	chunk_ready;
+	pthread_cond_t	chunk_written;
+	long long		next_chunk;
+	int				stopping;
+	Chunk*			chunks;
+	int				num_chunks;
+} ;
+
+typedef struct Generator_ Generator;
+
+/* splitmix64: every row gets its own stream, seeded from --seed and its id. */
+static unsigned long long next_random(unsigned long long* state) {
+	unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1). */
+static double next_unit(unsigned long long* state) {
+	return (double)(next_random(state) >> 11) / 9007199254740992.0;
+}
+
+static int pick(const double* cdf, int count, double u) {
+	int low = 0, high = count - 1;
+
+	while(low < high) {
+		int mid = low + (high - low) / 2;
+		if(cdf[mid] > u) {
+			high = mid;
+		} else {
+			low = mid + 1;
+		}
+	}
+	return low;
+}
+
+static void normalize(double* cdf, int count) {
+	int i;
+
+	for(i = 1; i < count; ++i) {
+		cdf[i] += cdf[i - 1];
+	}
+	for(i = 0; i < count; ++i) {
+		cdf[i] /= cdf[count - 1];
+	}
+}
+
+static int is_hub(const Carrier* carrier, const char* code) {
+	const char* hub = carrier->hubs;
+
+	while((hub = strstr(hub, code)) != NULL) {
+		if((hub == carrier->hubs || hub[-1] == ',') && (hub[3] == ',' || hub[3] == '\0')) {
+			return 1;
+		}
+		hub++;
+	}
+	return 0;
+}
+
+/* Great circle distance in statute miles. */
+static int distance_miles(const Airport* a, const Airport* b) {
+	double to_radians = 3.14159265358979323846 / 180.0;
+	double lat1 = a->latitude * to_radians, lat2 = b->latitude * to_radians;
+	double dlat = lat2 - lat1, dlon = (b->longitude - a->longitude) * to_radians;
+	double h = sin(dlat / 2) * sin(dlat / 2) + cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+
+	return (int)(2.0 * 3958.8 * asin(sqrt(h)) + 0.5);
+}
+
+static void model_init(Model* model, int year, unsigned long long seed) {
+	static const int month_days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	int c, a, b, month, day;
+
+	memset(model, 0, sizeof(Model));
+	model->year = year;
+	model->seed = seed;
+
+	for(c = 0; c < NUM_CARRIERS; ++c) {
+		model->carrier_cdf[c] = carriers[c].share;
+		for(a = 0; a < NUM_AIRPORTS; ++a) {
+			model->airport_cdf[c][a] = airports[a].traffic * (is_hub(&carriers[c], airports[a].code) ? HUB_BOOST : 1.0);
+		}
+		normalize(model->airport_cdf[c], NUM_AIRPORTS);
+	}
+	normalize(model->carrier_cdf, NUM_CARRIERS);
+
+	memcpy(model->hour_cdf, departure_hours, sizeof(departure_hours));
+	normalize(model->hour_cdf, 24);
+
+	for(a = 0; a < NUM_AIRPORTS; ++a) {
+		for(b = 0; b < NUM_AIRPORTS; ++b) {
+			model->distances[a][b] = distance_miles(&airports[a], &airports[b]);
+		}
+	}
+
+	for(month = 0; month < 12; ++month) {
+		int days = month_days[month] + (month == 1 && leap);
+		for(day = 1; day <= days; ++day) {
+			snprintf(model->dates[model->num_days], sizeof(model->dates[0]), "%04d-%02d-%02d",
+				year, month + 1, day);
+			model->days_of_month[model->num_days] = day;
+			model->num_days++;
+		}
+	}
+}
+
+static void set_string(FlightString* output, const char* value) {
+	output->data = value;
+	output->length = strlen(value);
+}
+
+static int to_clock(int minutes) {
+	int hhmm = (minutes % 1440) / 60 * 100 + minutes % 60;
+
+	/* As in the source data, midnight arrivals are 2400. */
+	return hhmm == 0 ? 2400 : hhmm;
+}
+
+/* Fills flight with row id. Its strings point into the model and the static tables. */
+static void generate_row(const Model* model, long long id, Flight* flight) {
+	unsigned long long state = model->seed ^ ((unsigned long long)id * 0xd1b54a32d192ed03ULL);
+	int carrier = pick(model->carrier_cdf, NUM_CARRIERS, next_unit(&state));
+	const double* airport_cdf = model->airport_cdf[carrier];
+	int origin = pick(airport_cdf, NUM_AIRPORTS, next_unit(&state));
+	int dest = origin;
+	int day = (int)(next_random(&state) % (unsigned long long)model->num_days);
+	int departure = pick(model->hour_cdf, 24, next_unit(&state)) * 60 + (int)(next_random(&state) % 60);
+	int i, distance, air_time, taxi;
+	double noise = 0;
+
+	/* A few draws settle nearly every row; the fallback keeps the row deterministic anyway. */
+	for(i = 0; i < 16 && dest == origin; ++i) {
+		dest = pick(airport_cdf, NUM_AIRPORTS, next_unit(&state));
+	}
+	if(dest == origin) {
+		dest = (origin + 1) % NUM_AIRPORTS;
+	}
+
+	/* About 8 miles a minute at cruise, plus climb and descent, give or take 5 minutes. */
+	distance = model->distances[origin][dest];
+	for(i = 0; i < 4; ++i) {
+		noise += next_unit(&state);
+	}
+	air_time = (int)((double)distance / 8.0 + 12.0 + (noise - 2.0) * 8.5);
+	if(air_time < 15) {
+		air_time = 15;
+	}
+	/* Taxi out and in: mostly 15 to 30 minutes, with a long tail. */
+	taxi = 10 + (int)(next_random(&state) % 16) + (int)(-log(1.0 - next_unit(&state)) * 6.0);
+
+	memset(flight, 0, sizeof(Flight));
+	flight->id = (int)id;
+	flight->year = model->year;
+	flight->day_of_month = model->days_of_month[day];
+	set_string(&flight->fl_date, model->dates[day]);
+	flight->airline_id = carriers[carrier].airline_id;
+	set_string(&flight->carrier, carriers[carrier].code);
+	/* Flight numbers repeat for a route, a handful per day. */
+	flight->fl_num = 1 + (int)((carrier * 7919 + origin * 104729 + dest * 1299709 +
+		(int)(next_random(&state) % 6) * 15485863) % 6999);
+	flight->origin_airport_id = airports[origin].id;
+	set_string(&flight->origin, airports[origin].code);
+	set_string(&flight->origin_city_name, airports[origin].city_name);
+	set_string(&flight->origin_state_abr, airports[origin].state_abr);
+	set_string(&flight->dest, airports[dest].code);
+	set_string(&flight->dest_city_name, airports[dest].city_name);
+	set_string(&flight->dest_state_abr, airports[dest].state_abr);
+	flight->dep_time = to_clock(departure);
+	flight->arr_time = to_clock(departure + air_time + taxi);
+	flight->actual_elapsed_time = air_time + taxi;
+	flight->air_time = air_time;
+	flight->distance = distance;
+	flight->stable = FLIGHT_STABLE_ALL;
+}
+
+static void generate_chunk(Generator* generator, long long index, Chunk* chunk) {
+	long long first = index * CHUNK_ROWS;
+	long long count = generator->num_rows - first;
+	Flight flight;
+	int i;
+
+	if(count > CHUNK_ROWS) {
+		count = CHUNK_ROWS;
+	}
+	chunk->num_rows = (int)count;
+	chunk->bytes = 0;
+
+	for(i = 0; i < chunk->num_rows; ++i) {
+		if(generator->binary) {
+			generate_row(generator->model, generator->first_id + first + i, &chunk->flights[i]);
+		} else {
+			generate_row(generator->model, generator->first_id + first + i, &flight);
+			chunk->bytes += flight_schema_csv(chunk->text + chunk->bytes, &flight);
+		}
+	}
+}
+
+static void* run_generator(void* data) {
+	Generator* generator = (Generator*)data;
+
+	for(;;) {
+		long long index = 0;
+		Chunk* chunk = NULL;
+
+		pthread_mutex_lock(&generator->lock);
+		index = generator->next_chunk++;
+		chunk = &generator->chunks[index % generator->num_chunks];
+		/* Wait for the writer to be done with the chunk this slot held before. */
+		while(chunk->expected != index && !generator->stopping) {
+			pthread_cond_wait(&generator->chunk_written, &generator->lock);
+		}
+		if(generator->stopping || index * CHUNK_ROWS >= generator->num_rows) {
+			pthread_mutex_unlock(&generator->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&generator->lock);
+
+		generate_chunk(generator, index, chunk);
+
+		pthread_mutex_lock(&generator->lock);
+		chunk->ready = 1;
+		pthread_cond_signal(&generator->chunk_ready);
+		pthread_mutex_unlock(&generator->lock);
+	}
+}
+
+static int write_all(int fd, const char* data, size_t length) {
+	while(length > 0) {
+		ssize_t n = write(fd, data, length);
+		if(n <= 0) {
+			return -1;
+		}
+		data += n;
+		length -= (size_t)n;
+	}
+	return 0;
+}
+
+static double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+	const char* output = DEFAULT_OUTPUT;
+	const char* format = "csv";
+	int rows_option = 1000000;
+	double gigabytes = 0;
+	int seed = 1;
+	int year = 2014;
+	int first_id = 0;
+	int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	long long rows = 0;
+	unsigned long long bytes = 0, max_bytes = 0;
+	long long index = 0;
+	double start = 0, seconds = 0;
+	int failed = 0;
+	int fd = -1;
+	int i;
+	FILE* report = stdout;
+	Model model;
+	Generator generator;
+	FlightBinaryWriter* writer = NULL;
+	pthread_t* threads = NULL;
+
+	LoadOption options[] = {
+		{ "--output", LOAD_OPTION_STRING, &output, "file to write, - for stdout (default " DEFAULT_OUTPUT ")" },
+		{ "--format", LOAD_OPTION_STRING, &format, "csv or binary" },
+		{ "--rows", LOAD_OPTION_INT, &rows_option, "rows to write (default 1000000)" },
+		{ "--gigabytes", LOAD_OPTION_DOUBLE, &gigabytes, "write about this many GB (10^9 bytes) instead of --rows" },
+		{ "--seed", LOAD_OPTION_INT, &seed, "seed of the rows; the same seed gives the same file" },
+		{ "--year", LOAD_OPTION_INT, &year, "year the flights are in (default 2014)" },
+		{ "--first-id", LOAD_OPTION_INT, &first_id, "id of the first row (default 0)" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "generate on N threads (default: one per CPU)" }
+	};
+
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	if(num_threads < 1 || rows_option < 0 || gigabytes < 0 || first_id < 0 || year < 1 || year > 9999) {
+		fprintf(stderr, "Error: --threads must be at least 1, --year from 1 to 9999, --rows, --gigabytes and --first-id not negative\n");
+		return -1;
+	}
+	if(strcmp(format, "csv") != 0 && strcmp(format, "binary") != 0) {
+		fprintf(stderr, "Error: --format must be csv or binary\n");
+		return -1;
+	}
+
+	/* ids are ints, so that is as far as a file can go. */
+	rows = 0x7fffffffLL - first_id + 1;
+	if(gigabytes > 0) {
+		max_bytes = (unsigned long long)(gigabytes * 1e9);
+	} else if(rows_option < rows) {
+		rows = rows_option;
+	}
+
+	model_init(&model, year, (unsigned long long)(unsigned)seed * 0x9e3779b97f4a7c15ULL);
+
+	memset(&generator, 0, sizeof(generator));
+	generator.model = &model;
+	generator.binary = strcmp(format, "binary") == 0;
+	generator.first_id = first_id;
+	generator.num_rows = rows;
+	generator.num_chunks = 2 * num_threads;
+	generator.chunks = calloc((size_t)generator.num_chunks, sizeof(Chunk));
+	threads = calloc((size_t)num_threads, sizeof(pthread_t));
+	if(generator.chunks == NULL || threads == NULL) {
+		fprintf(stderr, "Error: out of memory\n");
+		return -1;
+	}
+	for(i = 0; i < generator.num_chunks; ++i) {
+		Chunk* chunk = &generator.chunks[i];
+
+		chunk->expected = i;
+		if(generator.binary) {
+			chunk->flights = malloc(CHUNK_ROWS * sizeof(Flight));
+		} else {
+			chunk->text = malloc(CHUNK_ROWS * CSV_ROW_SIZE);
+		}
+		if(chunk->flights == NULL && chunk->text == NULL) {
+			fprintf(stderr, "Error: out of memory for %d chunks of %d rows\n", generator.num_chunks, CHUNK_ROWS);
+			return -1;
+		}
+	}
+
+	if(generator.binary) {
+		if(strcmp(output, "-") == 0) {
+			fprintf(stderr, "Error: binary output must go to a file\n");
+			return -1;
+		}
+		writer = flight_binary_create(output);
+		if(writer == NULL) {
+			return -1;
+		}
+	} else if(strcmp(output, "-") == 0) {
+		fd = STDOUT_FILENO;
+		report = stderr;
+	} else {
+		fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0) {
+			fprintf(stderr, "Error: unable to create %s\n", output);
+			return -1;
+		}
+	}
+
+	pthread_mutex_init(&generator.lock, NULL);
+	pthread_cond_init(&generator.chunk_ready, NULL);
+	pthread_cond_init(&generator.chunk_written, NULL);
+
+	start = now_seconds();
+	for(i = 0; i < num_threads; ++i) {
+		if(pthread_create(&threads[i], NULL, run_generator, &generator) != 0) {
+			fprintf(stderr, "Error: unable to start generator thread %d\n", i);
+			break;
+		}
+	}
+	num_threads = i;
+
+	/* Write the chunks in order as they become ready. */
+	rows = 0;
+	for(index = 0; num_threads > 0 && index * CHUNK_ROWS < generator.num_rows; ++index) {
+		Chunk* chunk = &generator.chunks[index % generator.num_chunks];
+
+		pthread_mutex_lock(&generator.lock);
+		while(!chunk->ready) {
+			pthread_cond_wait(&generator.chunk_ready, &generator.lock);
+		}
+		pthread_mutex_unlock(&generator.lock);
+
+		if(generator.binary) {
+			for(i = 0; i < chunk->num_rows && !failed; ++i) {
+				failed = flight_binary_write(writer, &chunk->flights[i]) != 0;
+			}
+		} else {
+			failed = write_all(fd, chunk->text, chunk->bytes) != 0;
+		}
+		if(failed) {
+			fprintf(stderr, "Error: writing %s failed\n", output);
+			break;
+		}
+		rows += chunk->num_rows;
+		bytes = generator.binary ? flight_binary_size(writer) : bytes + chunk->bytes;
+
+		pthread_mutex_lock(&generator.lock);
+		chunk->ready = 0;
+		chunk->expected = index + generator.num_chunks;
+		pthread_cond_broadcast(&generator.chunk_written);
+		pthread_mutex_unlock(&generator.lock);
+
+		if(max_bytes > 0 && bytes >= max_bytes) {
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&generator.lock);
+	generator.stopping = 1;
+	pthread_cond_broadcast(&generator.chunk_written);
+	pthread_mutex_unlock(&generator.lock);
+	for(i = 0; i < num_threads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if(writer != NULL && flight_binary_close(writer) != 0) {
+		fprintf(stderr, "Error: writing %s failed\n", output);
+		failed = 1;
+	}
+	if(fd >= 0 && fd != STDOUT_FILENO && close(fd) != 0) {
+		fprintf(stderr, "Error: writing %s failed\n", output);
+		failed = 1;
+	}
+	seconds = now_seconds() - start;
+
+	fprintf(report, "%lld Records (%.0f bytes of %s) generated to %s in %.2f seconds (%.0f rows/sec, %.1f MB/sec)"
+		" with seed %d on %d threads.\n", rows, (double)bytes, format, output, seconds,
+		seconds > 0 ? (double)rows / seconds : 0.0, seconds > 0 ? (double)bytes / seconds / 1e6 : 0.0,
+		seed, num_threads);
+
+	for(i = 0; i < generator.num_chunks; ++i) {
+		free(generator.chunks[i].text);
+		free(generator.chunks[i].flights);
+	}
+	free(generator.chunks);
+	free(threads);
+	pthread_cond_destroy(&generator.chunk_written);
+	pthread_cond_destroy(&generator.chunk_ready);
+	pthread_mutex_destroy(&generator.lock);
+
+	return failed || num_threads == 0 ? -1 : 0;
+}
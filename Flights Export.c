@@ -0,0 +1,501 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Unloads exercise.flights to CSV or to the binary format of
+  flight_binary.h. The Murmur3 token ring is cut into --ranges equal
+  ranges. --threads workers take them in turn and page through each one
+  with a prepared token range SELECT. Memory stays bounded: a worker
+  holds one page of rows at a time, and writes it to the shared output
+  before it fetches the next.
+
+  flights is partitioned by carrier alone, so the table holds only about
+  as many partitions as there are carriers, each in a single range. Most
+  of the ranges come back empty and the scan runs at most about that many
+  workers wide, however large --ranges and --threads are.
+
+  Rows come out in token order within a range, not in input order. For a
+  round trip, --verify compares the row count and an order independent
+  checksum of the export with those of a local file, which may be CSV,
+  compressed or binary:
+
+    cc -O2 "Flights Export.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c csv_scan.c \
+       flight_direct.c flight_decompress.c flight_schema.c load_options.c load_cluster.c -lcassandra -lz -lzstd -lpthread
+    ./a.out --output flights_export.bin --format binary --verify flights_from_pg.csv
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+
+#include "flight_binary.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_cluster.h"
+#include "load_options.h"
+
+#define DEFAULT_OUTPUT "flights_export.csv"
+
+#define SELECT_WHERE "WHERE token(" FLIGHT_SCHEMA_PARTITION_KEY ") > ? \
+						AND token(" FLIGHT_SCHEMA_PARTITION_KEY ") <= ?;"
+
+/* A page is retried this many times after a failure before its range is given up. */
+#define PAGE_ATTEMPTS 4
+
+/* Room for a CSV row; longer ones are skipped. */
+#define CSV_ROW_SIZE 2560
+
+struct ExportContext_ {
+	CassSession*		session;
+	const CassPrepared*	prepared;
+	int					num_ranges;
+	int					page_size;
+	int					next_range;		/* taken with __sync_fetch_and_add */
+
+	pthread_mutex_t		lock;			/* guards the output and the totals */
+	FILE*				csv;
+	FlightBinaryWriter*	binary;
+	long				rows;
+	long				skipped;
+	int					failed_ranges;
+	int					write_failed;
+	unsigned long long	checksum;
+} ;
+
+typedef struct ExportContext_ ExportContext;
+
+void print_error(CassFuture* future) {
+  CassString message = cass_future_error_message(future);
+  fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+}
+
+CassError connect_session(CassCluster* cluster, CassSession** output) {
+  CassError rc = CASS_OK;
+  CassFuture* future = cass_cluster_connect(cluster);
+
+  *output = NULL;
+
+  cass_future_wait(future);
+  rc = cass_future_error_code(future);
+  if(rc != CASS_OK) {
+    print_error(future);
+  } else {
+    *output = cass_future_get_session(future);
+  }
+  cass_future_free(future);
+
+  return rc;
+}
+
+CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared** prepared) {
+	CassError rc = CASS_OK;
+	CassFuture* future = NULL;
+	CassString query = cass_string_init(sql);
+
+	future = cass_session_prepare(session, query);
+	cass_future_wait(future);
+
+	rc = cass_future_error_code(future);
+	if(rc != CASS_OK) {
+		print_error(future);
+	} else {
+		*prepared = cass_future_get_prepared(future);
+	}
+
+	cass_future_free(future);
+
+	return rc;
+}
+
+static double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned long long hash_bytes(unsigned long long hash, const void* data, size_t length) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	size_t i;
+
+	for(i = 0; i < length; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define CHECKSUM_INT(name, ...) flight->name,
+#define CHECKSUM_TEXT(name, ...) &flight->name,
+
+/*
+  Hash of every column of a row. Rows are summed, so the checksum of a set
+  of rows does not depend on the order they were read in.
+*/
+static unsigned long long flight_checksum(const Flight* flight) {
+	const int ints[] = { FLIGHT_SCHEMA(CHECKSUM_INT, FLIGHT_SCHEMA_SKIP, FLIGHT_SCHEMA_SKIP) };
+	const FlightString* strings[] = { FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, CHECKSUM_TEXT, FLIGHT_SCHEMA_SKIP) };
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	int i;
+
+	hash = hash_bytes(hash, ints, sizeof(ints));
+	for(i = 0; i < FLIGHT_NUM_STRINGS; ++i) {
+		hash = hash_bytes(hash, strings[i]->data, strings[i]->length);
+		hash = hash_bytes(hash, "", 1);
+	}
+	return hash;
+}
+
+static int get_int(const CassRow* row, size_t index, int* output) {
+	cass_int32_t value = 0;
+
+	if(cass_value_get_int32(cass_row_get_column(row, index), &value) != CASS_OK) {
+		return -1;
+	}
+	*output = (int)value;
+	return 0;
+}
+
+static int get_string(const CassRow* row, size_t index, FlightString* output) {
+	CassString value;
+
+	if(cass_value_get_string(cass_row_get_column(row, index), &value) != CASS_OK) {
+		return -1;
+	}
+	output->data = value.data;
+	output->length = value.length;
+	return 0;
+}
+
+/* Columns of the SELECT are numbered in the order it lists them. */
+#define DECODE_INT(name, ...) \
+	if(get_int(row, column++, &flight->name) != 0) { \
+		return -1; \
+	}
+#define DECODE_TEXT(name, ...) \
+	if(get_string(row, column++, &flight->name) != 0) { \
+		return -1; \
+	}
+
+/* Fills flight from a row of flight_schema_select(); its strings point into the result. */
+static int decode_row(const CassRow* row, Flight* flight) {
+	size_t column = 0;
+
+	memset(flight, 0, sizeof(Flight));
+	FLIGHT_SCHEMA(DECODE_INT, DECODE_TEXT, FLIGHT_SCHEMA_SKIP)
+	flight->stable = FLIGHT_STABLE_ALL;
+	return 0;
+}
+
+/* Bounds of range index out of num_ranges, as (start, end] over the Murmur3 tokens. */
+static void token_range(int index, int num_ranges, long long* start, long long* end) {
+	unsigned long long width = 0xffffffffffffffffULL / (unsigned long long)num_ranges;
+	unsigned long long first = 0x8000000000000000ULL;
+
+	*start = (long long)(first + width * (unsigned long long)index);
+	*end = index == num_ranges - 1 ? 0x7fffffffffffffffLL :
+		(long long)(first + width * (unsigned long long)(index + 1));
+}
+
+/* Decodes a page and writes it out, holding the output lock only for the write. */
+static void write_page(ExportContext* context, const CassResult* result, Flight* flights, char* text) {
+	CassIterator* rows = cass_iterator_from_result(result);
+	unsigned long long checksum = 0;
+	size_t length = 0;
+	long skipped = 0;
+	int num_rows = 0;
+	int i;
+
+	while(cass_iterator_next(rows)) {
+		Flight* flight = &flights[num_rows];
+
+		if(decode_row(cass_iterator_get_row(rows), flight) != 0 ||
+			(text != NULL && flight_schema_csv_bytes(flight) > CSV_ROW_SIZE)) {
+			fprintf(stderr, "Error: skipping a row that cannot be exported\n");
+			skipped++;
+			continue;
+		}
+		checksum += flight_checksum(flight);
+		if(text != NULL) {
+			length += flight_schema_csv(text + length, flight);
+		}
+		num_rows++;
+	}
+
+	pthread_mutex_lock(&context->lock);
+	if(context->csv != NULL) {
+		if(fwrite(text, 1, length, context->csv) != length) {
+			context->write_failed = 1;
+		}
+	} else {
+		for(i = 0; i < num_rows; ++i) {
+			int rc = flight_binary_write(context->binary, &flights[i]);
+			if(rc < 0) {
+				context->write_failed = 1;
+				break;
+			}
+			if(rc > 0) {
+				fprintf(stderr, "Error: skipping row %d, a column is longer than 255 bytes\n", flights[i].id);
+				skipped++;
+				num_rows--;
+				checksum -= flight_checksum(&flights[i]);
+			}
+		}
+	}
+	context->rows += num_rows;
+	context->skipped += skipped;
+	context->checksum += checksum;
+	pthread_mutex_unlock(&context->lock);
+
+	cass_iterator_free(rows);
+}
+
+/* Pages through one token range. Returns 0, or -1 if a page kept failing. */
+static int export_range(ExportContext* context, int index, Flight* flights, char* text) {
+	CassStatement* statement = cass_prepared_bind(context->prepared);
+	long long start = 0, end = 0;
+	int more = 1;
+	int rc = 0;
+
+	token_range(index, context->num_ranges, &start, &end);
+	load_cluster_apply(statement);
+	cass_statement_bind_int64(statement, 0, start);
+	cass_statement_bind_int64(statement, 1, end);
+	cass_statement_set_paging_size(statement, context->page_size);
+
+	while(more && rc == 0) {
+		const CassResult* result = NULL;
+		int attempt;
+
+		for(attempt = 1; attempt <= PAGE_ATTEMPTS && result == NULL; ++attempt) {
+			CassFuture* future = cass_session_execute(context->session, statement);
+
+			cass_future_wait(future);
+			if(cass_future_error_code(future) == CASS_OK) {
+				result = cass_future_get_result(future);
+			} else {
+				print_error(future);
+				if(attempt < PAGE_ATTEMPTS) {
+					struct timespec delay = { 0, 100000000L << (attempt - 1) };
+					nanosleep(&delay, NULL);
+				}
+			}
+			cass_future_free(future);
+		}
+
+		if(result == NULL) {
+			fprintf(stderr, "Error: giving up on token range %d (%lld, %lld]\n", index, start, end);
+			rc = -1;
+			break;
+		}
+
+		write_page(context, result, flights, text);
+		more = cass_result_has_more_pages(result);
+		if(more) {
+			cass_statement_set_paging_state(statement, result);
+		}
+		cass_result_free(result);
+	}
+
+	cass_statement_free(statement);
+	return rc;
+}
+
+static void* run_worker(void* data) {
+	ExportContext* context = (ExportContext*)data;
+	Flight* flights = malloc((size_t)context->page_size * sizeof(Flight));
+	char* text = context->csv != NULL ? malloc((size_t)context->page_size * CSV_ROW_SIZE) : NULL;
+	int index = 0;
+
+	if(flights == NULL || (context->csv != NULL && text == NULL)) {
+		fprintf(stderr, "Error: out of memory for a page of %d rows\n", context->page_size);
+		pthread_mutex_lock(&context->lock);
+		context->failed_ranges++;
+		pthread_mutex_unlock(&context->lock);
+		free(flights);
+		free(text);
+		return NULL;
+	}
+
+	while((index = __sync_fetch_and_add(&context->next_range, 1)) < context->num_ranges) {
+		if(export_range(context, index, flights, text) != 0) {
+			pthread_mutex_lock(&context->lock);
+			context->failed_ranges++;
+			pthread_mutex_unlock(&context->lock);
+		}
+	}
+
+	free(flights);
+	free(text);
+	return NULL;
+}
+
+/* Reads path with flight_reader and compares it with what was exported. */
+static int verify(const char* path, const ExportContext* context) {
+	FlightReader* reader = flight_reader_open(path);
+	unsigned long long checksum = 0;
+	long rows = 0;
+	Flight flight;
+
+	if(reader == NULL) {
+		return -1;
+	}
+	while(flight_reader_next(reader, &flight)) {
+		checksum += flight_checksum(&flight);
+		rows++;
+	}
+	flight_reader_close(reader);
+
+	printf("Verify: %ld rows, checksum %016llx in %s; %ld rows, checksum %016llx exported.\n",
+		rows, checksum, path, context->rows, context->checksum);
+	if(rows != context->rows || checksum != context->checksum) {
+		printf("Verify: MISMATCH.\n");
+		return -1;
+	}
+	printf("Verify: match.\n");
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* output = DEFAULT_OUTPUT;
+	const char* format = "csv";
+	const char* verify_path = NULL;
+	int num_threads = 8;
+	int num_ranges = 256;
+	int page_size = 5000;
+	double start = 0, seconds = 0;
+	int failed = 0;
+	int i;
+	char query[1024];
+	ExportContext context;
+	pthread_t* threads = NULL;
+
+	CassError rc = CASS_OK;
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
+	CassSession* session = NULL;
+	CassFuture* close_future = NULL;
+	const CassPrepared* prepared = NULL;
+
+	LoadOption options[] = {
+		{ "--output", LOAD_OPTION_STRING, &output, "file to write (default " DEFAULT_OUTPUT ")" },
+		{ "--format", LOAD_OPTION_STRING, &format, "csv or binary" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "scan N token ranges at a time" },
+		{ "--ranges", LOAD_OPTION_INT, &num_ranges, "split the token ring into N ranges" },
+		{ "--page-size", LOAD_OPTION_INT, &page_size, "rows per page" },
+		{ "--verify", LOAD_OPTION_STRING, &verify_path, "compare the export with this input file" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	if(num_threads < 1 || num_ranges < 1 || page_size < 1) {
+		fprintf(stderr, "Error: --threads, --ranges and --page-size must be at least 1\n");
+		return -1;
+	}
+	if(strcmp(format, "csv") != 0 && strcmp(format, "binary") != 0) {
+		fprintf(stderr, "Error: --format must be csv or binary\n");
+		return -1;
+	}
+
+	memset(&context, 0, sizeof(context));
+	context.num_ranges = num_ranges;
+	context.page_size = page_size;
+	if(strcmp(format, "csv") == 0) {
+		context.csv = fopen(output, "w");
+		if(context.csv == NULL) {
+			fprintf(stderr, "Error: unable to create %s\n", output);
+			return -1;
+		}
+	} else {
+		context.binary = flight_binary_create(output);
+		if(context.binary == NULL) {
+			return -1;
+		}
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
+	rc = connect_session(cluster, &session);
+	if(rc != CASS_OK) {
+		return -1;
+	}
+
+	if(flight_schema_select(query, sizeof(query), "exercise.flights", SELECT_WHERE) != 0 ||
+		prepare_stmt(session, query, &prepared) != CASS_OK) {
+		return -1;
+	}
+
+	context.session = session;
+	context.prepared = prepared;
+	pthread_mutex_init(&context.lock, NULL);
+
+	threads = calloc((size_t)num_threads, sizeof(pthread_t));
+	if(threads == NULL) {
+		return -1;
+	}
+
+	start = now_seconds();
+	for(i = 0; i < num_threads; ++i) {
+		if(pthread_create(&threads[i], NULL, run_worker, &context) != 0) {
+			fprintf(stderr, "Error: unable to start export thread %d\n", i);
+			failed = 1;
+			break;
+		}
+	}
+	num_threads = i;
+	for(i = 0; i < num_threads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	seconds = now_seconds() - start;
+
+	if(context.csv != NULL && fclose(context.csv) != 0) {
+		context.write_failed = 1;
+	}
+	if(context.binary != NULL && flight_binary_close(context.binary) != 0) {
+		context.write_failed = 1;
+	}
+	if(context.write_failed) {
+		fprintf(stderr, "Error: writing %s failed\n", output);
+	}
+
+	printf("%ld Records exported to %s in %.2f seconds (%.0f rows/sec), %ld skipped.\n",
+		context.rows, output, seconds, seconds > 0 ? (double)context.rows / seconds : 0.0, context.skipped);
+	printf("%d of %d token ranges failed.\n", context.failed_ranges, num_ranges);
+	load_cluster_report(&cluster_settings, stdout);
+
+	failed |= context.failed_ranges > 0 || context.write_failed || context.skipped > 0;
+	if(verify_path != NULL && verify(verify_path, &context) != 0) {
+		failed = 1;
+	}
+
+	free(threads);
+	pthread_mutex_destroy(&context.lock);
+	cass_prepared_free(prepared);
+
+	close_future = cass_session_close(session);
+	cass_future_wait(close_future);
+	cass_future_free(close_future);
+	cass_cluster_free(cluster);
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,802 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Runs the insert strategies of the loaders against the same input and the
+  same cluster, one after the other, and reports each trial as a tab
+  separated line:
+
+    mode trial rows seconds rows_per_sec mb_per_sec requests p50_us p99_us p999_us cpu_us_per_row
+
+  followed by a "median" line per mode (the trial with the median rows/sec).
+  Each mode is the insert loop of one loader on a single thread:
+
+    simple     "Simple SQL Inserts": a literal INSERT per row
+    prepared   "Prepared SQL Inserts": one pooled statement rebound per row
+    batch      "Batch Prepared SQL Inserts": LOGGED batches in file order,
+               closed by the loader's LoadBatchSizer (load_batch.h)
+    partition  the same with --partition-batches: UNLOGGED batches of one
+               carrier each from the loader's partition buffers, sorted by
+               clustering key and sent when full or --batch-age-ms old
+    async      "Naive Async Prepared SQL Inserts": rows in flight bounded
+               by the loader's throttle window, which starts at
+               --concurrency and halves on timeouts and overload (AIMD)
+
+  --adaptive-batches, --batch-bytes, --batch-latency-ms and --batch-age-ms
+  mean what they mean to the batch loader; --batch-rows replaces its fixed
+  100 rows per batch. Not reproduced: retries and reject files, rate
+  limits, checkpoints, rollups, --targets and the loaders' --threads and
+  --parser-threads. A failed request is counted and the trial goes on.
+
+  Wall time comes from CLOCK_MONOTONIC, CPU time from the process CPU clock,
+  so cpu_us_per_row includes the driver's I/O threads. Latency is measured
+  per request: a row for simple, prepared and async, a whole batch for
+  batch and partition. MB/s counts bound payload bytes, as the batch loader
+  sizes them. The flights table is truncated before every trial.
+
+    cc -O2 "Insert Strategy Benchmark.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c flight_direct.c csv_scan.c \
+       flight_decompress.c flight_binder.c flight_schema.c load_cluster.c load_options.c load_batch.c load_throttle.c \
+       load_stats.c latency_histogram.c -lcassandra -lz -lzstd -lpthread
+    ./a.out --modes prepared,async --trials 5
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+
+#include "flight_binder.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_batch.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_throttle.h"
+
+#define DEFAULT_INPUT "/Users/carybourgeois/flights_exercise/flights_from_pg.csv"
+#define MAX_TRIALS 64
+
+void print_error(CassFuture* future) {
+  CassString message = cass_future_error_message(future);
+  fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+}
+
+
+CassError connect_session(CassCluster* cluster, CassSession** output) {
+  CassError rc = CASS_OK;
+  CassFuture* future = cass_cluster_connect(cluster);
+
+  *output = NULL;
+
+  cass_future_wait(future);
+  rc = cass_future_error_code(future);
+  if(rc != CASS_OK) {
+    print_error(future);
+  } else {
+    *output = cass_future_get_session(future);
+  }
+  cass_future_free(future);
+
+  return rc;
+}
+
+CassError execute_stmt(CassSession* session, const char* query) {
+  CassError rc = CASS_OK;
+  CassFuture* future = NULL;
+  CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
+
+  load_cluster_apply(statement);
+
+  future = cass_session_execute(session, statement);
+  cass_future_wait(future);
+
+  rc = cass_future_error_code(future);
+  if(rc != CASS_OK) {
+    print_error(future);
+  }
+
+  cass_future_free(future);
+  cass_statement_free(statement);
+
+  return rc;
+}
+
+CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared** prepared) {
+	CassError rc = CASS_OK;
+	CassFuture* future = NULL;
+	CassString query = cass_string_init(sql);
+
+	future = cass_session_prepare(session, query);
+	cass_future_wait(future);
+
+	rc = cass_future_error_code(future);
+	if(rc != CASS_OK) {
+		print_error(future);
+	} else {
+		*prepared = cass_future_get_prepared(future);
+  	}
+
+  	cass_future_free(future);
+
+	return rc;
+}
+
+/* Waits for a request, frees its future and returns its error code. */
+CassError wait_future(CassFuture* future) {
+	CassError rc = CASS_OK;
+
+	cass_future_wait(future);
+	rc = cass_future_error_code(future);
+	if(rc != CASS_OK) {
+		print_error(future);
+	}
+	cass_future_free(future);
+
+	return rc;
+}
+
+long long now_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Per-request latencies of one trial, in nanoseconds. */
+struct Samples_ {
+	long long*	values;
+	size_t		count;
+	size_t		capacity;
+} ;
+
+typedef struct Samples_ Samples;
+
+void samples_add(Samples* samples, long long value) {
+	if(samples->count == samples->capacity) {
+		size_t capacity = samples->capacity > 0 ? samples->capacity * 2 : 65536;
+		long long* values = realloc(samples->values, capacity * sizeof(long long));
+		if(values == NULL) {
+			return;
+		}
+		samples->values = values;
+		samples->capacity = capacity;
+	}
+	samples->values[samples->count++] = value;
+}
+
+int compare_samples(const void* a, const void* b) {
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest rank percentile; the samples must be sorted. */
+double samples_percentile_us(const Samples* samples, double percentile) {
+	size_t rank = 0;
+
+	if(samples->count == 0) {
+		return 0.0;
+	}
+	rank = (size_t)(percentile / 100.0 * (double)samples->count + 0.5);
+	if(rank > 0) {
+		rank--;
+	}
+	if(rank >= samples->count) {
+		rank = samples->count - 1;
+	}
+	return samples->values[rank] / 1000.0;
+}
+
+struct Bench_ {
+	CassSession*		session;
+	const CassPrepared*	prepared;
+	long				max_rows;
+	int					batch_rows;
+	int					adaptive_batches;
+	size_t				max_batch_bytes;
+	double				target_latency;
+	double				max_batch_age;
+	int					concurrency;
+
+	/* Results of the current trial. */
+	Samples				samples;
+	long				rows;
+	size_t				bytes;
+	size_t				row_bytes;		/* of the last row bench_next() read */
+	int					failed;
+} ;
+
+typedef struct Bench_ Bench;
+
+/* Reads the next row unless the --rows limit has been reached. */
+int bench_next(Bench* bench, FlightReader* reader, Flight* flight) {
+	if(bench->max_rows > 0 && bench->rows >= bench->max_rows) {
+		return 0;
+	}
+	if(!flight_reader_next(reader, flight)) {
+		return 0;
+	}
+	bench->rows++;
+	bench->row_bytes = flight_payload_bytes(flight);
+	bench->bytes += bench->row_bytes;
+	return 1;
+}
+
+/* "Simple SQL Inserts": a literal INSERT per row, executed synchronously. */
+void run_simple(Bench* bench, FlightReader* reader) {
+	Flight flight;
+	char sql[1024];
+
+	while(bench_next(bench, reader, &flight)) {
+		CassStatement* statement = NULL;
+		long long start = 0;
+
+		if(flight_schema_insert_values(sql, sizeof(sql), "flights", &flight) != 0) {
+			bench->failed = 1;
+			continue;
+		}
+
+		start = now_ns(CLOCK_MONOTONIC);
+		statement = cass_statement_new(cass_string_init(sql), 0);
+		load_cluster_apply(statement);
+		if(wait_future(cass_session_execute(bench->session, statement)) != CASS_OK) {
+			bench->failed = 1;
+		}
+		cass_statement_free(statement);
+		samples_add(&bench->samples, now_ns(CLOCK_MONOTONIC) - start);
+	}
+}
+
+/* "Prepared SQL Inserts": one pooled statement rebound and executed synchronously per row. */
+void run_prepared(Bench* bench, FlightReader* reader) {
+	FlightBinder binder;
+	CassStatement* statement = NULL;
+	Flight flight;
+
+	if(flight_binder_init(&binder, bench->prepared, 1) != 0) {
+		bench->failed = 1;
+		return;
+	}
+	statement = flight_binder_acquire(&binder);
+
+	while(bench_next(bench, reader, &flight)) {
+		long long start = now_ns(CLOCK_MONOTONIC);
+
+		flight_binder_bind(&binder, statement, &flight);
+		if(wait_future(cass_session_execute(bench->session, statement)) != CASS_OK) {
+			bench->failed = 1;
+		}
+		samples_add(&bench->samples, now_ns(CLOCK_MONOTONIC) - start);
+	}
+
+	flight_binder_release(&binder, statement);
+	flight_binder_destroy(&binder);
+}
+
+/*
+  A batch of pooled statements, as the batch loader builds it, minus the
+  rows it keeps for the reject file.
+*/
+struct BenchBatch_ {
+	CassBatch*		batch;
+	CassStatement*	statements[LOAD_BATCH_MAX_ROWS];
+	int				num_rows;
+	size_t			bytes;
+} ;
+
+typedef struct BenchBatch_ BenchBatch;
+
+void bench_batch_init(BenchBatch* pending, CassBatchType type) {
+	pending->batch = cass_batch_new(type);
+	load_cluster_apply_batch(pending->batch);
+	pending->num_rows = 0;
+	pending->bytes = 0;
+}
+
+void bench_batch_add(BenchBatch* pending, FlightBinder* binder, const Flight* flight, size_t row_bytes) {
+	CassStatement* statement = flight_binder_acquire(binder);
+
+	flight_binder_bind(binder, statement, flight);
+	cass_batch_add_statement(pending->batch, statement);
+	pending->statements[pending->num_rows++] = statement;
+	pending->bytes += row_bytes;
+}
+
+/* Executes the batch, feeding its latency to the sizer, and recycles its statements. */
+void bench_batch_send(Bench* bench, LoadBatchSizer* sizer, FlightBinder* binder, BenchBatch* pending) {
+	long long start = now_ns(CLOCK_MONOTONIC);
+	long long latency = 0;
+	CassError rc = wait_future(cass_session_execute_batch(bench->session, pending->batch));
+	int i;
+
+	latency = now_ns(CLOCK_MONOTONIC) - start;
+	samples_add(&bench->samples, latency);
+	load_batch_sizer_update(sizer, rc, latency / 1e9, pending->num_rows, pending->bytes);
+	if(rc != CASS_OK) {
+		bench->failed = 1;
+	}
+
+	cass_batch_free(pending->batch);
+	pending->batch = NULL;
+	for(i = 0; i < pending->num_rows; ++i) {
+		flight_binder_release(binder, pending->statements[i]);
+	}
+	pending->num_rows = 0;
+	pending->bytes = 0;
+}
+
+void bench_sizer_init(const Bench* bench, LoadBatchSizer* sizer) {
+	load_batch_sizer_init(sizer, bench->batch_rows, bench->adaptive_batches, bench->max_batch_bytes,
+		bench->target_latency);
+}
+
+/* "Batch Prepared SQL Inserts": LOGGED batches in file order, closed by the sizer. */
+void run_batch(Bench* bench, FlightReader* reader) {
+	FlightBinder binder;
+	LoadBatchSizer sizer;
+	BenchBatch pending;
+	Flight flight;
+
+	if(flight_binder_init(&binder, bench->prepared, LOAD_BATCH_MAX_ROWS) != 0) {
+		bench->failed = 1;
+		return;
+	}
+	bench_sizer_init(bench, &sizer);
+	bench_batch_init(&pending, CASS_BATCH_TYPE_LOGGED);
+
+	while(bench_next(bench, reader, &flight)) {
+		if(load_batch_sizer_full(&sizer, pending.num_rows, pending.bytes, bench->row_bytes)) {
+			bench_batch_send(bench, &sizer, &binder, &pending);
+			bench_batch_init(&pending, CASS_BATCH_TYPE_LOGGED);
+		}
+		bench_batch_add(&pending, &binder, &flight, bench->row_bytes);
+	}
+
+	if(pending.num_rows > 0) {
+		bench_batch_send(bench, &sizer, &binder, &pending);
+	} else {
+		cass_batch_free(pending.batch);
+	}
+	flight_binder_destroy(&binder);
+}
+
+struct BenchSender_ {
+	Bench*			bench;
+	LoadBatchSizer*	sizer;
+	FlightBinder*	binder;
+} ;
+
+typedef struct BenchSender_ BenchSender;
+
+void send_partition(void* data, FlightRow* const* rows, int num_rows, size_t first) {
+	BenchSender* sender = (BenchSender*)data;
+	BenchBatch pending;
+	int i;
+
+	(void)first;	/* the benchmark keeps no checkpoint */
+	bench_batch_init(&pending, CASS_BATCH_TYPE_UNLOGGED);
+	for(i = 0; i < num_rows; ++i) {
+		bench_batch_add(&pending, sender->binder, &rows[i]->flight, flight_payload_bytes(&rows[i]->flight));
+	}
+	bench_batch_send(sender->bench, sender->sizer, sender->binder, &pending);
+}
+
+/* "Batch Prepared SQL Inserts --partition-batches": UNLOGGED batches of one carrier each. */
+void run_partition(Bench* bench, FlightReader* reader) {
+	FlightBinder binder;
+	LoadBatchSizer sizer;
+	BenchSender sender;
+	LoadPartitions partitions;
+	Flight flight;
+
+	if(flight_binder_init(&binder, bench->prepared, LOAD_BATCH_MAX_ROWS) != 0) {
+		bench->failed = 1;
+		return;
+	}
+	bench_sizer_init(bench, &sizer);
+	sender.bench = bench;
+	sender.sizer = &sizer;
+	sender.binder = &binder;
+	load_partitions_init(&partitions, &sizer, bench->max_batch_age, send_partition, &sender);
+
+	while(bench_next(bench, reader, &flight)) {
+		/* There is no checkpoint, so offsets do not matter. */
+		if(load_partitions_add(&partitions, &flight, bench->row_bytes, 0) != 0) {
+			BenchBatch single;
+			bench_batch_init(&single, CASS_BATCH_TYPE_UNLOGGED);
+			bench_batch_add(&single, &binder, &flight, bench->row_bytes);
+			bench_batch_send(bench, &sizer, &binder, &single);
+		}
+		if(bench->rows % LOAD_BATCH_AGE_CHECK_ROWS == 0) {
+			load_partitions_age(&partitions);
+		}
+	}
+
+	load_partitions_finish(&partitions);
+	flight_binder_destroy(&binder);
+}
+
+/*
+  "Naive Async Prepared SQL Inserts": a slot per request, up to
+  --concurrency, with the throttle's window deciding how many are in
+  flight. Callbacks only store the latency in their slot; the main thread
+  records it when it reuses the slot, so Samples is never touched
+  concurrently.
+*/
+struct AsyncSlot_ {
+	struct AsyncWindow_* window;
+	struct AsyncSlot_* next_free;
+	CassStatement* statement;
+	long long start;
+	long long latency;		/* -1 until a completed request is recorded */
+} ;
+
+typedef struct AsyncSlot_ AsyncSlot;
+
+struct AsyncWindow_ {
+	pthread_mutex_t lock;
+	pthread_cond_t slot_freed;
+	AsyncSlot* free_list;
+	int in_flight;
+	int failed;
+	LoadThrottle* throttle;
+	AsyncSlot* slots;
+} ;
+
+typedef struct AsyncWindow_ AsyncWindow;
+
+void on_insert_complete(CassFuture* future, void* data) {
+	AsyncSlot* slot = (AsyncSlot*)data;
+	AsyncWindow* window = slot->window;
+	long long latency = now_ns(CLOCK_MONOTONIC) - slot->start;
+	CassError rc = cass_future_error_code(future);
+	int failed = rc != CASS_OK;
+
+	load_throttle_end(window->throttle, rc);
+	if(failed) {
+		print_error(future);
+	}
+
+	pthread_mutex_lock(&window->lock);
+	slot->latency = latency;
+	slot->next_free = window->free_list;
+	window->free_list = slot;
+	window->in_flight--;
+	window->failed |= failed;
+	pthread_cond_signal(&window->slot_freed);
+	pthread_mutex_unlock(&window->lock);
+}
+
+void run_async(Bench* bench, FlightReader* reader) {
+	FlightBinder binder;
+	LoadThrottle throttle;
+	AsyncWindow window;
+	Flight flight;
+	int i;
+
+	if(load_throttle_init(&throttle, 0.0, 0.0, bench->concurrency) != 0) {
+		bench->failed = 1;
+		return;
+	}
+	window.slots = calloc((size_t)bench->concurrency, sizeof(AsyncSlot));
+	if(window.slots == NULL || flight_binder_init(&binder, bench->prepared, bench->concurrency) != 0) {
+		free(window.slots);
+		load_throttle_destroy(&throttle);
+		bench->failed = 1;
+		return;
+	}
+	pthread_mutex_init(&window.lock, NULL);
+	pthread_cond_init(&window.slot_freed, NULL);
+	window.free_list = NULL;
+	window.in_flight = 0;
+	window.failed = 0;
+	window.throttle = &throttle;
+
+	for(i = bench->concurrency - 1; i >= 0; --i) {
+		window.slots[i].window = &window;
+		window.slots[i].statement = flight_binder_acquire(&binder);
+		window.slots[i].latency = -1;
+		window.slots[i].next_free = window.free_list;
+		window.free_list = &window.slots[i];
+	}
+
+	while(bench_next(bench, reader, &flight)) {
+		AsyncSlot* slot = NULL;
+		CassFuture* future = NULL;
+
+		pthread_mutex_lock(&window.lock);
+		while(window.free_list == NULL) {
+			pthread_cond_wait(&window.slot_freed, &window.lock);
+		}
+		slot = window.free_list;
+		window.free_list = slot->next_free;
+		window.in_flight++;
+		pthread_mutex_unlock(&window.lock);
+
+		if(slot->latency >= 0) {
+			samples_add(&bench->samples, slot->latency);
+			slot->latency = -1;
+		}
+
+		flight_binder_bind(&binder, slot->statement, &flight);
+		load_throttle_begin(&throttle);
+		slot->start = now_ns(CLOCK_MONOTONIC);
+		future = cass_session_execute(bench->session, slot->statement);
+		cass_future_set_callback(future, on_insert_complete, slot);
+		cass_future_free(future);
+	}
+
+	pthread_mutex_lock(&window.lock);
+	while(window.in_flight > 0) {
+		pthread_cond_wait(&window.slot_freed, &window.lock);
+	}
+	pthread_mutex_unlock(&window.lock);
+
+	for(i = 0; i < bench->concurrency; ++i) {
+		if(window.slots[i].latency >= 0) {
+			samples_add(&bench->samples, window.slots[i].latency);
+		}
+		flight_binder_release(&binder, window.slots[i].statement);
+	}
+	bench->failed |= window.failed;
+
+	pthread_cond_destroy(&window.slot_freed);
+	pthread_mutex_destroy(&window.lock);
+	flight_binder_destroy(&binder);
+	load_throttle_destroy(&throttle);
+	free(window.slots);
+}
+
+typedef void (*BenchModeFn)(Bench* bench, FlightReader* reader);
+
+struct BenchMode_ {
+	const char*		name;
+	BenchModeFn		run;
+} ;
+
+typedef struct BenchMode_ BenchMode;
+
+static const BenchMode bench_modes[] = {
+	{ "simple", run_simple },
+	{ "prepared", run_prepared },
+	{ "batch", run_batch },
+	{ "partition", run_partition },
+	{ "async", run_async }
+};
+
+struct TrialResult_ {
+	long		rows;
+	long		requests;
+	double		seconds;
+	double		cpu_seconds;
+	size_t		bytes;
+	double		p50_us;
+	double		p99_us;
+	double		p999_us;
+	int			failed;
+} ;
+
+typedef struct TrialResult_ TrialResult;
+
+int run_trial(Bench* bench, const BenchMode* mode, const char* path, TrialResult* result) {
+	FlightReader* reader = NULL;
+	long long wall = 0, cpu = 0;
+
+	if(execute_stmt(bench->session, "TRUNCATE flights;") != CASS_OK) {
+		return -1;
+	}
+
+	reader = flight_reader_open(path);
+	if(reader == NULL) {
+		fprintf(stderr, "Error: unable to open %s\n", path);
+		return -1;
+	}
+
+	bench->samples.count = 0;
+	bench->rows = 0;
+	bench->bytes = 0;
+	bench->failed = 0;
+
+	wall = now_ns(CLOCK_MONOTONIC);
+	cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+	mode->run(bench, reader);
+	cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	wall = now_ns(CLOCK_MONOTONIC) - wall;
+
+	flight_reader_close(reader);
+
+	qsort(bench->samples.values, bench->samples.count, sizeof(long long), compare_samples);
+
+	result->rows = bench->rows;
+	result->requests = (long)bench->samples.count;
+	result->seconds = wall / 1e9;
+	result->cpu_seconds = cpu / 1e9;
+	result->bytes = bench->bytes;
+	result->p50_us = samples_percentile_us(&bench->samples, 50.0);
+	result->p99_us = samples_percentile_us(&bench->samples, 99.0);
+	result->p999_us = samples_percentile_us(&bench->samples, 99.9);
+	result->failed = bench->failed;
+
+	return 0;
+}
+
+void print_trial(const char* mode, const char* trial, const TrialResult* result) {
+	double seconds = result->seconds > 0.0 ? result->seconds : 1e-9;
+
+	printf("%s\t%s\t%ld\t%.6f\t%.1f\t%.3f\t%ld\t%.1f\t%.1f\t%.1f\t%.3f\n",
+		mode, trial, result->rows, result->seconds,
+		result->rows / seconds, result->bytes / seconds / 1e6, result->requests,
+		result->p50_us, result->p99_us, result->p999_us,
+		result->rows > 0 ? result->cpu_seconds * 1e6 / result->rows : 0.0);
+}
+
+int compare_throughput(const void* a, const void* b) {
+	const TrialResult* x = (const TrialResult*)a;
+	const TrialResult* y = (const TrialResult*)b;
+	double rx = x->seconds > 0.0 ? x->rows / x->seconds : 0.0;
+	double ry = y->seconds > 0.0 ? y->rows / y->seconds : 0.0;
+	return rx < ry ? -1 : rx > ry;
+}
+
+/* True if name appears in the comma separated list. */
+int mode_selected(const char* list, const char* name) {
+	size_t length = strlen(name);
+	const char* p = list;
+
+	while(*p != '\0') {
+		const char* comma = strchr(p, ',');
+		size_t item = comma != NULL ? (size_t)(comma - p) : strlen(p);
+
+		if(item == length && strncmp(p, name, length) == 0) {
+			return 1;
+		}
+		p += item;
+		if(*p == ',') {
+			p++;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* path = DEFAULT_INPUT;
+	const char* modes = "simple,prepared,batch,partition,async";
+	int trials = 3;
+	int rows = 0;
+	int batch_rows = LOAD_BATCH_ROWS;
+	int max_batch_age_ms = 1000;
+	int adaptive_batches = 0;
+	int max_batch_bytes = 5 * 1024;
+	int target_latency_ms = 20;
+	int concurrency = 250;
+	int failed = 0;
+	TrialResult results[MAX_TRIALS];
+	Bench bench;
+	char trial_name[16];
+	char query[1024];
+	int i, m;
+
+	CassError rc = CASS_OK;
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
+	CassSession* session = NULL;
+	CassFuture* close_future = NULL;
+	const CassPrepared* prepared = NULL;
+
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &path, "flights CSV (optionally .gz or .zst, - for stdin), or a file from the binary converter" },
+		{ "--modes", LOAD_OPTION_STRING, &modes, "comma separated: simple,prepared,batch,partition,async" },
+		{ "--trials", LOAD_OPTION_INT, &trials, "trials per mode" },
+		{ "--rows", LOAD_OPTION_INT, &rows, "stop each trial after N rows (0 = whole file)" },
+		{ "--batch-rows", LOAD_OPTION_INT, &batch_rows,
+			"rows per batch in batch and partition modes, where adaptive sizing starts (default 100)" },
+		{ "--batch-age-ms", LOAD_OPTION_INT, &max_batch_age_ms,
+			"in partition mode, send a partial batch after N ms (default 1000)" },
+		{ "--adaptive-batches", LOAD_OPTION_FLAG, &adaptive_batches,
+			"size batches from a byte budget and observed latency" },
+		{ "--batch-bytes", LOAD_OPTION_INT, &max_batch_bytes,
+			"with --adaptive-batches, payload budget per batch (default 5120)" },
+		{ "--batch-latency-ms", LOAD_OPTION_INT, &target_latency_ms,
+			"with --adaptive-batches, round trip to stay under (default 20)" },
+		{ "--concurrency", LOAD_OPTION_INT, &concurrency, "most requests in flight in async mode" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	if(trials < 1 || trials > MAX_TRIALS || batch_rows < 1 || batch_rows > LOAD_BATCH_MAX_ROWS || concurrency < 1) {
+		fprintf(stderr, "Error: --trials must be 1 to %d, --batch-rows 1 to %d and --concurrency at least 1\n",
+			MAX_TRIALS, LOAD_BATCH_MAX_ROWS);
+		return -1;
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
+	rc = connect_session(cluster, &session);
+	if(rc != CASS_OK) {
+		return -1;
+	}
+
+	execute_stmt(session,
+					"CREATE KEYSPACE IF NOT EXISTS exercise WITH \
+						replication = {'class': 'SimpleStrategy','replication_factor': '1'};");
+
+	execute_stmt(session,
+					"USE exercise;");
+
+	execute_stmt(session,
+					"DROP TABLE IF EXISTS flights;");
+
+	execute_stmt(session,
+					"CREATE TABLE flights (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (" FLIGHT_SCHEMA_KEY "));");
+
+	if(flight_schema_insert(query, sizeof(query), "flights") != 0 ||
+		prepare_stmt(session, query, &prepared) != CASS_OK) {
+		return -1;
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	bench.session = session;
+	bench.prepared = prepared;
+	bench.max_rows = rows;
+	bench.batch_rows = batch_rows;
+	bench.adaptive_batches = adaptive_batches;
+	bench.max_batch_bytes = (size_t)max_batch_bytes;
+	bench.target_latency = target_latency_ms / 1000.0;
+	bench.max_batch_age = max_batch_age_ms / 1000.0;
+	bench.concurrency = concurrency;
+
+	load_cluster_report(&cluster_settings, stderr);
+	printf("mode\ttrial\trows\tseconds\trows_per_sec\tmb_per_sec\trequests\tp50_us\tp99_us\tp999_us\tcpu_us_per_row\n");
+
+	for(m = 0; m < (int)(sizeof(bench_modes) / sizeof(bench_modes[0])); ++m) {
+		if(!mode_selected(modes, bench_modes[m].name)) {
+			continue;
+		}
+
+		for(i = 0; i < trials; ++i) {
+			if(run_trial(&bench, &bench_modes[m], path, &results[i]) != 0) {
+				failed = 1;
+				break;
+			}
+			failed |= results[i].failed;
+			snprintf(trial_name, sizeof(trial_name), "%d", i + 1);
+			print_trial(bench_modes[m].name, trial_name, &results[i]);
+			fflush(stdout);
+		}
+
+		if(i == trials) {
+			qsort(results, (size_t)trials, sizeof(TrialResult), compare_throughput);
+			print_trial(bench_modes[m].name, "median", &results[trials / 2]);
+		}
+	}
+
+	free(bench.samples.values);
+	cass_prepared_free(prepared);
+
+	close_future = cass_session_close(session);
+	cass_future_wait(close_future);
+	cass_future_free(close_future);
+	cass_cluster_free(cluster);
+
+	return failed ? -1 : 0;
+}
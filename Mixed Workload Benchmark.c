@@ -0,0 +1,669 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Runs a mix of inserts, single row reads and clustering range slices
+  against exercise.flights for --duration seconds, as a cluster serving
+  queries while a load runs would see it. Run one of the loaders first.
+
+  Keys come from the loaded data: up to --sample rows of --input are read
+  and grouped by (carrier, origin). Each operation picks a group, either
+  uniformly or with zipfian skew where the group with the most rows is
+  the most popular, and then a sampled row of that group:
+
+  - read: the row, by its full primary key
+  - slice: up to --slice-rows rows from its id on that share its
+    (origin, air_time_grp) clustering prefix, within its carrier's partition
+  - insert: a copy of the row under a new id, so the table grows as it
+    would during a load
+
+  Operations are sent asynchronously with at most --concurrency in flight,
+  optionally paced to --rate operations/sec, and each kind reports its
+  throughput and latency percentiles:
+
+    cc -O2 "Mixed Workload Benchmark.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c csv_scan.c \
+       flight_direct.c flight_decompress.c flight_binder.c flight_schema.c load_options.c load_cluster.c load_stats.c \
+       latency_histogram.c load_throttle.c -lcassandra -lz -lzstd -lpthread -lm
+    ./a.out --duration 60 --distribution zipfian --insert-weight 20 --read-weight 70 --slice-weight 10
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+
+#include "flight_binder.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "latency_histogram.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_stats.h"
+#include "load_throttle.h"
+
+#define WHERE_ROW "WHERE carrier = ? AND origin = ? AND air_time_grp = ? AND id = ?;"
+
+/* The LIMIT is part of the statement, since it cannot be bound. */
+#define WHERE_SLICE "WHERE carrier = ? AND origin = ? AND air_time_grp = ? AND id >= ? LIMIT %d;"
+
+/* Failures past this many are only counted, so an overloaded cluster does not flood stderr. */
+#define MAX_PRINTED_ERRORS 10
+
+typedef enum WorkloadOp_ {
+	OP_INSERT,
+	OP_READ,
+	OP_SLICE,
+	OP_COUNT
+} WorkloadOp;
+
+static const char* op_names[OP_COUNT] = { "insert", "read", "slice" };
+
+/*
+  Sampled rows, and the (carrier, origin) groups they fall into. order
+  lists the rows sorted by primary key, so each group is a run of it.
+  Rows are FlightRows and must not move, hence the separate order.
+*/
+struct KeySample_ {
+	FlightReader*	reader;			/* open while rows are in use */
+	FlightRow*		rows;
+	int*			order;
+	int				num_rows;
+	int*			group_first;	/* by popularity: most rows first */
+	int*			group_count;
+	double*			group_cdf;		/* probability of picking groups 0 .. i */
+	int				num_groups;
+	int				max_id;
+} ;
+
+typedef struct KeySample_ KeySample;
+
+/* An operation from the time it is sent until its callback has run. */
+struct WorkloadSlot_ {
+	struct Workload_*		workload;
+	struct WorkloadSlot_*	next_free;
+	CassStatement*			statement;
+	WorkloadOp				op;
+	long long				submitted;
+	Flight					flight;		/* the row an insert sends */
+} ;
+
+typedef struct WorkloadSlot_ WorkloadSlot;
+
+struct Workload_ {
+	pthread_mutex_t		lock;
+	pthread_cond_t		slot_freed;
+	WorkloadSlot*		free_list;
+	int					in_flight;
+	WorkloadSlot*		slots;
+	int					num_slots;
+
+	/* Recorded by driver callbacks, without the lock. */
+	LatencyHistogram	latency[OP_COUNT];
+	long				errors[OP_COUNT];
+	long				rows_read[OP_COUNT];
+} ;
+
+typedef struct Workload_ Workload;
+
+void print_error(CassFuture* future) {
+  CassString message = cass_future_error_message(future);
+  fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+}
+
+CassError connect_session(CassCluster* cluster, CassSession** output) {
+  CassError rc = CASS_OK;
+  CassFuture* future = cass_cluster_connect(cluster);
+
+  *output = NULL;
+
+  cass_future_wait(future);
+  rc = cass_future_error_code(future);
+  if(rc != CASS_OK) {
+    print_error(future);
+  } else {
+    *output = cass_future_get_session(future);
+  }
+  cass_future_free(future);
+
+  return rc;
+}
+
+CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared** prepared) {
+	CassError rc = CASS_OK;
+	CassFuture* future = NULL;
+	CassString query = cass_string_init(sql);
+
+	future = cass_session_prepare(session, query);
+	cass_future_wait(future);
+
+	rc = cass_future_error_code(future);
+	if(rc != CASS_OK) {
+		print_error(future);
+	} else {
+		*prepared = cass_future_get_prepared(future);
+	}
+
+	cass_future_free(future);
+
+	return rc;
+}
+
+/* xorshift64*: cheap, and the same --seed gives the same sequence of operations. */
+static unsigned long long next_random(unsigned long long* state) {
+	unsigned long long x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* Uniform in [0, 1). */
+static double next_unit(unsigned long long* state) {
+	return (double)(next_random(state) >> 11) / 9007199254740992.0;
+}
+
+static int compare_strings(const FlightString* a, const FlightString* b) {
+	size_t length = a->length < b->length ? a->length : b->length;
+	int rc = memcmp(a->data, b->data, length);
+
+	if(rc != 0) {
+		return rc;
+	}
+	return a->length < b->length ? -1 : a->length > b->length;
+}
+
+static int compare_ints(int a, int b) {
+	return a < b ? -1 : a > b;
+}
+
+/* qsort has no context argument; the rows being sorted are set just before. */
+static const FlightRow* sort_rows = NULL;
+
+static int compare_keys(const void* a, const void* b) {
+	const Flight* x = &sort_rows[*(const int*)a].flight;
+	const Flight* y = &sort_rows[*(const int*)b].flight;
+	int rc = compare_strings(&x->carrier, &y->carrier);
+
+	if(rc == 0) {
+		rc = compare_strings(&x->origin, &y->origin);
+	}
+	if(rc == 0) {
+		rc = compare_ints(x->air_time / 10, y->air_time / 10);
+	}
+	if(rc == 0) {
+		rc = compare_ints(x->id, y->id);
+	}
+	return rc;
+}
+
+static const int* sort_counts = NULL;
+
+static int compare_popularity(const void* a, const void* b) {
+	return compare_ints(sort_counts[*(const int*)b], sort_counts[*(const int*)a]);
+}
+
+static int same_group(const Flight* a, const Flight* b) {
+	return compare_strings(&a->carrier, &b->carrier) == 0 && compare_strings(&a->origin, &b->origin) == 0;
+}
+
+/* Groups sample->rows by (carrier, origin) and sets up the chosen distribution. */
+static int build_groups(KeySample* sample, int zipfian, double exponent) {
+	int* first = NULL;
+	int* count = NULL;
+	int* rank = NULL;
+	double total = 0;
+	int i;
+
+	sample->order = malloc((size_t)sample->num_rows * sizeof(int));
+	first = malloc((size_t)sample->num_rows * sizeof(int));
+	count = malloc((size_t)sample->num_rows * sizeof(int));
+	if(sample->order == NULL || first == NULL || count == NULL) {
+		free(first);
+		free(count);
+		return -1;
+	}
+
+	for(i = 0; i < sample->num_rows; ++i) {
+		sample->order[i] = i;
+	}
+	sort_rows = sample->rows;
+	qsort(sample->order, (size_t)sample->num_rows, sizeof(int), compare_keys);
+
+	sample->num_groups = 0;
+	for(i = 0; i < sample->num_rows; ++i) {
+		const Flight* flight = &sample->rows[sample->order[i]].flight;
+
+		if(i == 0 || !same_group(flight, &sample->rows[sample->order[i - 1]].flight)) {
+			first[sample->num_groups] = i;
+			count[sample->num_groups] = 0;
+			sample->num_groups++;
+		}
+		count[sample->num_groups - 1]++;
+	}
+
+	/* Rank the groups by how many rows they have. */
+	rank = malloc((size_t)sample->num_groups * sizeof(int));
+	sample->group_first = malloc((size_t)sample->num_groups * sizeof(int));
+	sample->group_count = malloc((size_t)sample->num_groups * sizeof(int));
+	sample->group_cdf = malloc((size_t)sample->num_groups * sizeof(double));
+	if(rank == NULL || sample->group_first == NULL || sample->group_count == NULL || sample->group_cdf == NULL) {
+		free(rank);
+		free(first);
+		free(count);
+		return -1;
+	}
+	for(i = 0; i < sample->num_groups; ++i) {
+		rank[i] = i;
+	}
+	sort_counts = count;
+	qsort(rank, (size_t)sample->num_groups, sizeof(int), compare_popularity);
+
+	for(i = 0; i < sample->num_groups; ++i) {
+		sample->group_first[i] = first[rank[i]];
+		sample->group_count[i] = count[rank[i]];
+		total += zipfian ? 1.0 / pow((double)(i + 1), exponent) : 1.0;
+		sample->group_cdf[i] = total;
+	}
+	for(i = 0; i < sample->num_groups; ++i) {
+		sample->group_cdf[i] /= total;
+	}
+
+	free(rank);
+	free(first);
+	free(count);
+	return 0;
+}
+
+/* Reads up to max_rows rows of path. Returns -1 if it cannot, or has no rows. */
+static int sample_keys(KeySample* sample, const char* path, int max_rows, int zipfian, double exponent) {
+	Flight flight;
+
+	memset(sample, 0, sizeof(KeySample));
+	sample->rows = malloc((size_t)max_rows * sizeof(FlightRow));
+	if(sample->rows == NULL) {
+		fprintf(stderr, "Error: out of memory for %d sampled rows\n", max_rows);
+		return -1;
+	}
+
+	sample->reader = flight_reader_open(path);
+	if(sample->reader == NULL) {
+		return -1;
+	}
+	while(sample->num_rows < max_rows && flight_reader_next(sample->reader, &flight)) {
+		if(flight_row_copy(&sample->rows[sample->num_rows], &flight) != 0) {
+			continue;
+		}
+		if(flight.id > sample->max_id) {
+			sample->max_id = flight.id;
+		}
+		sample->num_rows++;
+	}
+	if(sample->num_rows == 0) {
+		fprintf(stderr, "Error: no rows to take keys from in %s\n", path);
+		return -1;
+	}
+	if(build_groups(sample, zipfian, exponent) != 0) {
+		fprintf(stderr, "Error: out of memory grouping %d sampled rows\n", sample->num_rows);
+		return -1;
+	}
+	return 0;
+}
+
+static void free_keys(KeySample* sample) {
+	flight_reader_close(sample->reader);
+	free(sample->rows);
+	free(sample->order);
+	free(sample->group_first);
+	free(sample->group_count);
+	free(sample->group_cdf);
+}
+
+/* Picks a group by the distribution, then one of its rows uniformly. */
+static const Flight* pick_row(const KeySample* sample, unsigned long long* random) {
+	double u = next_unit(random);
+	int low = 0, high = sample->num_groups - 1;
+	int row = 0;
+
+	while(low < high) {
+		int mid = low + (high - low) / 2;
+		if(sample->group_cdf[mid] > u) {
+			high = mid;
+		} else {
+			low = mid + 1;
+		}
+	}
+
+	row = sample->group_first[low] + (int)(next_random(random) % (unsigned long long)sample->group_count[low]);
+	return &sample->rows[sample->order[row]].flight;
+}
+
+static WorkloadOp pick_op(const int* weights, int total, unsigned long long* random) {
+	int n = (int)(next_random(random) % (unsigned long long)total);
+	int op;
+
+	for(op = 0; op < OP_COUNT - 1; ++op) {
+		if(n < weights[op]) {
+			break;
+		}
+		n -= weights[op];
+	}
+	return (WorkloadOp)op;
+}
+
+static int workload_init(Workload* workload, int num_slots) {
+	int i;
+
+	memset(workload, 0, sizeof(Workload));
+	workload->slots = calloc((size_t)num_slots, sizeof(WorkloadSlot));
+	if(workload->slots == NULL) {
+		return -1;
+	}
+	workload->num_slots = num_slots;
+	pthread_mutex_init(&workload->lock, NULL);
+	pthread_cond_init(&workload->slot_freed, NULL);
+	for(i = num_slots - 1; i >= 0; --i) {
+		workload->slots[i].workload = workload;
+		workload->slots[i].next_free = workload->free_list;
+		workload->free_list = &workload->slots[i];
+	}
+	for(i = 0; i < OP_COUNT; ++i) {
+		latency_histogram_init(&workload->latency[i]);
+	}
+	return 0;
+}
+
+static WorkloadSlot* workload_acquire(Workload* workload) {
+	WorkloadSlot* slot = NULL;
+
+	pthread_mutex_lock(&workload->lock);
+	while(workload->free_list == NULL) {
+		pthread_cond_wait(&workload->slot_freed, &workload->lock);
+	}
+	slot = workload->free_list;
+	workload->free_list = slot->next_free;
+	workload->in_flight++;
+	pthread_mutex_unlock(&workload->lock);
+
+	return slot;
+}
+
+/* Waits until every operation sent has completed. */
+static void workload_drain(Workload* workload) {
+	pthread_mutex_lock(&workload->lock);
+	while(workload->in_flight > 0) {
+		pthread_cond_wait(&workload->slot_freed, &workload->lock);
+	}
+	pthread_mutex_unlock(&workload->lock);
+}
+
+/* Returns the statement of a slot's last operation; slots are only reused from main. */
+static void slot_reset(WorkloadSlot* slot, FlightBinder* binder) {
+	if(slot->statement == NULL) {
+		return;
+	}
+	if(slot->op == OP_INSERT) {
+		flight_binder_release(binder, slot->statement);
+	} else {
+		cass_statement_free(slot->statement);
+	}
+	slot->statement = NULL;
+}
+
+/* Runs on a driver I/O thread. */
+void on_operation_complete(CassFuture* future, void* data) {
+	WorkloadSlot* slot = (WorkloadSlot*)data;
+	Workload* workload = slot->workload;
+	CassError rc = cass_future_error_code(future);
+	long long latency = load_stats_now() - slot->submitted;
+
+	if(rc != CASS_OK) {
+		if(__sync_fetch_and_add(&workload->errors[slot->op], 1) < MAX_PRINTED_ERRORS) {
+			print_error(future);
+		}
+	} else {
+		latency_histogram_record(&workload->latency[slot->op], latency);
+		if(slot->op != OP_INSERT) {
+			const CassResult* result = cass_future_get_result(future);
+			__sync_fetch_and_add(&workload->rows_read[slot->op], (long)cass_result_row_count(result));
+			cass_result_free(result);
+		}
+	}
+
+	pthread_mutex_lock(&workload->lock);
+	slot->next_free = workload->free_list;
+	workload->free_list = slot;
+	workload->in_flight--;
+	pthread_cond_signal(&workload->slot_freed);
+	pthread_mutex_unlock(&workload->lock);
+}
+
+static void bind_key(CassStatement* statement, const Flight* flight) {
+	cass_statement_bind_string(statement, 0, cass_string_init2(flight->carrier.data, flight->carrier.length));
+	cass_statement_bind_string(statement, 1, cass_string_init2(flight->origin.data, flight->origin.length));
+	cass_statement_bind_int32(statement, 2, flight->air_time / 10);
+	cass_statement_bind_int32(statement, 3, flight->id);
+}
+
+static void print_op(const Workload* workload, WorkloadOp op, double seconds) {
+	const LatencyHistogram* latency = &workload->latency[op];
+
+	printf("%-6s %10ld ops %10.0f ops/sec %6ld errors", op_names[op], latency->count,
+		seconds > 0 ? (double)latency->count / seconds : 0.0, workload->errors[op]);
+	if(op != OP_INSERT) {
+		printf(" %8.2f rows/op", latency->count > 0 ? (double)workload->rows_read[op] / (double)latency->count : 0.0);
+	}
+	printf("\n       latency ms: mean %.2f, p50 %.2f, p95 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n",
+		latency_histogram_mean(latency) / 1e6,
+		(double)latency_histogram_percentile(latency, 50.0) / 1e6,
+		(double)latency_histogram_percentile(latency, 95.0) / 1e6,
+		(double)latency_histogram_percentile(latency, 99.0) / 1e6,
+		(double)latency_histogram_percentile(latency, 99.9) / 1e6,
+		(double)latency->max / 1e6);
+}
+
+int main(int argc, char* argv[]) {
+	const char* input = "/Users/carybourgeois/flights_exercise/flights_from_pg.csv";
+	const char* distribution = "uniform";
+	double exponent = 1.0;
+	int num_samples = 200000;
+	int duration = 30;
+	int concurrency = 128;
+	double rate = 0;
+	int slice_rows = 100;
+	int weights[OP_COUNT] = { 20, 70, 10 };
+	int total_weight = 0;
+	int seed = 1;
+	int num_parsers = 0;
+	int direct_io = 0;
+	int zipfian = 0;
+	int next_id = 0;
+	int i;
+	char queries[OP_COUNT][1024];
+	char slice_where[sizeof(WHERE_SLICE) + 16];
+	unsigned long long random = 0;
+	long long start = 0, end = 0;
+	double seconds = 0;
+	long errors = 0;
+	KeySample sample;
+	Workload workload;
+	FlightBinder binder;
+	LoadThrottle throttle;
+
+	CassError rc = CASS_OK;
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
+	CassSession* session = NULL;
+	CassFuture* close_future = NULL;
+	const CassPrepared* prepared[OP_COUNT] = { NULL, NULL, NULL };
+
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "loaded flights file to take keys and inserted rows from" },
+		{ "--sample", LOAD_OPTION_INT, &num_samples, "read at most N rows of the input for keys" },
+		{ "--distribution", LOAD_OPTION_STRING, &distribution, "uniform or zipfian over (carrier, origin)" },
+		{ "--zipf-exponent", LOAD_OPTION_DOUBLE, &exponent, "skew of the zipfian distribution (default 1.0)" },
+		{ "--duration", LOAD_OPTION_INT, &duration, "seconds to run" },
+		{ "--concurrency", LOAD_OPTION_INT, &concurrency, "operations in flight" },
+		{ "--rate", LOAD_OPTION_DOUBLE, &rate, "send at most N operations/sec (0 for as fast as possible)" },
+		{ "--insert-weight", LOAD_OPTION_INT, &weights[OP_INSERT], "relative share of inserts (default 20)" },
+		{ "--read-weight", LOAD_OPTION_INT, &weights[OP_READ], "relative share of single row reads (default 70)" },
+		{ "--slice-weight", LOAD_OPTION_INT, &weights[OP_SLICE], "relative share of clustering range slices within a carrier (default 10)" },
+		{ "--slice-rows", LOAD_OPTION_INT, &slice_rows, "rows a slice reads at most" },
+		{ "--seed", LOAD_OPTION_INT, &seed, "seed of the operation and key sequence" },
+		{ "--parser-threads", LOAD_OPTION_INT, &num_parsers, "parse the input on N more threads" },
+		{ "--direct-io", LOAD_OPTION_FLAG, &direct_io, "read the input with O_DIRECT and io_uring read-ahead" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	for(i = 0; i < OP_COUNT; ++i) {
+		if(weights[i] < 0) {
+			fprintf(stderr, "Error: operation weights cannot be negative\n");
+			return -1;
+		}
+		total_weight += weights[i];
+	}
+	if(total_weight == 0) {
+		fprintf(stderr, "Error: at least one operation weight must be positive\n");
+		return -1;
+	}
+	if(num_samples < 1 || duration < 1 || concurrency < 1 || slice_rows < 1 || rate < 0) {
+		fprintf(stderr, "Error: --sample, --duration, --concurrency and --slice-rows must be at least 1\n");
+		return -1;
+	}
+	if(strcmp(distribution, "zipfian") == 0) {
+		zipfian = 1;
+	} else if(strcmp(distribution, "uniform") != 0) {
+		fprintf(stderr, "Error: --distribution must be uniform or zipfian\n");
+		return -1;
+	}
+	snprintf(slice_where, sizeof(slice_where), WHERE_SLICE, slice_rows);
+	random = (unsigned long long)(unsigned)seed * 0x9e3779b97f4a7c15ULL + 1;
+
+	flight_reader_set_parsers(num_parsers);
+	flight_reader_set_direct(direct_io);
+	if(sample_keys(&sample, input, num_samples, zipfian, exponent) != 0) {
+		return -1;
+	}
+	next_id = sample.max_id + 1;
+	printf("Keys: %d rows sampled from %s, %d (carrier, origin) groups, %s",
+		sample.num_rows, input, sample.num_groups, distribution);
+	if(zipfian) {
+		printf(" with exponent %.2f, the top group gets %.1f%% of operations", exponent, sample.group_cdf[0] * 100.0);
+	}
+	printf(".\n");
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
+	rc = connect_session(cluster, &session);
+	if(rc != CASS_OK) {
+		return -1;
+	}
+
+	if(flight_schema_insert(queries[OP_INSERT], sizeof(queries[OP_INSERT]), "exercise.flights") != 0 ||
+		flight_schema_select(queries[OP_READ], sizeof(queries[OP_READ]), "exercise.flights", WHERE_ROW) != 0 ||
+		flight_schema_select(queries[OP_SLICE], sizeof(queries[OP_SLICE]), "exercise.flights", slice_where) != 0) {
+		return -1;
+	}
+	for(i = 0; i < OP_COUNT; ++i) {
+		if(prepare_stmt(session, queries[i], &prepared[i]) != CASS_OK) {
+			return -1;
+		}
+	}
+
+	if(workload_init(&workload, concurrency) != 0 ||
+		flight_binder_init(&binder, prepared[OP_INSERT], concurrency) != 0 ||
+		load_throttle_init(&throttle, rate, 0, concurrency) != 0) {
+		fprintf(stderr, "Error: out of memory for %d operations in flight\n", concurrency);
+		return -1;
+	}
+
+	start = load_stats_now();
+	end = start + (long long)duration * 1000000000LL;
+	while(load_stats_now() < end) {
+		WorkloadSlot* slot = NULL;
+		CassFuture* future = NULL;
+		const Flight* flight = NULL;
+
+		load_throttle_rate(&throttle, 1, 0);
+		slot = workload_acquire(&workload);
+		slot_reset(slot, &binder);
+
+		slot->op = pick_op(weights, total_weight, &random);
+		flight = pick_row(&sample, &random);
+		if(slot->op == OP_INSERT) {
+			slot->flight = *flight;
+			slot->flight.id = next_id++;
+			slot->statement = flight_binder_acquire(&binder);
+			flight_binder_bind(&binder, slot->statement, &slot->flight);
+		} else {
+			slot->statement = cass_prepared_bind(prepared[slot->op]);
+			load_cluster_apply(slot->statement);
+			bind_key(slot->statement, flight);
+		}
+
+		slot->submitted = load_stats_now();
+		future = cass_session_execute(session, slot->statement);
+		/* The driver keeps its own reference until the callback has run. */
+		cass_future_set_callback(future, on_operation_complete, slot);
+		cass_future_free(future);
+	}
+	workload_drain(&workload);
+	seconds = (double)(load_stats_now() - start) / 1e9;
+
+	printf("Workload: %.2f seconds, %d in flight", seconds, concurrency);
+	if(rate > 0) {
+		printf(", paced to %.0f ops/sec", rate);
+	}
+	printf(", weights insert %d, read %d, slice %d (up to %d rows).\n",
+		weights[OP_INSERT], weights[OP_READ], weights[OP_SLICE], slice_rows);
+	for(i = 0; i < OP_COUNT; ++i) {
+		if(weights[i] > 0) {
+			print_op(&workload, (WorkloadOp)i, seconds);
+		}
+		errors += workload.errors[i];
+	}
+	load_cluster_report(&cluster_settings, stdout);
+
+	for(i = 0; i < concurrency; ++i) {
+		slot_reset(&workload.slots[i], &binder);
+	}
+	flight_binder_destroy(&binder);
+	load_throttle_destroy(&throttle);
+	pthread_cond_destroy(&workload.slot_freed);
+	pthread_mutex_destroy(&workload.lock);
+	free(workload.slots);
+	free_keys(&sample);
+	for(i = 0; i < OP_COUNT; ++i) {
+		cass_prepared_free(prepared[i]);
+	}
+
+	close_future = cass_session_close(session);
+	cass_future_wait(close_future);
+	cass_future_free(close_future);
+	cass_cluster_free(cluster);
+
+	return errors > 0 ? -1 : 0;
+}
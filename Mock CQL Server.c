@@ -0,0 +1,986 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  A stand-in for Cassandra that speaks just enough of the native protocol
+  (versions 1 and 2) for the loaders: STARTUP, OPTIONS, REGISTER, QUERY,
+  PREPARE, EXECUTE and BATCH. Nothing is stored. Writes (INSERT, UPDATE,
+  DELETE, EXECUTE and BATCH) can be slowed down, throttled and failed, so
+  the client side of the loaders can be benchmarked and profiled without a
+  cluster:
+
+    cc -O2 "Mock CQL Server.c" load_options.c -o mock_cql_server
+    ./mock_cql_server --latency-us 500 --jitter-us 200 --write-timeout-rate 0.001
+
+  Every response is queued with a due time of now + latency + jitter. With
+  --max-rows-per-sec, writes are also spaced out so that no more rows than
+  that are acknowledged per second (a batch counts as its statements).
+  Delays have the resolution of poll(), about a millisecond, unless the
+  server is busy. SELECTs return no rows, and bind markers of prepared
+  statements are described as blobs; the loaders only ever write.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "load_options.h"
+
+#define MAX_CONNECTIONS 256
+#define MAX_PREPARED 1024
+#define MAX_FRAME_LENGTH (256 * 1024 * 1024)
+#define FRAME_HEADER_LENGTH 8
+#define READ_CHUNK 65536
+
+#define OPCODE_ERROR			0x00
+#define OPCODE_STARTUP			0x01
+#define OPCODE_READY			0x02
+#define OPCODE_OPTIONS			0x05
+#define OPCODE_SUPPORTED		0x06
+#define OPCODE_QUERY			0x07
+#define OPCODE_RESULT			0x08
+#define OPCODE_PREPARE			0x09
+#define OPCODE_EXECUTE			0x0A
+#define OPCODE_REGISTER			0x0B
+#define OPCODE_BATCH			0x0D
+
+#define RESULT_VOID				0x0001
+#define RESULT_ROWS				0x0002
+#define RESULT_SET_KEYSPACE		0x0003
+#define RESULT_PREPARED			0x0004
+
+#define ERROR_PROTOCOL			0x000A
+#define ERROR_OVERLOADED		0x1001
+#define ERROR_WRITE_TIMEOUT		0x1100
+#define ERROR_INVALID			0x2200
+
+#define CONSISTENCY_ONE			0x0001
+#define TYPE_BLOB				0x0003
+
+struct Buffer_ {
+	unsigned char*	data;
+	size_t			length;
+	size_t			capacity;
+} ;
+
+typedef struct Buffer_ Buffer;
+
+struct Connection_ {
+	int				fd;				/* -1 when the slot is free */
+	unsigned		generation;		/* bumped on close so queued responses are dropped */
+	Buffer			in;
+	Buffer			out;
+	char			keyspace[64];
+} ;
+
+typedef struct Connection_ Connection;
+
+/* A response waiting for its due time. */
+struct Pending_ {
+	long long		due;
+	int				connection;
+	unsigned		generation;
+	unsigned char*	frame;
+	size_t			length;
+} ;
+
+typedef struct Pending_ Pending;
+
+struct PendingHeap_ {
+	Pending*		items;
+	size_t			count;
+	size_t			capacity;
+} ;
+
+typedef struct PendingHeap_ PendingHeap;
+
+/* Cursor over a request body; any overrun sets failed instead of reading past end. */
+struct Reader_ {
+	const unsigned char*	p;
+	const unsigned char*	end;
+	int						failed;
+} ;
+
+typedef struct Reader_ Reader;
+
+struct ServerStats_ {
+	long			requests;
+	long			writes;
+	long			rows;
+	long			write_timeouts;
+	long			overloaded;
+} ;
+
+typedef struct ServerStats_ ServerStats;
+
+/*
+  A prepared statement, found by the hash of its keyspace and text. Like
+  Cassandra, whose ids are such a hash, the mock gives the same statement
+  the same id every time it is prepared, so ids do not run out however
+  many loader runs a long lived mock serves.
+*/
+struct Prepared_ {
+	unsigned long long	hash;
+	char*				key;		/* keyspace, NUL, query; NULL for a free slot */
+	size_t				key_length;
+	int					write;
+} ;
+
+typedef struct Prepared_ Prepared;
+
+struct Server_ {
+	int				listener;
+	Connection		connections[MAX_CONNECTIONS];
+	Prepared		prepared[MAX_PREPARED];	/* open addressing; the slot is the id */
+	int				num_prepared;
+	PendingHeap		pending;
+
+	double			latency_us;
+	double			jitter_us;
+	double			write_timeout_rate;
+	double			overloaded_rate;
+	double			max_rows_per_sec;
+	long long		throttle_clock;			/* earliest due time of the next throttled write */
+	unsigned long long	random;
+
+	ServerStats		stats;
+	ServerStats		reported;
+} ;
+
+typedef struct Server_ Server;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int signal) {
+	(void)signal;
+	stopping = 1;
+}
+
+static long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* xorshift64*, uniform in [0, 1) */
+static double next_random(Server* server) {
+	server->random ^= server->random >> 12;
+	server->random ^= server->random << 25;
+	server->random ^= server->random >> 27;
+	return (double)((server->random * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static int buffer_reserve(Buffer* buffer, size_t extra) {
+	if(buffer->length + extra > buffer->capacity) {
+		size_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+		unsigned char* data = NULL;
+
+		while(capacity < buffer->length + extra) {
+			capacity *= 2;
+		}
+		data = realloc(buffer->data, capacity);
+		if(data == NULL) {
+			return -1;
+		}
+		buffer->data = data;
+		buffer->capacity = capacity;
+	}
+	return 0;
+}
+
+static void buffer_append(Buffer* buffer, const void* data, size_t length) {
+	if(buffer_reserve(buffer, length) == 0) {
+		memcpy(buffer->data + buffer->length, data, length);
+		buffer->length += length;
+	}
+}
+
+static void buffer_consume(Buffer* buffer, size_t length) {
+	memmove(buffer->data, buffer->data + length, buffer->length - length);
+	buffer->length -= length;
+}
+
+static void buffer_free(Buffer* buffer) {
+	free(buffer->data);
+	buffer->data = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+}
+
+static void put_short(Buffer* buffer, unsigned value) {
+	unsigned char bytes[2];
+	bytes[0] = (unsigned char)(value >> 8);
+	bytes[1] = (unsigned char)value;
+	buffer_append(buffer, bytes, 2);
+}
+
+static void put_int(Buffer* buffer, unsigned value) {
+	unsigned char bytes[4];
+	bytes[0] = (unsigned char)(value >> 24);
+	bytes[1] = (unsigned char)(value >> 16);
+	bytes[2] = (unsigned char)(value >> 8);
+	bytes[3] = (unsigned char)value;
+	buffer_append(buffer, bytes, 4);
+}
+
+/* [string]: a short length followed by the bytes. */
+static void put_string(Buffer* buffer, const char* data, size_t length) {
+	put_short(buffer, (unsigned)length);
+	buffer_append(buffer, data, length);
+}
+
+static unsigned get_byte(Reader* reader) {
+	if(reader->end - reader->p < 1) {
+		reader->failed = 1;
+		return 0;
+	}
+	return *reader->p++;
+}
+
+static unsigned get_short(Reader* reader) {
+	unsigned value = 0;
+	if(reader->end - reader->p < 2) {
+		reader->failed = 1;
+		return 0;
+	}
+	value = (unsigned)reader->p[0] << 8 | reader->p[1];
+	reader->p += 2;
+	return value;
+}
+
+static long get_int(Reader* reader) {
+	unsigned long value = 0;
+	if(reader->end - reader->p < 4) {
+		reader->failed = 1;
+		return 0;
+	}
+	value = (unsigned long)reader->p[0] << 24 | (unsigned long)reader->p[1] << 16 |
+		(unsigned long)reader->p[2] << 8 | reader->p[3];
+	reader->p += 4;
+	return (long)(int)value;
+}
+
+static const unsigned char* get_bytes(Reader* reader, size_t length) {
+	const unsigned char* data = reader->p;
+	if((size_t)(reader->end - reader->p) < length) {
+		reader->failed = 1;
+		return NULL;
+	}
+	reader->p += length;
+	return data;
+}
+
+/* [long string] */
+static const char* get_long_string(Reader* reader, size_t* length) {
+	long n = get_int(reader);
+	if(n < 0) {
+		reader->failed = 1;
+		n = 0;
+	}
+	*length = (size_t)n;
+	return (const char*)get_bytes(reader, (size_t)n);
+}
+
+static void heap_push(PendingHeap* heap, const Pending* item) {
+	size_t i = 0;
+
+	if(heap->count == heap->capacity) {
+		size_t capacity = heap->capacity > 0 ? heap->capacity * 2 : 1024;
+		Pending* items = realloc(heap->items, capacity * sizeof(Pending));
+		if(items == NULL) {
+			free(item->frame);
+			return;
+		}
+		heap->items = items;
+		heap->capacity = capacity;
+	}
+
+	i = heap->count++;
+	while(i > 0 && heap->items[(i - 1) / 2].due > item->due) {
+		heap->items[i] = heap->items[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap->items[i] = *item;
+}
+
+static Pending heap_pop(PendingHeap* heap) {
+	Pending top = heap->items[0];
+	Pending last = heap->items[--heap->count];
+	size_t i = 0;
+
+	for(;;) {
+		size_t child = 2 * i + 1;
+		if(child >= heap->count) {
+			break;
+		}
+		if(child + 1 < heap->count && heap->items[child + 1].due < heap->items[child].due) {
+			child++;
+		}
+		if(last.due <= heap->items[child].due) {
+			break;
+		}
+		heap->items[i] = heap->items[child];
+		i = child;
+	}
+	if(heap->count > 0) {
+		heap->items[i] = last;
+	}
+
+	return top;
+}
+
+/* Skips blanks and compares the next word of a query, ignoring case. */
+static int starts_with_word(const char* query, size_t length, const char* word, const char** rest) {
+	size_t n = strlen(word);
+	const char* end = query + length;
+
+	while(query < end && (*query == ' ' || *query == '\t' || *query == '\n' || *query == '\r')) {
+		query++;
+	}
+	if((size_t)(end - query) < n || strncasecmp(query, word, n) != 0) {
+		return 0;
+	}
+	if(rest != NULL) {
+		*rest = query + n;
+	}
+	return 1;
+}
+
+static int is_write_query(const char* query, size_t length) {
+	return starts_with_word(query, length, "INSERT", NULL) ||
+		starts_with_word(query, length, "UPDATE", NULL) ||
+		starts_with_word(query, length, "DELETE", NULL);
+}
+
+/* Counts '?' markers outside quoted strings. */
+static int count_bind_markers(const char* query, size_t length) {
+	int count = 0;
+	int quoted = 0;
+	size_t i;
+
+	for(i = 0; i < length; ++i) {
+		if(query[i] == '\'') {
+			quoted = !quoted;
+		} else if(query[i] == '?' && !quoted) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/* Queues frame for delivery to connection at due. */
+static void respond(Server* server, int connection, int version, int stream,
+					int opcode, const Buffer* body, long long due) {
+	Pending item;
+	unsigned char* frame = malloc(FRAME_HEADER_LENGTH + body->length);
+
+	if(frame == NULL) {
+		return;
+	}
+	frame[0] = (unsigned char)(0x80 | version);
+	frame[1] = 0;
+	frame[2] = (unsigned char)stream;
+	frame[3] = (unsigned char)opcode;
+	frame[4] = (unsigned char)(body->length >> 24);
+	frame[5] = (unsigned char)(body->length >> 16);
+	frame[6] = (unsigned char)(body->length >> 8);
+	frame[7] = (unsigned char)body->length;
+	if(body->length > 0) {
+		memcpy(frame + FRAME_HEADER_LENGTH, body->data, body->length);
+	}
+
+	item.due = due;
+	item.connection = connection;
+	item.generation = server->connections[connection].generation;
+	item.frame = frame;
+	item.length = FRAME_HEADER_LENGTH + body->length;
+	heap_push(&server->pending, &item);
+}
+
+static void error_body(Buffer* body, unsigned code, const char* message) {
+	put_int(body, code);
+	put_string(body, message, strlen(message));
+}
+
+/*
+  Decides the due time and outcome of a write of rows rows. Returns 0 to
+  acknowledge it, otherwise the error already written to body.
+*/
+static unsigned write_outcome(Server* server, long rows, const char* write_type, Buffer* body, long long* due) {
+	long long now = now_ns();
+	double r = next_random(server);
+
+	server->stats.writes++;
+	server->stats.rows += rows;
+
+	*due = now + (long long)((server->latency_us + server->jitter_us * next_random(server)) * 1000.0);
+	if(server->max_rows_per_sec > 0.0) {
+		if(server->throttle_clock < now) {
+			server->throttle_clock = now;
+		}
+		server->throttle_clock += (long long)(rows * 1e9 / server->max_rows_per_sec);
+		if(*due < server->throttle_clock) {
+			*due = server->throttle_clock;
+		}
+	}
+
+	if(r < server->write_timeout_rate) {
+		server->stats.write_timeouts++;
+		error_body(body, ERROR_WRITE_TIMEOUT, "Operation timed out - received only 0 responses.");
+		put_short(body, CONSISTENCY_ONE);
+		put_int(body, 0);
+		put_int(body, 1);
+		put_string(body, write_type, strlen(write_type));
+		return ERROR_WRITE_TIMEOUT;
+	}
+	if(r < server->write_timeout_rate + server->overloaded_rate) {
+		server->stats.overloaded++;
+		error_body(body, ERROR_OVERLOADED, "Server is overloaded");
+		return ERROR_OVERLOADED;
+	}
+
+	put_int(body, RESULT_VOID);
+	return 0;
+}
+
+static void handle_query(Server* server, int c, int version, int stream, Reader* reader) {
+	Connection* connection = &server->connections[c];
+	Buffer body = { NULL, 0, 0 };
+	long long due = now_ns();
+	const char* rest = NULL;
+	size_t length = 0;
+	const char* query = get_long_string(reader, &length);
+	int opcode = OPCODE_RESULT;
+
+	if(reader->failed) {
+		error_body(&body, ERROR_PROTOCOL, "Malformed QUERY");
+		opcode = OPCODE_ERROR;
+	} else if(is_write_query(query, length)) {
+		if(write_outcome(server, 1, "SIMPLE", &body, &due) != 0) {
+			opcode = OPCODE_ERROR;
+		}
+	} else if(starts_with_word(query, length, "USE", &rest)) {
+		const char* end = query + length;
+		size_t n = 0;
+
+		while(rest < end && (*rest == ' ' || *rest == '"')) {
+			rest++;
+		}
+		while(rest + n < end && rest[n] != ';' && rest[n] != '"' && rest[n] != ' ' &&
+			n + 1 < sizeof(connection->keyspace)) {
+			n++;
+		}
+		memcpy(connection->keyspace, rest, n);
+		connection->keyspace[n] = '\0';
+
+		put_int(&body, RESULT_SET_KEYSPACE);
+		put_string(&body, connection->keyspace, n);
+	} else if(starts_with_word(query, length, "SELECT", NULL)) {
+		put_int(&body, RESULT_ROWS);
+		put_int(&body, 0);	/* flags */
+		put_int(&body, 0);	/* columns */
+		put_int(&body, 0);	/* rows */
+	} else {
+		/* DDL and anything else succeeds without a schema change event. */
+		put_int(&body, RESULT_VOID);
+	}
+
+	respond(server, c, version, stream, opcode, &body, due);
+	buffer_free(&body);
+}
+
+/*
+  Returns the id of query prepared in keyspace, adding it if it is new, or
+  -1 if the table is full or out of memory.
+*/
+static int find_prepared(Server* server, const char* keyspace, const char* query, size_t length) {
+	size_t keyspace_length = strlen(keyspace);
+	size_t key_length = keyspace_length + 1 + length;
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	char* key = malloc(key_length);
+	size_t i;
+	int slot = 0;
+
+	if(key == NULL) {
+		return -1;
+	}
+	memcpy(key, keyspace, keyspace_length + 1);
+	memcpy(key + keyspace_length + 1, query, length);
+	for(i = 0; i < key_length; ++i) {
+		hash = (hash ^ (unsigned char)key[i]) * 0x100000001b3ULL;
+	}
+
+	for(slot = (int)(hash % MAX_PREPARED); server->prepared[slot].key != NULL; slot = (slot + 1) % MAX_PREPARED) {
+		Prepared* prepared = &server->prepared[slot];
+
+		if(prepared->hash == hash && prepared->key_length == key_length &&
+			memcmp(prepared->key, key, key_length) == 0) {
+			free(key);
+			return slot;
+		}
+	}
+	if(server->num_prepared == MAX_PREPARED - 1) {
+		/* One slot is kept free so that a probe always ends. */
+		free(key);
+		return -1;
+	}
+
+	server->prepared[slot].hash = hash;
+	server->prepared[slot].key = key;
+	server->prepared[slot].key_length = key_length;
+	server->prepared[slot].write = is_write_query(query, length);
+	server->num_prepared++;
+	return slot;
+}
+
+static void handle_prepare(Server* server, int c, int version, int stream, Reader* reader) {
+	Connection* connection = &server->connections[c];
+	Buffer body = { NULL, 0, 0 };
+	size_t length = 0;
+	const char* query = get_long_string(reader, &length);
+	const char* keyspace = connection->keyspace[0] != '\0' ? connection->keyspace : "mock";
+	int markers = 0;
+	int id = -1;
+	int i;
+
+	if(!reader->failed) {
+		id = find_prepared(server, keyspace, query, length);
+	}
+	if(id < 0) {
+		error_body(&body, reader->failed ? ERROR_PROTOCOL : ERROR_INVALID,
+			reader->failed ? "Malformed PREPARE" : "Too many prepared statements");
+		respond(server, c, version, stream, OPCODE_ERROR, &body, now_ns());
+		buffer_free(&body);
+		return;
+	}
+
+	markers = count_bind_markers(query, length);
+
+	put_int(&body, RESULT_PREPARED);
+	put_short(&body, 4);
+	put_int(&body, (unsigned)id);
+
+	/* Bind marker metadata; the names only have to be unique. */
+	put_int(&body, markers > 0 ? 0x0001 : 0);	/* global table spec */
+	put_int(&body, (unsigned)markers);
+	if(markers > 0) {
+		put_string(&body, keyspace, strlen(keyspace));
+		put_string(&body, "mock", 4);
+	}
+	for(i = 0; i < markers; ++i) {
+		char name[16];
+		int n = snprintf(name, sizeof(name), "p%d", i);
+		put_string(&body, name, (size_t)n);
+		put_short(&body, TYPE_BLOB);
+	}
+
+	if(version >= 2) {
+		/* Result metadata: no_metadata, since nothing is ever returned. */
+		put_int(&body, 0x0004);
+		put_int(&body, 0);
+	}
+
+	respond(server, c, version, stream, OPCODE_RESULT, &body, now_ns());
+	buffer_free(&body);
+}
+
+static void handle_execute(Server* server, int c, int version, int stream, Reader* reader) {
+	Buffer body = { NULL, 0, 0 };
+	long long due = now_ns();
+	unsigned id_length = get_short(reader);
+	const unsigned char* id = get_bytes(reader, id_length);
+	long index = -1;
+	int opcode = OPCODE_RESULT;
+
+	if(!reader->failed && id_length == 4) {
+		index = (long)id[0] << 24 | (long)id[1] << 16 | (long)id[2] << 8 | id[3];
+	}
+
+	if(index < 0 || index >= MAX_PREPARED || server->prepared[index].key == NULL) {
+		error_body(&body, ERROR_INVALID, "Unknown prepared statement");
+		opcode = OPCODE_ERROR;
+	} else if(server->prepared[index].write) {
+		if(write_outcome(server, 1, "SIMPLE", &body, &due) != 0) {
+			opcode = OPCODE_ERROR;
+		}
+	} else {
+		put_int(&body, RESULT_VOID);
+	}
+
+	respond(server, c, version, stream, opcode, &body, due);
+	buffer_free(&body);
+}
+
+static void handle_batch(Server* server, int c, int version, int stream, Reader* reader) {
+	Buffer body = { NULL, 0, 0 };
+	long long due = now_ns();
+	unsigned type = get_byte(reader);
+	long statements = (long)get_short(reader);
+	int opcode = OPCODE_RESULT;
+
+	if(reader->failed) {
+		error_body(&body, ERROR_PROTOCOL, "Malformed BATCH");
+		opcode = OPCODE_ERROR;
+	} else if(write_outcome(server, statements, type == 1 ? "UNLOGGED_BATCH" : "BATCH", &body, &due) != 0) {
+		opcode = OPCODE_ERROR;
+	}
+
+	respond(server, c, version, stream, opcode, &body, due);
+	buffer_free(&body);
+}
+
+static void handle_frame(Server* server, int c, const unsigned char* frame, size_t length) {
+	Buffer body = { NULL, 0, 0 };
+	Reader reader;
+	int version = frame[0] & 0x7F;
+	int stream = (signed char)frame[2];
+	int opcode = frame[3];
+
+	reader.p = frame + FRAME_HEADER_LENGTH;
+	reader.end = frame + length;
+	reader.failed = 0;
+
+	server->stats.requests++;
+
+	if(version < 1 || version > 2) {
+		/* Answer in version 2 so a newer driver can downgrade. */
+		error_body(&body, ERROR_PROTOCOL, "Invalid or unsupported protocol version; supported versions are 1 and 2");
+		respond(server, c, 2, stream, OPCODE_ERROR, &body, now_ns());
+		buffer_free(&body);
+		return;
+	}
+
+	switch(opcode) {
+		case OPCODE_STARTUP:
+		case OPCODE_REGISTER:
+			respond(server, c, version, stream, OPCODE_READY, &body, now_ns());
+			break;
+		case OPCODE_OPTIONS:
+			put_short(&body, 2);
+			put_string(&body, "CQL_VERSION", 11);
+			put_short(&body, 1);
+			put_string(&body, "3.0.0", 5);
+			put_string(&body, "COMPRESSION", 11);
+			put_short(&body, 0);
+			respond(server, c, version, stream, OPCODE_SUPPORTED, &body, now_ns());
+			break;
+		case OPCODE_QUERY:
+			handle_query(server, c, version, stream, &reader);
+			break;
+		case OPCODE_PREPARE:
+			handle_prepare(server, c, version, stream, &reader);
+			break;
+		case OPCODE_EXECUTE:
+			handle_execute(server, c, version, stream, &reader);
+			break;
+		case OPCODE_BATCH:
+			handle_batch(server, c, version, stream, &reader);
+			break;
+		default:
+			error_body(&body, ERROR_PROTOCOL, "Unsupported opcode");
+			respond(server, c, version, stream, OPCODE_ERROR, &body, now_ns());
+			break;
+	}
+	buffer_free(&body);
+}
+
+static void close_connection(Server* server, int c) {
+	Connection* connection = &server->connections[c];
+
+	close(connection->fd);
+	connection->fd = -1;
+	connection->generation++;
+	connection->keyspace[0] = '\0';
+	buffer_free(&connection->in);
+	buffer_free(&connection->out);
+}
+
+/* Reads what is available and handles every complete frame. Returns -1 to close. */
+static int read_connection(Server* server, int c) {
+	Connection* connection = &server->connections[c];
+	size_t offset = 0;
+
+	for(;;) {
+		ssize_t n = 0;
+
+		if(buffer_reserve(&connection->in, READ_CHUNK) != 0) {
+			return -1;
+		}
+		n = read(connection->fd, connection->in.data + connection->in.length, READ_CHUNK);
+		if(n == 0) {
+			return -1;
+		}
+		if(n < 0) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			if(errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		connection->in.length += (size_t)n;
+		if(n < READ_CHUNK) {
+			break;
+		}
+	}
+
+	while(connection->in.length - offset >= FRAME_HEADER_LENGTH) {
+		const unsigned char* header = connection->in.data + offset;
+		size_t length = (size_t)header[4] << 24 | (size_t)header[5] << 16 |
+			(size_t)header[6] << 8 | header[7];
+
+		if(length > MAX_FRAME_LENGTH) {
+			fprintf(stderr, "Error: frame of %lu bytes, closing connection\n", (unsigned long)length);
+			return -1;
+		}
+		if(connection->in.length - offset < FRAME_HEADER_LENGTH + length) {
+			break;
+		}
+		handle_frame(server, c, header, FRAME_HEADER_LENGTH + length);
+		offset += FRAME_HEADER_LENGTH + length;
+	}
+	buffer_consume(&connection->in, offset);
+
+	return 0;
+}
+
+static int write_connection(Connection* connection) {
+	while(connection->out.length > 0) {
+		ssize_t n = write(connection->fd, connection->out.data, connection->out.length);
+		if(n < 0) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			if(errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buffer_consume(&connection->out, (size_t)n);
+	}
+	return 0;
+}
+
+static void accept_connections(Server* server) {
+	for(;;) {
+		int fd = accept(server->listener, NULL, NULL);
+		int one = 1;
+		int c;
+
+		if(fd < 0) {
+			return;
+		}
+		for(c = 0; c < MAX_CONNECTIONS && server->connections[c].fd >= 0; ++c) {
+		}
+		if(c == MAX_CONNECTIONS) {
+			fprintf(stderr, "Error: more than %d connections\n", MAX_CONNECTIONS);
+			close(fd);
+			continue;
+		}
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		server->connections[c].fd = fd;
+	}
+}
+
+/* Moves due responses to their connections' output buffers. */
+static void deliver_due(Server* server, long long now) {
+	while(server->pending.count > 0 && server->pending.items[0].due <= now) {
+		Pending item = heap_pop(&server->pending);
+		Connection* connection = &server->connections[item.connection];
+
+		if(connection->fd >= 0 && connection->generation == item.generation) {
+			buffer_append(&connection->out, item.frame, item.length);
+		}
+		free(item.frame);
+	}
+}
+
+static void print_stats(Server* server, double seconds, const char* label) {
+	ServerStats* now = &server->stats;
+	ServerStats* last = &server->reported;
+	int connections = 0;
+	int c;
+
+	for(c = 0; c < MAX_CONNECTIONS; ++c) {
+		connections += server->connections[c].fd >= 0;
+	}
+
+	fprintf(stderr, "%s requests %.0f/s writes %.0f/s rows %.0f/s write_timeouts %ld overloaded %ld"
+		" connections %d queued %lu\n", label,
+		(now->requests - last->requests) / seconds, (now->writes - last->writes) / seconds,
+		(now->rows - last->rows) / seconds, now->write_timeouts - last->write_timeouts,
+		now->overloaded - last->overloaded, connections, (unsigned long)server->pending.count);
+	*last = *now;
+}
+
+static int open_listener(const char* address, int port) {
+	struct sockaddr_in addr;
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(fd < 0) {
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	if(inet_pton(AF_INET, address, &addr.sin_addr) != 1 ||
+		bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0) {
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	return fd;
+}
+
+int main(int argc, char* argv[]) {
+	static Server server;
+	struct pollfd fds[MAX_CONNECTIONS + 1];
+	int map[MAX_CONNECTIONS + 1];
+	const char* address = "127.0.0.1";
+	int port = 9042;
+	int seed = 1;
+	double stats_interval = 1.0;
+	long long start = 0, next_stats = 0;
+	int c;
+
+	LoadOption options[] = {
+		{ "--address", LOAD_OPTION_STRING, &address, "address to listen on" },
+		{ "--port", LOAD_OPTION_INT, &port, "port to listen on" },
+		{ "--latency-us", LOAD_OPTION_DOUBLE, &server.latency_us, "delay before every write is answered" },
+		{ "--jitter-us", LOAD_OPTION_DOUBLE, &server.jitter_us, "extra uniformly random write delay" },
+		{ "--write-timeout-rate", LOAD_OPTION_DOUBLE, &server.write_timeout_rate, "fraction of writes failed with WRITE_TIMEOUT" },
+		{ "--overloaded-rate", LOAD_OPTION_DOUBLE, &server.overloaded_rate, "fraction of writes failed with OVERLOADED" },
+		{ "--max-rows-per-sec", LOAD_OPTION_DOUBLE, &server.max_rows_per_sec, "acknowledge at most N written rows per second" },
+		{ "--seed", LOAD_OPTION_INT, &seed, "seed for error injection and jitter" },
+		{ "--stats-interval", LOAD_OPTION_DOUBLE, &stats_interval, "seconds between stats lines, 0 for none" }
+	};
+
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+
+	for(c = 0; c < MAX_CONNECTIONS; ++c) {
+		server.connections[c].fd = -1;
+	}
+	server.random = (unsigned long long)seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	server.listener = open_listener(address, port);
+	if(server.listener < 0) {
+		fprintf(stderr, "Error: unable to listen on %s:%d: %s\n", address, port, strerror(errno));
+		return -1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "Listening on %s:%d\n", address, port);
+
+	start = now_ns();
+	next_stats = start + (long long)(stats_interval * 1e9);
+
+	while(!stopping) {
+		long long now = now_ns();
+		int timeout = 1000;
+		int num_fds = 1;
+
+		fds[0].fd = server.listener;
+		fds[0].events = POLLIN;
+		for(c = 0; c < MAX_CONNECTIONS; ++c) {
+			if(server.connections[c].fd >= 0) {
+				fds[num_fds].fd = server.connections[c].fd;
+				fds[num_fds].events = POLLIN | (server.connections[c].out.length > 0 ? POLLOUT : 0);
+				map[num_fds++] = c;
+			}
+		}
+
+		if(server.pending.count > 0) {
+			long long wait = server.pending.items[0].due - now;
+			timeout = wait <= 0 ? 0 : (int)(wait / 1000000);
+		}
+		if(stats_interval > 0.0 && (next_stats - now) / 1000000 < timeout) {
+			timeout = next_stats <= now ? 0 : (int)((next_stats - now) / 1000000);
+		}
+
+		if(poll(fds, (nfds_t)num_fds, timeout) < 0 && errno != EINTR) {
+			fprintf(stderr, "Error: poll: %s\n", strerror(errno));
+			break;
+		}
+
+		if(fds[0].revents & POLLIN) {
+			accept_connections(&server);
+		}
+		for(c = 1; c < num_fds; ++c) {
+			if((fds[c].revents & (POLLIN | POLLHUP | POLLERR)) &&
+				read_connection(&server, map[c]) != 0) {
+				close_connection(&server, map[c]);
+			}
+		}
+
+		now = now_ns();
+		deliver_due(&server, now);
+
+		for(c = 0; c < MAX_CONNECTIONS; ++c) {
+			if(server.connections[c].fd >= 0 && server.connections[c].out.length > 0 &&
+				write_connection(&server.connections[c]) != 0) {
+				close_connection(&server, c);
+			}
+		}
+
+		if(stats_interval > 0.0 && now >= next_stats) {
+			print_stats(&server, (now - next_stats) / 1e9 + stats_interval, "stats");
+			next_stats = now + (long long)(stats_interval * 1e9);
+		}
+	}
+
+	memset(&server.reported, 0, sizeof(server.reported));
+	print_stats(&server, (now_ns() - start) / 1e9, "total");
+
+	for(c = 0; c < MAX_CONNECTIONS; ++c) {
+		if(server.connections[c].fd >= 0) {
+			close_connection(&server, c);
+		}
+	}
+	while(server.pending.count > 0) {
+		Pending item = heap_pop(&server.pending);
+		free(item.frame);
+	}
+	free(server.pending.items);
+	for(c = 0; c < MAX_PREPARED; ++c) {
+		free(server.prepared[c].key);
+	}
+	close(server.listener);
+
+	return 0;
+}
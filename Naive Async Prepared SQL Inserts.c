@@ -14,40 +14,46 @@
   limitations under the License.
 */
 
+/*
+  Loads flights with prepared INSERTs sent asynchronously, a window of
+  them in flight on every thread. Besides the sources of the other
+  loaders (see flight_reader.h) it needs the throttle, the retries and the
+  --targets tables:
+
+    cc "Naive Async Prepared SQL Inserts.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c \
+       csv_scan.c flight_direct.c flight_decompress.c flight_schema.c flight_binder.c load_parts.c load_rollup.c \
+       load_options.c load_cluster.c load_stats.c latency_histogram.c load_checkpoint.c load_throttle.c \
+       load_retry.c load_targets.c -lcassandra -lz -lzstd -lpthread
+*/
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "cassandra.h"
 
+#include "flight_binder.h"
+#include "flight_pipeline.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_checkpoint.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_parts.h"
+#include "load_retry.h"
+#include "load_rollup.h"
+#include "load_stats.h"
+#include "load_targets.h"
+#include "load_throttle.h"
+
 #define NUM_CONCURRENT_REQUESTS 250
 
-struct Flight_ { 
-	int		id;
-	int		year;
-	int		day_of_month;
-	char	fl_date[11];
-	int 	airline_id;
-	char 	carrier[3];
-	int 	fl_num;
-	int 	origin_airport_id;
-	char 	origin[4];
-	char	origin_city_name[20];
-	char	origin_state_abr[4];
-	char	dest[4];
-	char	dest_city_name[20];
-	char	dest_state_abr[4];
-	int		dep_time;
-	int		arr_time;
-	int		actual_elapsed_time;
-	int		air_time;
-	int		distance;
-} ;        
-
-typedef struct Flight_ Flight;
+/* Scanning the window for the checkpoint every row is wasteful; it is done this often. */
+#define CHECKPOINT_ROWS 1024
 
 void print_error(CassFuture* future) {
   CassString message = cass_future_error_message(future);
@@ -55,12 +61,6 @@ void print_error(CassFuture* future) {
 }
 
 
-CassCluster* create_cluster() {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, "127.0.0.1");
-  return cluster;
-}
-
 CassError connect_session(CassCluster* cluster, CassSession** output) {
   CassError rc = CASS_OK;
   CassFuture* future = cass_cluster_connect(cluster);
@@ -84,6 +84,8 @@ CassError execute_stmt(CassSession* session, const char* query) {
   CassFuture* future = NULL;
   CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
 
+  load_cluster_apply(statement);
+
   future = cass_session_execute(session, statement);
   cass_future_wait(future);
 
@@ -118,69 +120,467 @@ CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared
 	return rc;
 }
 
-void execute_prepared_stmt_async(CassSession* session, const CassPrepared * prepared, Flight* flight, int num_rows) {
-	CassError rc = CASS_OK;
-  	CassStatement* statement = NULL;
-  	
-	CassFuture* futures[NUM_CONCURRENT_REQUESTS];
-	
+/*
+  A slot holds one row from the time it is parsed until its insert has been
+  acknowledged. Completion callbacks return slots to the free list, so main
+  can refill them immediately instead of waiting for the whole window.
+  Each slot owns a bound statement that is rebound for every row it
+  carries, so the window allocates statements once rather than per row.
+
+  A slot whose insert failed with a transient error is parked on the retry
+  list, still bound, until its backoff has passed; main sends it again in
+  place of a new row. Parked slots stay out of the free list, so retries
+  are bounded by the window and slow down reading when they pile up.
+
+  Rows complete out of order, so a slot remembers the file offset its row
+  started at; the part's checkpoint is the start of the oldest row still
+  held by a slot.
+
+  With --targets a row takes one slot per table it is inserted into, so
+  all the tables share the window and the throttle. A slot's statement
+  comes from the binder of its table; when main moves a free slot to
+  another table, the statement is swapped for one of that table's.
+*/
+struct AsyncSlot_ {
+	struct AsyncWindow_* window;
+	struct AsyncSlot_* next_free;
+	CassStatement* statement;
+	int target;			/* 0 for flights, else 1 + its index in LoadTargets */
+	long long submitted;
+	int attempts;
+	long long due;
+	int busy;
+	size_t begin;
+	FlightRow row;
+} ;
+
+typedef struct AsyncSlot_ AsyncSlot;
+
+struct AsyncWindow_ {
+	pthread_mutex_t lock;
+	pthread_cond_t slot_freed;
+	AsyncSlot* free_list;
+	AsyncSlot* retry_list;
+	int in_flight;
+	LoadThrottle* throttle;
+	LoadRetry* retry;
+	LoadTargets* targets;
+	AsyncSlot slots[NUM_CONCURRENT_REQUESTS];
+} ;
+
+typedef struct AsyncWindow_ AsyncWindow;
+
+void window_init(AsyncWindow* window, FlightBinder* binder, LoadThrottle* throttle, LoadRetry* retry,
+					LoadTargets* targets) {
 	int i;
-	for(i = 0; i < num_rows; ++i) {
-
-		statement = cass_prepared_bind(prepared);
-
-		cass_statement_bind_int32(statement, 0, flight[i].id);
-		cass_statement_bind_int32(statement, 1, flight[i].year);
-		cass_statement_bind_int32(statement, 2, flight[i].day_of_month);
-		cass_statement_bind_string(statement, 3, cass_string_init(flight[i].fl_date));
-		cass_statement_bind_int32(statement, 4, flight[i].airline_id);
-		cass_statement_bind_string(statement, 5, cass_string_init(flight[i].carrier));
-		cass_statement_bind_int32(statement, 6, flight[i].fl_num);
-		cass_statement_bind_int32(statement, 7, flight[i].origin_airport_id);
-		cass_statement_bind_string(statement, 8, cass_string_init(flight[i].origin));
-		cass_statement_bind_string(statement, 9, cass_string_init(flight[i].origin_city_name));
-		cass_statement_bind_string(statement, 10, cass_string_init(flight[i].origin_state_abr));
-		cass_statement_bind_string(statement, 11, cass_string_init(flight[i].dest));
-		cass_statement_bind_string(statement, 12, cass_string_init(flight[i].dest_city_name));
-		cass_statement_bind_string(statement, 13, cass_string_init(flight[i].dest_state_abr));
-		cass_statement_bind_int32(statement, 14, flight[i].dep_time);
-		cass_statement_bind_int32(statement, 15, flight[i].arr_time);
-		cass_statement_bind_int32(statement, 16, flight[i].actual_elapsed_time);
-		cass_statement_bind_int32(statement, 17, flight[i].air_time);
-		cass_statement_bind_int32(statement, 18, flight[i].distance);
-		cass_statement_bind_int32(statement, 19, (flight[i].air_time/10));
-		
-		futures[i] = cass_session_execute(session, statement);
-
-    	cass_statement_free(statement);
+
+	pthread_mutex_init(&window->lock, NULL);
+	pthread_cond_init(&window->slot_freed, NULL);
+	window->free_list = NULL;
+	window->retry_list = NULL;
+	window->in_flight = 0;
+	window->throttle = throttle;
+	window->retry = retry;
+	window->targets = targets;
+
+	for(i = NUM_CONCURRENT_REQUESTS - 1; i >= 0; --i) {
+		window->slots[i].window = window;
+		window->slots[i].statement = flight_binder_acquire(binder);
+		window->slots[i].target = 0;
+		window->slots[i].busy = 0;
+		window->slots[i].next_free = window->free_list;
+		window->free_list = &window->slots[i];
 	}
+}
 
-  	
-  	for(i = 0; i < num_rows; ++i) {
-    	CassFuture* future = futures[i];
+/* binders are those of flights and the targets, in slot target order. */
+void window_destroy(AsyncWindow* window, FlightBinder* binders) {
+	int i;
 
-    	cass_future_wait(future);
+	for(i = 0; i < NUM_CONCURRENT_REQUESTS; ++i) {
+		flight_binder_release(&binders[window->slots[i].target], window->slots[i].statement);
+	}
+	pthread_cond_destroy(&window->slot_freed);
+	pthread_mutex_destroy(&window->lock);
+}
 
-    	rc = cass_future_error_code(future);
-    	if(rc != CASS_OK) {
-      		print_error(future);
-   		 }
+/* Unlinks and returns a parked slot whose backoff has passed, or sets *next_due. */
+AsyncSlot* window_take_due(AsyncWindow* window, long long* next_due) {
+	AsyncSlot** link = &window->retry_list;
+	long long now = load_stats_now();
+
+	*next_due = 0;
+	for(; *link != NULL; link = &(*link)->next_free) {
+		AsyncSlot* slot = *link;
+		if(slot->due <= now) {
+			*link = slot->next_free;
+			return slot;
+		}
+		if(*next_due == 0 || slot->due < *next_due) {
+			*next_due = slot->due;
+		}
+	}
+	return NULL;
+}
 
-    	cass_future_free(future);
-  }
+/* Waits for slot_freed, or until the monotonic time due when it is not 0. */
+void window_wait(AsyncWindow* window, long long due) {
+	struct timespec deadline;
+	long long wait = 0;
+
+	if(due == 0) {
+		pthread_cond_wait(&window->slot_freed, &window->lock);
+		return;
+	}
+
+	wait = due - load_stats_now();
+	if(wait <= 0) {
+		return;
+	}
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	wait += deadline.tv_nsec;
+	deadline.tv_sec += (time_t)(wait / 1000000000LL);
+	deadline.tv_nsec = (long)(wait % 1000000000LL);
+	pthread_cond_timedwait(&window->slot_freed, &window->lock, &deadline);
+}
+
+/*
+  Returns a parked slot that is due for its retry, otherwise a free slot.
+  Blocks until one of them is available.
+*/
+AsyncSlot* window_acquire(AsyncWindow* window) {
+	AsyncSlot* slot = NULL;
+	long long next_due = 0;
+
+	pthread_mutex_lock(&window->lock);
+	for(;;) {
+		slot = window_take_due(window, &next_due);
+		if(slot != NULL) {
+			break;
+		}
+		if(window->free_list != NULL) {
+			slot = window->free_list;
+			window->free_list = slot->next_free;
+			slot->attempts = 0;
+			slot->busy = 1;
+			window->in_flight++;
+			break;
+		}
+		window_wait(window, next_due);
+	}
+	pthread_mutex_unlock(&window->lock);
+
+	return slot;
 }
 
-int main() {
+void window_release(AsyncWindow* window, AsyncSlot* slot) {
+	pthread_mutex_lock(&window->lock);
+	slot->next_free = window->free_list;
+	window->free_list = slot;
+	slot->busy = 0;
+	window->in_flight--;
+	pthread_cond_signal(&window->slot_freed);
+	pthread_mutex_unlock(&window->lock);
+}
+
+void window_park(AsyncWindow* window, AsyncSlot* slot) {
+	pthread_mutex_lock(&window->lock);
+	slot->next_free = window->retry_list;
+	window->retry_list = slot;
+	pthread_cond_signal(&window->slot_freed);
+	pthread_mutex_unlock(&window->lock);
+}
+
+/*
+  Offset below which every row read through this window is done: the
+  start of the oldest row still in flight or parked, or read if none is.
+*/
+size_t window_done_offset(AsyncWindow* window, size_t read) {
+	size_t done = read;
+	int i;
+
+	pthread_mutex_lock(&window->lock);
+	for(i = 0; i < NUM_CONCURRENT_REQUESTS; ++i) {
+		if(window->slots[i].busy && window->slots[i].begin < done) {
+			done = window->slots[i].begin;
+		}
+	}
+	pthread_mutex_unlock(&window->lock);
+
+	return done;
+}
+
+/*
+  Waits for every outstanding insert, e.g. before closing the session.
+  Returns parked slots as they fall due so they can be sent again, and
+  NULL once nothing is in flight or parked.
+*/
+AsyncSlot* window_drain(AsyncWindow* window) {
+	AsyncSlot* slot = NULL;
+	long long next_due = 0;
+
+	pthread_mutex_lock(&window->lock);
+	while(window->in_flight > 0) {
+		slot = window_take_due(window, &next_due);
+		if(slot != NULL) {
+			break;
+		}
+		window_wait(window, next_due);
+	}
+	pthread_mutex_unlock(&window->lock);
+
+	return slot;
+}
+
+/* Runs on a driver I/O thread. */
+void on_insert_complete(CassFuture* future, void* data) {
+	AsyncSlot* slot = (AsyncSlot*)data;
+	AsyncWindow* window = slot->window;
+	CassError rc = cass_future_error_code(future);
+
+	load_stats_request(slot->submitted, rc);
+	load_throttle_end(window->throttle, rc);
+
+	if(rc != CASS_OK) {
+		if(load_retry_should_retry(window->retry, rc, slot->attempts)) {
+			slot->due = load_retry_due(window->retry, slot->attempts);
+			window_park(window, slot);
+			return;
+		}
+		print_error(future);
+		load_retry_reject(window->retry, &slot->row.flight, cass_error_desc(rc));
+		if(slot->target > 0) {
+			__sync_fetch_and_add(&window->targets->targets[slot->target - 1].rejected, 1);
+		}
+	} else if(slot->target > 0) {
+		__sync_fetch_and_add(&window->targets->targets[slot->target - 1].inserted, 1);
+	}
+
+	window_release(window, slot);
+}
+
+/* Sends the row the slot's statement is bound to; also used for retries. */
+void submit_slot(CassSession* session, AsyncSlot* slot) {
+	CassFuture* future = NULL;
+	long long t = load_stats_now();
+
+	load_throttle_rate(slot->window->throttle, 1, flight_payload_bytes(&slot->row.flight));
+	load_throttle_begin(slot->window->throttle);
+	slot->submitted = load_stats_stage(LOAD_STAGE_AWAIT, t);
+	slot->attempts++;
+
+	future = cass_session_execute(session, slot->statement);
+	load_stats_stage(LOAD_STAGE_SUBMIT, slot->submitted);
+
+	/* The driver keeps its own reference until the callback has run. */
+	cass_future_set_callback(future, on_insert_complete, slot);
+
+	cass_future_free(future);
+}
+
+void execute_prepared_stmt_async(CassSession* session, FlightBinder* binder, AsyncSlot* slot) {
+	long long start = load_stats_now();
+
+	/* The slot is free, so the driver is done with its previous row. */
+	flight_binder_bind(binder, slot->statement, &slot->row.flight);
+	load_stats_stage(LOAD_STAGE_BIND, start);
+
+	submit_slot(session, slot);
+}
+
+/* Takes a slot for a new row, first sending again any parked slots that are due. */
+AsyncSlot* acquire_slot(CassSession* session, AsyncWindow* window) {
+	long long t = load_stats_now();
+	AsyncSlot* slot = window_acquire(window);
+
+	while(slot->attempts > 0) {
+		load_stats_stage(LOAD_STAGE_AWAIT, t);
+		submit_slot(session, slot);
+		t = load_stats_now();
+		slot = window_acquire(window);
+	}
+	load_stats_stage(LOAD_STAGE_AWAIT, t);
+
+	return slot;
+}
+
+/* Moves a free slot to another table, swapping its statement for one from that table's binder. */
+void slot_set_target(AsyncSlot* slot, FlightBinder* binders, int target) {
+	if(slot->target != target) {
+		flight_binder_release(&binders[slot->target], slot->statement);
+		slot->statement = flight_binder_acquire(&binders[target]);
+		slot->target = target;
+	}
+}
+
+struct LoadContext_ {
+	CassSession* session;
+	const CassPrepared* prepared;
+	LoadThrottle* throttle;
+	LoadRetry* retry;
+	LoadTargets* targets;
+} ;
+
+typedef struct LoadContext_ LoadContext;
+
+/*
+  Inserts one part of the file; runs on its own thread with --threads.
+  Each part keeps its own window, so up to threads * NUM_CONCURRENT_REQUESTS
+  inserts are in flight on the shared session. Each row is sent to flights
+  and then to every target, bound once for each.
+*/
+void load_part(LoadPart* part) {
+	LoadContext* context = (LoadContext*)part->context;
+	FlightBinder binders[1 + LOAD_TARGETS_MAX];
+	int num_tables = 1 + context->targets->count;
+	AsyncWindow* window = NULL;
+	AsyncSlot* slot = NULL;
+	Flight flight;
+	long long t = 0;
+	size_t read = flight_reader_offset(part->reader);
+	size_t begin = 0;
+	int table = 0;
+
+	window = malloc(sizeof(AsyncWindow));
+	for(table = 0; window != NULL && table < num_tables; ++table) {
+		const CassPrepared* prepared = table == 0 ? context->prepared : context->targets->targets[table - 1].prepared;
+		if(flight_binder_init(&binders[table], prepared, NUM_CONCURRENT_REQUESTS) != 0) {
+			break;
+		}
+	}
+	if(window == NULL || table < num_tables) {
+		while(--table >= 0) {
+			flight_binder_destroy(&binders[table]);
+		}
+		free(window);
+		part->failed = 1;
+		return;
+	}
+	window_init(window, &binders[0], context->throttle, context->retry, context->targets);
+
+	while(load_stats_next(part->reader, &flight)) {
+		load_rollup_add(&part->rollup, &flight);
+		begin = read;
+		read = flight_reader_offset(part->reader);
+		part->rows++;
+
+		for(table = 0; table < num_tables; ++table) {
+			slot = acquire_slot(context->session, window);
+			slot->begin = begin;
+			if(table == 0 && part->rows % CHECKPOINT_ROWS == 0) {
+				load_checkpoint_update(part->checkpoint, part->part, window_done_offset(window, read));
+			}
+
+			if(flight_row_copy(&slot->row, &flight) != 0) {
+				/* Too long for every table alike, so it is rejected once. */
+				load_retry_reject(context->retry, &flight, "row too long to keep for retries");
+				window_release(window, slot);
+				break;
+			}
+
+			slot_set_target(slot, binders, table);
+			execute_prepared_stmt_async(context->session, &binders[table], slot);
+		}
+
+		/* if (part->rows > 2478) break; */
+	}
+
+	t = load_stats_now();
+	while((slot = window_drain(window)) != NULL) {
+		submit_slot(context->session, slot);
+	}
+	load_stats_stage(LOAD_STAGE_AWAIT, t);
+	load_checkpoint_update(part->checkpoint, part->part, read);
+
+	window_destroy(window, binders);
+	for(table = 0; table < num_tables; ++table) {
+		flight_binder_destroy(&binders[table]);
+	}
+	free(window);
+}
+
+int main(int argc, char* argv[]) {
 	time_t start, stop;
+	char query[1024];
+	int num_threads = 1;
+	int num_parsers = 0;
+	int direct_io = 0;
+	double stats_interval = 10.0;
+	double max_rows_per_sec = 0.0;
+	double max_mb_per_sec = 0.0;
+	int failed = 0;
+	long rows = 0;
+	int resume = 0;
+	int rollup = 0;
+	const char* targets_spec = NULL;
+	LoadTargets targets;
+	const char* checkpoint_path = "flights_checkpoint.txt";
+	double checkpoint_interval = 5.0;
+	const char* input = "/Users/carybourgeois/flights_exercise/flights_from_pg.csv";
+	LoadCheckpoint checkpoint;
+	int max_retries = 5;
+	double retry_delay_ms = 100.0;
+	const char* reject_path = "flights_rejects.csv";
+	LoadContext context;
+	LoadThrottle throttle;
+	LoadRetry retry;
 
-	FILE *fp = fopen("/Users/carybourgeois/flights_exercise/flights_from_pg.csv", "r") ; 
-	
 	CassError rc = CASS_OK;
-	CassCluster* cluster = create_cluster();
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
 	CassSession* session = NULL;
 	CassFuture* close_future = NULL;
 	const CassPrepared* prepared = NULL;
 
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "flights CSV (optionally .gz or .zst, - for stdin), or a file from the binary converter" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "split the input across N threads" },
+		{ "--parser-threads", LOAD_OPTION_INT, &num_parsers, "parse the input ahead of the inserts on N more threads per reader" },
+		{ "--direct-io", LOAD_OPTION_FLAG, &direct_io, "read the input with O_DIRECT and io_uring read-ahead, bypassing the page cache" },
+		{ "--stats-interval", LOAD_OPTION_DOUBLE, &stats_interval, "print a stats line every N seconds, 0 for none" },
+		{ "--max-rows-per-sec", LOAD_OPTION_DOUBLE, &max_rows_per_sec, "insert at most N rows per second, 0 for no limit" },
+		{ "--max-mb-per-sec", LOAD_OPTION_DOUBLE, &max_mb_per_sec, "send at most N MB of row data per second, 0 for no limit" },
+		{ "--max-retries", LOAD_OPTION_INT, &max_retries, "send a row that failed with a transient error up to N more times" },
+		{ "--retry-delay-ms", LOAD_OPTION_DOUBLE, &retry_delay_ms, "backoff before the first retry, doubling per attempt" },
+		{ "--reject-file", LOAD_OPTION_STRING, &reject_path, "append rows that fail for good to this CSV file" },
+		{ "--resume", LOAD_OPTION_FLAG, &resume, "continue from the checkpoint file instead of dropping the table" },
+		{ "--checkpoint-file", LOAD_OPTION_STRING, &checkpoint_path, "where to save load progress (default flights_checkpoint.txt)" },
+		{ "--checkpoint-interval", LOAD_OPTION_DOUBLE, &checkpoint_interval, "save progress every N seconds, 0 for only at start and end" },
+		{ "--rollup", LOAD_OPTION_FLAG, &rollup, "also sum flights by carrier, origin and month into summary tables" },
+		{ "--targets", LOAD_OPTION_STRING, &targets_spec,
+			"also insert every row into these tables, e.g. \"by_dest:dest,fl_date by_flight:airline_id,fl_num\"" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	flight_reader_set_parsers(num_parsers);
+	flight_reader_set_direct(direct_io);
+	if(rollup && resume) {
+		fprintf(stderr, "Error: --rollup needs the whole input, so it cannot be used with --resume\n");
+		return -1;
+	}
+	load_rollup_set_enabled(rollup);
+	if(load_targets_parse(&targets, targets_spec) != 0) {
+		return -1;
+	}
+	if(load_checkpoint_init(&checkpoint, checkpoint_path, input, num_threads, resume) != 0) {
+		return -1;
+	}
+	if(load_throttle_init(&throttle, max_rows_per_sec, max_mb_per_sec * 1e6,
+		(num_threads > 1 ? num_threads : 1) * NUM_CONCURRENT_REQUESTS) != 0) {
+		return -1;
+	}
+	if(load_retry_init(&retry, max_retries, retry_delay_ms, retry_delay_ms * 64, reject_path) != 0) {
+		return -1;
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
 	rc = connect_session(cluster, &session);
 	if(rc != CASS_OK) {
 		return -1;
@@ -193,65 +593,54 @@ int main() {
 	execute_stmt(session,
 					"USE exercise;");
 						
-	execute_stmt(session,
-					"DROP TABLE IF EXISTS flights;");
+	/* A resumed load keeps the rows already written; overlapping inserts just overwrite them. */
+	if(!resume) {
+		execute_stmt(session,
+						"DROP TABLE IF EXISTS flights;");
 					
-	execute_stmt(session,
-					"CREATE TABLE flights ( \
-						id int, year int, day_of_month int, fl_date varchar, \
-						airline_id int, carrier varchar, fl_num int, origin_airport_id int, \
-						origin varchar, origin_city_name varchar, origin_state_abr varchar, dest varchar, \
-						dest_city_name varchar, dest_state_abr varchar, dep_time int, arr_time int, \
-						actual_elapsed_time int, air_time int, distance int, air_time_grp int, \
-						PRIMARY KEY (carrier, origin, air_time_grp, id));");
+		execute_stmt(session,
+						"CREATE TABLE flights (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (" FLIGHT_SCHEMA_KEY "));");
+	}
+	if(rollup && load_rollup_create_tables(session) != 0) {
+		return -1;
+	}
+	if(load_targets_prepare(&targets, session, !resume) != 0) {
+		return -1;
+	}
 
  	time(&start);
  	
- 	if(prepare_stmt(session, "INSERT INTO flights \
- 								(id, year, day_of_month, fl_date, \
- 								airline_id, carrier, fl_num, origin_airport_id, \
- 								origin, origin_city_name, origin_state_abr, dest, \
- 								dest_city_name, dest_state_abr, dep_time, arr_time, \
- 								actual_elapsed_time, air_time, distance, air_time_grp) \
- 								VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);", 
- 								&prepared) != CASS_OK) { 
+ 	if(flight_schema_insert(query, sizeof(query), "flights") != 0 ||
+ 		prepare_stmt(session, query, &prepared) != CASS_OK) { 
  		return -1;
  	}
  	
- 	if ( fp != NULL ) {
- 		int rows = 0;
- 		int async_rows = 0;
- 		
- 		Flight flight[NUM_CONCURRENT_REQUESTS];
- 		  
-   		while(!feof(fp)) {
-                  
-   			fscanf(fp, "%d, %d, %d, %[^,], %d, %[^,], %d, %d, %[^,], %[^,], %[^,], %[^,], %[^,], %[^,], %d, %d, %d, %d, %d \n", 
-      			&flight[async_rows].id, &flight[async_rows].year, &flight[async_rows].day_of_month, flight[async_rows].fl_date, 
-      			&flight[async_rows].airline_id, flight[async_rows].carrier, &flight[async_rows].fl_num, &flight[async_rows].origin_airport_id,
-      			flight[async_rows].origin, flight[async_rows].origin_city_name, flight[async_rows].origin_state_abr, flight[async_rows].dest,
-      			flight[async_rows].dest_city_name, flight[async_rows].dest_state_abr, &flight[async_rows].dep_time, &flight[async_rows].arr_time,
-      			&flight[async_rows].actual_elapsed_time, &flight[async_rows].air_time, &flight[async_rows].distance);
-      		
-      		rows++;
-      		async_rows++;
-      		if ( async_rows == NUM_CONCURRENT_REQUESTS) {
-      			execute_prepared_stmt_async(session, prepared, flight, async_rows);
-      			
-  				async_rows = 0;
-      		}
-           
-        	/* if (rows > 2478) break; */
-                               
-		}  /* EOF */
-		
-		if ( async_rows > 0) {
-			execute_prepared_stmt_async(session, prepared, flight, async_rows);	
-      	}
-      	 
-		printf("%d Records loaded.\n", rows);
-   
-	}  /* File exists */ 
+ 	context.session = session;
+ 	context.prepared = prepared;
+ 	context.throttle = &throttle;
+ 	context.retry = &retry;
+ 	context.targets = &targets;
+ 	
+ 	load_checkpoint_start(&checkpoint, checkpoint_interval);
+ 	load_stats_start(stats_interval);
+ 	rows = load_parts_run(input, num_threads, &checkpoint, &context, load_part, &failed);
+	load_stats_stop();
+	if(rollup && load_rollup_write(session) != 0) {
+		failed = 1;
+	}
+	load_checkpoint_stop(&checkpoint);
+	printf("%ld Records loaded.\n", rows);
+	if(rollup) {
+		load_rollup_report();
+	}
+	load_targets_report(&targets);
+	flight_binder_report(rows);
+	load_stats_report();
+	load_cluster_report(&cluster_settings, stdout);
+	flight_pipeline_report();
+	load_throttle_report(&throttle);
+	load_retry_report(&retry);
+	load_checkpoint_report(&checkpoint);
 	
 	time(&stop);
  
@@ -261,9 +650,11 @@ int main() {
   	cass_future_wait(close_future);
 	cass_future_free(close_future);
 	cass_cluster_free(cluster);
+	load_targets_free(&targets);
+	load_checkpoint_destroy(&checkpoint);
+	load_throttle_destroy(&throttle);
+	load_retry_destroy(&retry);
 	
-	fclose( fp ); 
-	
-	return 0;   
+	return failed || retry.rejected > 0 ? -1 : 0;   
   
 }
@@ -23,29 +23,16 @@
 
 #include "cassandra.h"
 
-struct Flight_ { 
-	int		id;
-	int		year;
-	int		day_of_month;
-	char	fl_date[11];
-	int 	airline_id;
-	char 	carrier[3];
-	int 	fl_num;
-	int 	origin_airport_id;
-	char 	origin[4];
-	char	origin_city_name[20];
-	char	origin_state_abr[4];
-	char	dest[4];
-	char	dest_city_name[20];
-	char	dest_state_abr[4];
-	int		dep_time;
-	int		arr_time;
-	int		actual_elapsed_time;
-	int		air_time;
-	int		distance;
-} ;        
-
-typedef struct Flight_ Flight;
+#include "flight_binder.h"
+#include "flight_pipeline.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_checkpoint.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_parts.h"
+#include "load_rollup.h"
+#include "load_stats.h"
 
 void print_error(CassFuture* future) {
   CassString message = cass_future_error_message(future);
@@ -53,12 +40,6 @@ void print_error(CassFuture* future) {
 }
 
 
-CassCluster* create_cluster() {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, "127.0.0.1");
-  return cluster;
-}
-
 CassError connect_session(CassCluster* cluster, CassSession** output) {
   CassError rc = CASS_OK;
   CassFuture* future = cass_cluster_connect(cluster);
@@ -82,6 +63,8 @@ CassError execute_stmt(CassSession* session, const char* query) {
   CassFuture* future = NULL;
   CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
 
+  load_cluster_apply(statement);
+
   future = cass_session_execute(session, statement);
   cass_future_wait(future);
 
@@ -116,61 +99,128 @@ CassError prepare_stmt(CassSession* session, const char* sql, const CassPrepared
 	return rc;
 }
 
-CassError execute_prepared_stmt(CassSession* session, const CassPrepared * prepared, Flight* flight) {
+/*
+  Runs one row synchronously. The statement is rebound for every row, which
+  is safe because the previous request has completed by the time we return.
+*/
+CassError execute_prepared_stmt(CassSession* session, FlightBinder* binder, CassStatement* statement, Flight* flight) {
 	CassError rc = CASS_OK;
-	CassStatement* statement = NULL;
 	CassFuture* future = NULL;
+	long long start = load_stats_now();
+	long long t = 0;
 
-	statement = cass_prepared_bind(prepared);
-
-	cass_statement_bind_int32(statement, 0, flight->id);
-	cass_statement_bind_int32(statement, 1, flight->year);
-	cass_statement_bind_int32(statement, 2, flight->day_of_month);
-	cass_statement_bind_string(statement, 3, cass_string_init(flight->fl_date));
-	cass_statement_bind_int32(statement, 4, flight->airline_id);
-	cass_statement_bind_string(statement, 5, cass_string_init(flight->carrier));
-	cass_statement_bind_int32(statement, 6, flight->fl_num);
-	cass_statement_bind_int32(statement, 7, flight->origin_airport_id);
-	cass_statement_bind_string(statement, 8, cass_string_init(flight->origin));
-	cass_statement_bind_string(statement, 9, cass_string_init(flight->origin_city_name));
-	cass_statement_bind_string(statement, 10, cass_string_init(flight->origin_state_abr));
-	cass_statement_bind_string(statement, 11, cass_string_init(flight->dest));
-	cass_statement_bind_string(statement, 12, cass_string_init(flight->dest_city_name));
-	cass_statement_bind_string(statement, 13, cass_string_init(flight->dest_state_abr));
-	cass_statement_bind_int32(statement, 14, flight->dep_time);
-	cass_statement_bind_int32(statement, 15, flight->arr_time);
-	cass_statement_bind_int32(statement, 16, flight->actual_elapsed_time);
-	cass_statement_bind_int32(statement, 17, flight->air_time);
-	cass_statement_bind_int32(statement, 18, flight->distance);
-	cass_statement_bind_int32(statement, 19, (flight->air_time/10));
+	flight_binder_bind(binder, statement, flight);
+	start = load_stats_stage(LOAD_STAGE_BIND, start);
   
   	future = cass_session_execute(session, statement);
+  	t = load_stats_stage(LOAD_STAGE_SUBMIT, start);
   	cass_future_wait(future);
+  	load_stats_stage(LOAD_STAGE_AWAIT, t);
 
   	rc = cass_future_error_code(future);
+  	load_stats_request(start, rc);
   	if(rc != CASS_OK) {
     	print_error(future);
   	} 
 
   	cass_future_free(future);
-  	cass_statement_free(statement);
 
   	return rc;
 }
 
-int main() {
-	Flight flight; 
-	/* char sql[1024]; */
+struct LoadContext_ {
+	CassSession* session;
+	const CassPrepared* prepared;
+} ;
+
+typedef struct LoadContext_ LoadContext;
+
+/* Inserts one part of the file; runs on its own thread with --threads. */
+void load_part(LoadPart* part) {
+	LoadContext* context = (LoadContext*)part->context;
+	FlightBinder binder;
+	CassStatement* statement = NULL;
+	Flight flight;
+
+	if(flight_binder_init(&binder, context->prepared, 1) != 0) {
+		part->failed = 1;
+		return;
+	}
+	statement = flight_binder_acquire(&binder);
+
+	while(load_stats_next(part->reader, &flight)) {
+		load_rollup_add(&part->rollup, &flight);
+		part->rows++;
+
+		if ( execute_prepared_stmt(context->session, &binder, statement, &flight) != CASS_OK) {
+			part->failed = 1;
+			break;
+		}
+		load_checkpoint_update(part->checkpoint, part->part, flight_reader_offset(part->reader));
+
+		/* if (part->rows > 999) break; */
+	}
+
+	flight_binder_release(&binder, statement);
+	flight_binder_destroy(&binder);
+}
+
+int main(int argc, char* argv[]) {
 	time_t start, stop;
+	char query[1024];
+	int num_threads = 1;
+	int num_parsers = 0;
+	int direct_io = 0;
+	double stats_interval = 10.0;
+	int failed = 0;
+	long rows = 0;
+	int resume = 0;
+	int rollup = 0;
+	const char* checkpoint_path = "flights_checkpoint.txt";
+	double checkpoint_interval = 5.0;
+	const char* input = "/Users/carybourgeois/flights_exercise/flights_from_pg.csv";
+	LoadCheckpoint checkpoint;
+	LoadContext context;
 
-	FILE *fp = fopen("/Users/carybourgeois/flights_exercise/flights_from_pg.csv", "r") ; 
-	
 	CassError rc = CASS_OK;
-	CassCluster* cluster = create_cluster();
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
 	CassSession* session = NULL;
 	CassFuture* close_future = NULL;
 	const CassPrepared* prepared = NULL;
 
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "flights CSV (optionally .gz or .zst, - for stdin), or a file from the binary converter" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "split the input across N threads" },
+		{ "--parser-threads", LOAD_OPTION_INT, &num_parsers, "parse the input ahead of the inserts on N more threads per reader" },
+		{ "--direct-io", LOAD_OPTION_FLAG, &direct_io, "read the input with O_DIRECT and io_uring read-ahead, bypassing the page cache" },
+		{ "--stats-interval", LOAD_OPTION_DOUBLE, &stats_interval, "print a stats line every N seconds, 0 for none" },
+		{ "--resume", LOAD_OPTION_FLAG, &resume, "continue from the checkpoint file instead of dropping the table" },
+		{ "--checkpoint-file", LOAD_OPTION_STRING, &checkpoint_path, "where to save load progress (default flights_checkpoint.txt)" },
+		{ "--checkpoint-interval", LOAD_OPTION_DOUBLE, &checkpoint_interval, "save progress every N seconds, 0 for only at start and end" },
+		{ "--rollup", LOAD_OPTION_FLAG, &rollup, "also sum flights by carrier, origin and month into summary tables" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	flight_reader_set_parsers(num_parsers);
+	flight_reader_set_direct(direct_io);
+	if(rollup && resume) {
+		fprintf(stderr, "Error: --rollup needs the whole input, so it cannot be used with --resume\n");
+		return -1;
+	}
+	load_rollup_set_enabled(rollup);
+	if(load_checkpoint_init(&checkpoint, checkpoint_path, input, num_threads, resume) != 0) {
+		return -1;
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
 	rc = connect_session(cluster, &session);
 	if(rc != CASS_OK) {
 		return -1;
@@ -183,65 +233,45 @@ int main() {
 	execute_stmt(session,
 					"USE exercise;");
 						
-	execute_stmt(session,
-					"DROP TABLE IF EXISTS flights;");
+	/* A resumed load keeps the rows already written; overlapping inserts just overwrite them. */
+	if(!resume) {
+		execute_stmt(session,
+						"DROP TABLE IF EXISTS flights;");
 					
-	execute_stmt(session,
-					"CREATE TABLE flights ( \
-						id int, year int, day_of_month int, fl_date varchar, \
-						airline_id int, carrier varchar, fl_num int, origin_airport_id int, \
-						origin varchar, origin_city_name varchar, origin_state_abr varchar, dest varchar, \
-						dest_city_name varchar, dest_state_abr varchar, dep_time int, arr_time int, \
-						actual_elapsed_time int, air_time int, distance int, air_time_grp int, \
-						PRIMARY KEY (carrier, origin, air_time_grp, id));");
+		execute_stmt(session,
+						"CREATE TABLE flights (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (" FLIGHT_SCHEMA_KEY "));");
+	}
+	if(rollup && load_rollup_create_tables(session) != 0) {
+		return -1;
+	}
 
  	time(&start);
  	
- 	if(prepare_stmt(session, "INSERT INTO flights \
- 								(id, year, day_of_month, fl_date, \
- 								airline_id, carrier, fl_num, origin_airport_id, \
- 								origin, origin_city_name, origin_state_abr, dest, \
- 								dest_city_name, dest_state_abr, dep_time, arr_time, \
- 								actual_elapsed_time, air_time, distance, air_time_grp) \
- 								VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);", 
- 								&prepared) != CASS_OK) { 
+ 	if(flight_schema_insert(query, sizeof(query), "flights") != 0 ||
+ 		prepare_stmt(session, query, &prepared) != CASS_OK) { 
  		return -1;
  	}
  	
- 	if ( fp != NULL ) {
- 		int i = 0;  
-   		while(!feof(fp)) {           
-        	i++;
-                  
-   			fscanf(fp, "%d, %d, %d, %[^,], %d, %[^,], %d, %d, %[^,], %[^,], %[^,], %[^,], %[^,], %[^,], %d, %d, %d, %d, %d \n", 
-      			&flight.id, &flight.year, &flight.day_of_month, flight.fl_date, 
-      			&flight.airline_id, flight.carrier, &flight.fl_num, &flight.origin_airport_id,
-      			flight.origin, flight.origin_city_name, flight.origin_state_abr, flight.dest,
-      			flight.dest_city_name, flight.dest_state_abr, &flight.dep_time, &flight.arr_time,
-      			&flight.actual_elapsed_time, &flight.air_time, &flight.distance);
-      
-    		/* used for simple SQL Insert commands
-    		sprintf(sql, "INSERT INTO flights (id, year, day_of_month, fl_date, airline_id, carrier, fl_num, origin_airport_id, origin, origin_city_name, origin_state_abr, dest, dest_city_name, dest_state_abr, dep_time, arr_time, actual_elapsed_time, air_time, distance, air_time_grp) VALUES (%d, %d, %d, \'%s\', %d, \'%s\', %d, %d, \'%s\', \'%s\', \'%s\', \'%s\', \'%s\', \'%s\', %d, %d, %d, %d, %d, %d);\n", 
-        		flight.id, flight.year, flight.day_of_month, flight.fl_date, 
-      			flight.airline_id, flight.carrier, flight.fl_num, flight.origin_airport_id,
-      			flight.origin, flight.origin_city_name, flight.origin_state_abr, flight.dest,
-      			flight.dest_city_name, flight.dest_state_abr, flight.dep_time, flight.arr_time,
-      			flight.actual_elapsed_time, flight.air_time, flight.distance, flight.air_time/10 );
-      			
-      		printf("%s", sql);
-      		execute_stmt(session, sql);
-      		*/
-      		
-      		if ( execute_prepared_stmt(session, prepared, &flight) != CASS_OK) {
-      			return -1;
-      		}
-           
-        	/* if (i > 999) break; */
-                               
-		}  /* EOF */ 
-		printf("%d Records loaded.\n", i);
-   
-	}  /* File exists */ 
+ 	context.session = session;
+ 	context.prepared = prepared;
+ 	
+ 	load_checkpoint_start(&checkpoint, checkpoint_interval);
+ 	load_stats_start(stats_interval);
+ 	rows = load_parts_run(input, num_threads, &checkpoint, &context, load_part, &failed);
+	load_stats_stop();
+	if(rollup && load_rollup_write(session) != 0) {
+		failed = 1;
+	}
+	load_checkpoint_stop(&checkpoint);
+	printf("%ld Records loaded.\n", rows);
+	if(rollup) {
+		load_rollup_report();
+	}
+	flight_binder_report(rows);
+	load_stats_report();
+	load_cluster_report(&cluster_settings, stdout);
+	flight_pipeline_report();
+	load_checkpoint_report(&checkpoint);
 	
 	time(&stop);
  
@@ -251,9 +281,8 @@ int main() {
   	cass_future_wait(close_future);
 	cass_future_free(close_future);
 	cass_cluster_free(cluster);
+	load_checkpoint_destroy(&checkpoint);
 	
-	fclose( fp ); 
-	
-	return 0;   
+	return failed ? -1 : 0;   
   
 }
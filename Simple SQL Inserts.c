@@ -23,29 +23,15 @@
 
 #include "cassandra.h"
 
-struct Flight_ { 
-	int		id;
-	int		year;
-	int		day_of_month;
-	char	fl_date[11];
-	int 	airline_id;
-	char 	carrier[3];
-	int 	fl_num;
-	int 	origin_airport_id;
-	char 	origin[4];
-	char	origin_city_name[20];
-	char	origin_state_abr[4];
-	char	dest[4];
-	char	dest_city_name[20];
-	char	dest_state_abr[4];
-	int		dep_time;
-	int		arr_time;
-	int		actual_elapsed_time;
-	int		air_time;
-	int		distance;
-} ;        
-
-struct Flight_ Flight;
+#include "flight_pipeline.h"
+#include "flight_reader.h"
+#include "flight_schema.h"
+#include "load_checkpoint.h"
+#include "load_cluster.h"
+#include "load_options.h"
+#include "load_parts.h"
+#include "load_rollup.h"
+#include "load_stats.h"
 
 void print_error(CassFuture* future) {
   CassString message = cass_future_error_message(future);
@@ -53,12 +39,6 @@ void print_error(CassFuture* future) {
 }
 
 
-CassCluster* create_cluster() {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, "127.0.0.1");
-  return cluster;
-}
-
 CassError connect_session(CassCluster* cluster, CassSession** output) {
   CassError rc = CASS_OK;
   CassFuture* future = cass_cluster_connect(cluster);
@@ -80,12 +60,19 @@ CassError connect_session(CassCluster* cluster, CassSession** output) {
 CassError execute_stmt(CassSession* session, const char* query) {
   CassError rc = CASS_OK;
   CassFuture* future = NULL;
+  long long start = load_stats_now();
+  long long t = 0;
   CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
 
+  load_cluster_apply(statement);
+
   future = cass_session_execute(session, statement);
+  t = load_stats_stage(LOAD_STAGE_SUBMIT, start);
   cass_future_wait(future);
+  load_stats_stage(LOAD_STAGE_AWAIT, t);
 
   rc = cass_future_error_code(future);
+  load_stats_request(start, rc);
   if(rc != CASS_OK) {
     print_error(future);
   }
@@ -96,17 +83,90 @@ CassError execute_stmt(CassSession* session, const char* query) {
   return rc;
 }
 
-int main() { 
+/* Inserts one part of the file; runs on its own thread with --threads. */
+void load_part(LoadPart* part) {
+	CassSession* session = (CassSession*)part->context;
+	Flight flight;
 	char sql[1024];
+	int dropped = 0;
+
+	while(load_stats_next(part->reader, &flight)) {
+		load_rollup_add(&part->rollup, &flight);
+		long long t = load_stats_now();
+		part->rows++;
+
+		if(flight_schema_insert_values(sql, sizeof(sql), "flights", &flight) != 0) {
+			load_stats_stage(LOAD_STAGE_BIND, t);
+			dropped = 1;
+			continue;
+		}
+		load_stats_stage(LOAD_STAGE_BIND, t);
+
+		/* printf("%s", sql); */
+		if(execute_stmt(session, sql) != CASS_OK) {
+			/* The row is dropped, so the checkpoint stays before it for a resume to send it again. */
+			dropped = 1;
+		} else if(!dropped) {
+			load_checkpoint_update(part->checkpoint, part->part, flight_reader_offset(part->reader));
+		}
+
+		/* if (part->rows > 999) break; */
+	}
+}
+
+int main(int argc, char* argv[]) { 
 	time_t start, stop;
+	int num_threads = 1;
+	int num_parsers = 0;
+	int direct_io = 0;
+	double stats_interval = 10.0;
+	int failed = 0;
+	long rows = 0;
+	int resume = 0;
+	int rollup = 0;
+	const char* checkpoint_path = "flights_checkpoint.txt";
+	double checkpoint_interval = 5.0;
+	const char* input = "/Users/carybourgeois/flights_exercise/flights_from_pg.csv";
+	LoadCheckpoint checkpoint;
 
-	FILE *fp = fopen("/Users/carybourgeois/flights_exercise/flights_from_pg.csv", "r") ; 
-	
 	CassError rc = CASS_OK;
-	CassCluster* cluster = create_cluster();
+	LoadCluster cluster_settings;
+	CassCluster* cluster = NULL;
 	CassSession* session = NULL;
 	CassFuture* close_future = NULL;
 
+	LoadOption options[] = {
+		{ "--input", LOAD_OPTION_STRING, &input, "flights CSV (optionally .gz or .zst, - for stdin), or a file from the binary converter" },
+		{ "--threads", LOAD_OPTION_INT, &num_threads, "split the input across N threads" },
+		{ "--parser-threads", LOAD_OPTION_INT, &num_parsers, "parse the input ahead of the inserts on N more threads per reader" },
+		{ "--direct-io", LOAD_OPTION_FLAG, &direct_io, "read the input with O_DIRECT and io_uring read-ahead, bypassing the page cache" },
+		{ "--stats-interval", LOAD_OPTION_DOUBLE, &stats_interval, "print a stats line every N seconds, 0 for none" },
+		{ "--resume", LOAD_OPTION_FLAG, &resume, "continue from the checkpoint file instead of dropping the table" },
+		{ "--checkpoint-file", LOAD_OPTION_STRING, &checkpoint_path, "where to save load progress (default flights_checkpoint.txt)" },
+		{ "--checkpoint-interval", LOAD_OPTION_DOUBLE, &checkpoint_interval, "save progress every N seconds, 0 for only at start and end" },
+		{ "--rollup", LOAD_OPTION_FLAG, &rollup, "also sum flights by carrier, origin and month into summary tables" },
+		LOAD_CLUSTER_OPTIONS(&cluster_settings)
+	};
+
+	load_cluster_init(&cluster_settings);
+	if(load_options_parse(argc, argv, options, sizeof(options) / sizeof(options[0])) != 0) {
+		return -1;
+	}
+	flight_reader_set_parsers(num_parsers);
+	flight_reader_set_direct(direct_io);
+	if(rollup && resume) {
+		fprintf(stderr, "Error: --rollup needs the whole input, so it cannot be used with --resume\n");
+		return -1;
+	}
+	load_rollup_set_enabled(rollup);
+	if(load_checkpoint_init(&checkpoint, checkpoint_path, input, num_threads, resume) != 0) {
+		return -1;
+	}
+
+	cluster = load_cluster_create(&cluster_settings);
+	if(cluster == NULL) {
+		return -1;
+	}
 	rc = connect_session(cluster, &session);
 	if(rc != CASS_OK) {
 		return -1;
@@ -119,60 +179,47 @@ int main() {
 	execute_stmt(session,
 					"USE exercise;");
 						
-	execute_stmt(session,
-					"DROP TABLE IF EXISTS flights;");
+	/* A resumed load keeps the rows already written; overlapping inserts just overwrite them. */
+	if(!resume) {
+		execute_stmt(session,
+						"DROP TABLE IF EXISTS flights;");
 					
-	execute_stmt(session,
-					"CREATE TABLE flights ( \
-						id int, year int, day_of_month int, fl_date varchar, \
-						airline_id int, carrier varchar, fl_num int, origin_airport_id int, \
-						origin varchar, origin_city_name varchar, origin_state_abr varchar, dest varchar, \
-						dest_city_name varchar, dest_state_abr varchar, dep_time int, arr_time int, \
-						actual_elapsed_time int, air_time int, distance int, air_time_grp int, \
-						PRIMARY KEY (carrier, origin, air_time_grp, id));");
+		execute_stmt(session,
+						"CREATE TABLE flights (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (" FLIGHT_SCHEMA_KEY "));");
+	}
+	if(rollup && load_rollup_create_tables(session) != 0) {
+		return -1;
+	}
 
  	time(&start);
  	
- 	if ( fp != NULL ) {
- 		int i = 0;  
-   		while(!feof(fp)) {           
-        	i++;
-                  
-   			fscanf(fp, "%d, %d, %d, %[^,], %d, %[^,], %d, %d, %[^,], %[^,], %[^,], %[^,], %[^,], %[^,], %d, %d, %d, %d, %d \n", 
-      			&Flight.id, &Flight.year, &Flight.day_of_month, Flight.fl_date, 
-      			&Flight.airline_id, Flight.carrier, &Flight.fl_num, &Flight.origin_airport_id,
-      			Flight.origin, Flight.origin_city_name, Flight.origin_state_abr, Flight.dest,
-      			Flight.dest_city_name, Flight.dest_state_abr, &Flight.dep_time, &Flight.arr_time,
-      			&Flight.actual_elapsed_time, &Flight.air_time, &Flight.distance);
-      
-    		sprintf(sql, "INSERT INTO flights (id, year, day_of_month, fl_date, airline_id, carrier, fl_num, origin_airport_id, origin, origin_city_name, origin_state_abr, dest, dest_city_name, dest_state_abr, dep_time, arr_time, actual_elapsed_time, air_time, distance, air_time_grp) VALUES (%d, %d, %d, \'%s\', %d, \'%s\', %d, %d, \'%s\', \'%s\', \'%s\', \'%s\', \'%s\', \'%s\', %d, %d, %d, %d, %d, %d);\n", 
-        		Flight.id, Flight.year, Flight.day_of_month, Flight.fl_date, 
-      			Flight.airline_id, Flight.carrier, Flight.fl_num, Flight.origin_airport_id,
-      			Flight.origin, Flight.origin_city_name, Flight.origin_state_abr, Flight.dest,
-      			Flight.dest_city_name, Flight.dest_state_abr, Flight.dep_time, Flight.arr_time,
-      			Flight.actual_elapsed_time, Flight.air_time, Flight.distance, Flight.air_time/10 );
-      			
-      		/* printf("%s", sql); */
-      		execute_stmt(session, sql);
-           
-        	/* if (i > 999) break; */
-                               
-		}  /* EOF */ 
-		printf("%d Records loaded.\n", i);
-   
-	}  /* File exists */ 
+ 	load_checkpoint_start(&checkpoint, checkpoint_interval);
+ 	load_stats_start(stats_interval);
+ 	rows = load_parts_run(input, num_threads, &checkpoint, session, load_part, &failed);
+	load_stats_stop();
+	if(rollup && load_rollup_write(session) != 0) {
+		failed = 1;
+	}
+	load_checkpoint_stop(&checkpoint);
+	printf("%ld Records loaded.\n", rows);
+	if(rollup) {
+		load_rollup_report();
+	}
+	load_stats_report();
+	load_cluster_report(&cluster_settings, stdout);
+	flight_pipeline_report();
+	load_checkpoint_report(&checkpoint);
 	
 	time(&stop);
  
-    printf("%.f Seconds total load time.\n", difftime(start, stop));   
+    printf("%.f Seconds total load time.\n", difftime(stop, start));   
    
 	close_future = cass_session_close(session);
   	cass_future_wait(close_future);
 	cass_future_free(close_future);
 	cass_cluster_free(cluster);
+	load_checkpoint_destroy(&checkpoint);
 	
-	fclose( fp ); 
-	
-	return 0;   
+	return failed ? -1 : 0;   
   
 }
@@ -0,0 +1,262 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CSV_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#include "csv_scan.h"
+
+typedef size_t (*ScanFn)(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end);
+
+static ScanFn scan_fn = NULL;
+static CsvScanImpl scan_impl = CSV_SCAN_SCALAR;
+
+static inline size_t collect(const char* base, uint64_t mask,
+							const char** commas, size_t max, size_t n) {
+	while(mask != 0) {
+		if(n < max) {
+			commas[n] = base + __builtin_ctzll(mask);
+		}
+		n++;
+		mask &= mask - 1;
+	}
+	return n;
+}
+
+static size_t scan_tail(const char* p, const char* end,
+						const char** commas, size_t max, const char** record_end, size_t n) {
+	for(; p < end; ++p) {
+		if(*p == ',') {
+			if(n < max) {
+				commas[n] = p;
+			}
+			n++;
+		} else if(*p == '\n') {
+			*record_end = p;
+			return n;
+		}
+	}
+	*record_end = end;
+	return n;
+}
+
+static size_t scan_scalar(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end) {
+	return scan_tail(begin, end, commas, max, record_end, 0);
+}
+
+#ifdef CSV_SCAN_X86
+
+/* Keeps the commas in front of the first newline and ends the record there. */
+#define FINISH_CHUNK(p, comma_mask, newline_mask) \
+	if(newline_mask != 0) { \
+		comma_mask &= (newline_mask & (~newline_mask + 1)) - 1; \
+		n = collect(p, comma_mask, commas, max, n); \
+		*record_end = p + __builtin_ctzll(newline_mask); \
+		return n; \
+	} \
+	n = collect(p, comma_mask, commas, max, n)
+
+static size_t scan_sse2(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end) {
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const char* p = begin;
+	size_t n = 0;
+
+	while(end - p >= 64) {
+		__m128i a = _mm_loadu_si128((const __m128i*)p);
+		__m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(p + 48));
+		uint64_t comma_mask =
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, comma)) |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, comma)) << 16 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, comma)) << 32 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(d, comma)) << 48;
+		uint64_t newline_mask =
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, newline)) |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, newline)) << 16 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, newline)) << 32 |
+			(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(d, newline)) << 48;
+
+		FINISH_CHUNK(p, comma_mask, newline_mask);
+		p += 64;
+	}
+
+	return scan_tail(p, end, commas, max, record_end, n);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end) {
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const char* p = begin;
+	size_t n = 0;
+
+	while(end - p >= 64) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*)p);
+		__m256i hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+		uint64_t comma_mask =
+			(uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, comma)) |
+			(uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, comma)) << 32;
+		uint64_t newline_mask =
+			(uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)) |
+			(uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)) << 32;
+
+		FINISH_CHUNK(p, comma_mask, newline_mask);
+		p += 64;
+	}
+
+	return scan_tail(p, end, commas, max, record_end, n);
+}
+
+#endif /* CSV_SCAN_X86 */
+
+static int impl_supported(CsvScanImpl impl) {
+	switch(impl) {
+		case CSV_SCAN_SCALAR:
+			return 1;
+#ifdef CSV_SCAN_X86
+		case CSV_SCAN_SSE2:
+			return 1;
+		case CSV_SCAN_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return 0;
+	}
+}
+
+CsvScanImpl csv_scan_set_impl(CsvScanImpl impl) {
+	if(impl == CSV_SCAN_AUTO || !impl_supported(impl)) {
+		impl = impl_supported(CSV_SCAN_AVX2) ? CSV_SCAN_AVX2 :
+			impl_supported(CSV_SCAN_SSE2) ? CSV_SCAN_SSE2 : CSV_SCAN_SCALAR;
+	}
+
+	switch(impl) {
+#ifdef CSV_SCAN_X86
+		case CSV_SCAN_AVX2:
+			scan_fn = scan_avx2;
+			break;
+		case CSV_SCAN_SSE2:
+			scan_fn = scan_sse2;
+			break;
+#endif
+		default:
+			scan_fn = scan_scalar;
+			break;
+	}
+	scan_impl = impl;
+
+	return scan_impl;
+}
+
+/* Picks the kernel before main runs so worker threads never race on it. */
+__attribute__((constructor))
+static void csv_scan_init(void) {
+	csv_scan_set_impl(CSV_SCAN_AUTO);
+}
+
+const char* csv_scan_impl_name(CsvScanImpl impl) {
+	switch(impl) {
+		case CSV_SCAN_SCALAR:
+			return "scalar";
+		case CSV_SCAN_SSE2:
+			return "sse2";
+		case CSV_SCAN_AVX2:
+			return "avx2";
+		default:
+			return csv_scan_impl_name(scan_impl);
+	}
+}
+
+size_t csv_scan_record(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end) {
+	return scan_fn(begin, end, commas, max, record_end);
+}
+
+int csv_decode_int(const char* p, size_t length, const char* limit, int* value) {
+	const char* end = p + length;
+	int negative = 0;
+	size_t digits = 0;
+
+	if(length > 0 && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	digits = (size_t)(end - p);
+	if(digits == 0) {
+		return -1;
+	}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if(digits <= 8 && limit - p >= 8) {
+		uint64_t v = 0;
+		unsigned shift = (unsigned)(8 - digits) * 8;
+
+		/* Drop the bytes past the field and pad the front with '0'. */
+		memcpy(&v, p, 8);
+		if(shift != 0) {
+			v = (v << shift) | (0x3030303030303030ULL >> (64 - shift));
+		}
+
+		if(((v & 0xF0F0F0F0F0F0F0F0ULL) |
+			(((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) {
+			return -1;
+		}
+
+		v = ((v & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+		v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+		v = ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+
+		*value = negative ? -(int)v : (int)v;
+		return 0;
+	}
+#else
+	(void)limit;
+#endif
+
+	{
+		long long result = 0;
+
+		if(digits > 10) {
+			return -1;
+		}
+		for(; p < end; ++p) {
+			unsigned digit = (unsigned)(*p - '0');
+			if(digit > 9) {
+				return -1;
+			}
+			result = result * 10 + digit;
+		}
+		if(result > (negative ? -(long long)INT_MIN : (long long)INT_MAX)) {
+			return -1;
+		}
+
+		*value = negative ? (int)-result : (int)result;
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Vectorized delimiter scanning and integer decoding for the flights CSV.
+
+  On x86-64 the best kernel the CPU supports is picked at run time (AVX2,
+  otherwise 128-bit SSE2 which every x86-64 has); other targets use the
+  scalar kernel. No special compiler flags are needed.
+*/
+
+#ifndef CSV_SCAN_H
+#define CSV_SCAN_H
+
+#include <stddef.h>
+
+typedef enum CsvScanImpl_ {
+	CSV_SCAN_AUTO = 0,
+	CSV_SCAN_SCALAR,
+	CSV_SCAN_SSE2,
+	CSV_SCAN_AVX2
+} CsvScanImpl;
+
+/*
+  Forces a kernel, mainly for benchmarking. Returns the kernel in use,
+  which is the automatic choice if the requested one is not supported.
+*/
+CsvScanImpl csv_scan_set_impl(CsvScanImpl impl);
+
+const char* csv_scan_impl_name(CsvScanImpl impl);
+
+/*
+  Scans the record starting at begin for ',' and '\n' in 64 byte chunks.
+  The positions of the first max commas are stored in commas and the total
+  number of commas in the record is returned. *record_end is set to the
+  terminating '\n', or to end if the record is not terminated.
+*/
+size_t csv_scan_record(const char* begin, const char* end,
+						const char** commas, size_t max, const char** record_end);
+
+/*
+  Decodes an optionally signed decimal without strtol. Up to 8 digits are
+  converted with one SWAR multiply sequence when 8 bytes may be read from
+  p, i.e. p + 8 <= limit. Returns 0 on success and -1 if the field is not
+  a number that fits in an int.
+*/
+int csv_decode_int(const char* p, size_t length, const char* limit, int* value);
+
+#endif /* CSV_SCAN_H */
@@ -0,0 +1,454 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "flight_binary.h"
+#include "flight_intern.h"
+
+#define BINARY_MAGIC "FLIGHTS\x1a"
+#define BINARY_MAGIC_LENGTH 8
+#define BINARY_VERSION 2
+#define BINARY_BYTE_ORDER 0x01020304u
+
+/*
+  The columns records are written with, e.g. "id int, ..., carrier varchar
+  dictionary, ..."; a file written for any other schema is refused.
+*/
+#define BINARY_INTERNED_0 ""
+#define BINARY_INTERNED_1 " dictionary"
+#define BINARY_INT_COLUMN(name, ...) #name " int, "
+#define BINARY_TEXT_COLUMN(name, csv, interned) #name " varchar" BINARY_INTERNED_##interned ", "
+
+#define BINARY_SCHEMA FLIGHT_SCHEMA(BINARY_INT_COLUMN, BINARY_TEXT_COLUMN, FLIGHT_SCHEMA_SKIP)
+
+/*
+  magic, then version, byte order, block size, schema length, the block
+  the dictionary starts at and its length, as uint32
+*/
+#define BINARY_HEADER_FIELDS 6
+#define BINARY_HEADER_FIXED (BINARY_MAGIC_LENGTH + BINARY_HEADER_FIELDS * sizeof(uint32_t))
+
+#define VARINT_MAX 5
+
+/* Longest record body: every int and every string at its longest. */
+#define INT_MAX_BYTES(name, ...) VARINT_MAX +
+#define TEXT_MAX_BYTES(name, ...) VARINT_MAX + 1 + UINT8_MAX +
+
+#define RECORD_MAX (FLIGHT_SCHEMA(INT_MAX_BYTES, TEXT_MAX_BYTES, FLIGHT_SCHEMA_SKIP) 0)
+
+struct FlightBinaryWriter_ {
+	FILE*			file;
+	char*			block;
+	size_t			used;
+	size_t			blocks;		/* written so far, the header included */
+
+	/* Interned columns only; a word's index is its id in the column's table. */
+	FlightIntern*	intern[FLIGHT_NUM_STRINGS];
+	FlightString*	words[FLIGHT_NUM_STRINGS];
+	size_t			num_words[FLIGHT_NUM_STRINGS];
+} ;
+
+static char* put_varint(char* out, uint32_t value) {
+	while(value >= 0x80) {
+		*out++ = (char)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (char)value;
+	return out;
+}
+
+static uint32_t zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static char* put_string(char* out, const FlightString* string) {
+	*out++ = (char)string->length;
+	memcpy(out, string->data, string->length);
+	return out + string->length;
+}
+
+/* Writes the index of string in the column's dictionary, adding it if it is new. */
+static char* put_word(FlightBinaryWriter* writer, int column, const FlightString* string, char* out) {
+	FlightString word = *string;
+	int id = flight_intern(writer->intern[column], &word);
+
+	if(id < 0) {
+		/* The dictionary is full; later values are written out in full. */
+		*out++ = 0;
+		return put_string(out, string);
+	}
+	if((size_t)id == writer->num_words[column]) {
+		writer->words[column][id] = word;
+		writer->num_words[column]++;
+	}
+	return put_varint(out, (uint32_t)id + 1);
+}
+
+static int write_bytes(FlightBinaryWriter* writer, const char* data, size_t length) {
+	if(fwrite(data, 1, length, writer->file) != length) {
+		fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int write_block(FlightBinaryWriter* writer) {
+	if(write_bytes(writer, writer->block, FLIGHT_BINARY_BLOCK_SIZE) != 0) {
+		return -1;
+	}
+	memset(writer->block, 0, FLIGHT_BINARY_BLOCK_SIZE);
+	writer->used = 0;
+	writer->blocks++;
+	return 0;
+}
+
+static void write_header(FlightBinaryWriter* writer, size_t dictionary_block, size_t dictionary_length) {
+	uint32_t header[BINARY_HEADER_FIELDS] = {
+		BINARY_VERSION, BINARY_BYTE_ORDER, FLIGHT_BINARY_BLOCK_SIZE, sizeof(BINARY_SCHEMA) - 1,
+		(uint32_t)dictionary_block, (uint32_t)dictionary_length
+	};
+
+	memcpy(writer->block, BINARY_MAGIC, BINARY_MAGIC_LENGTH);
+	memcpy(writer->block + BINARY_MAGIC_LENGTH, header, sizeof(header));
+	memcpy(writer->block + BINARY_HEADER_FIXED, BINARY_SCHEMA, sizeof(BINARY_SCHEMA) - 1);
+}
+
+static void free_writer(FlightBinaryWriter* writer) {
+	int i;
+
+	for(i = 0; i < FLIGHT_NUM_STRINGS; ++i) {
+		flight_intern_free(writer->intern[i]);
+		free(writer->words[i]);
+	}
+	free(writer->block);
+	free(writer);
+}
+
+/* FLIGHT_SCHEMA expansion: a table and a word list for each interned column. */
+#define NEW_DICTIONARY(name, csv, interned) \
+	if(interned) { \
+		writer->intern[FLIGHT_STRING_##name] = flight_intern_new(); \
+		writer->words[FLIGHT_STRING_##name] = malloc(FLIGHT_INTERN_MAX_STRINGS * sizeof(FlightString)); \
+		if(writer->intern[FLIGHT_STRING_##name] == NULL || writer->words[FLIGHT_STRING_##name] == NULL) { \
+			failed = 1; \
+		} \
+	}
+
+FlightBinaryWriter* flight_binary_create(const char* path) {
+	FlightBinaryWriter* writer = calloc(1, sizeof(FlightBinaryWriter));
+	int failed = 0;
+
+	if(writer == NULL) {
+		return NULL;
+	}
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, NEW_DICTIONARY, FLIGHT_SCHEMA_SKIP)
+	writer->block = calloc(1, FLIGHT_BINARY_BLOCK_SIZE);
+	if(failed || writer->block == NULL) {
+		fprintf(stderr, "Error: out of memory for %s\n", path);
+		free_writer(writer);
+		return NULL;
+	}
+	writer->file = fopen(path, "wb");
+	if(writer->file == NULL) {
+		fprintf(stderr, "Error: unable to create %s: %s\n", path, strerror(errno));
+		free_writer(writer);
+		return NULL;
+	}
+
+	/* The dictionary fields are filled in on close. */
+	write_header(writer, 0, 0);
+	if(write_block(writer) != 0) {
+		fclose(writer->file);
+		free_writer(writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+/* FLIGHT_SCHEMA expansions for flight_binary_write(). */
+#define TEXT_TOO_LONG(name, ...) flight->name.length > UINT8_MAX ||
+#define PUT_INT(name, ...) out = put_varint(out, zigzag(flight->name));
+#define PUT_TEXT(name, csv, interned) \
+	out = interned ? put_word(writer, FLIGHT_STRING_##name, &flight->name, out) : put_string(out, &flight->name);
+
+int flight_binary_write(FlightBinaryWriter* writer, const Flight* flight) {
+	char body[RECORD_MAX];
+	char length[VARINT_MAX];
+	char* out = body;
+	size_t length_bytes = 0;
+	size_t body_bytes = 0;
+
+	if(FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, TEXT_TOO_LONG, FLIGHT_SCHEMA_SKIP) 0) {
+		return 1;
+	}
+
+	FLIGHT_SCHEMA(PUT_INT, PUT_TEXT, FLIGHT_SCHEMA_SKIP)
+	body_bytes = (size_t)(out - body);
+	length_bytes = (size_t)(put_varint(length, (uint32_t)body_bytes) - length);
+
+	if(writer->used + length_bytes + body_bytes > FLIGHT_BINARY_BLOCK_SIZE && write_block(writer) != 0) {
+		return -1;
+	}
+
+	memcpy(writer->block + writer->used, length, length_bytes);
+	memcpy(writer->block + writer->used + length_bytes, body, body_bytes);
+	writer->used += length_bytes + body_bytes;
+	return 0;
+}
+
+size_t flight_binary_size(const FlightBinaryWriter* writer) {
+	return writer->blocks * FLIGHT_BINARY_BLOCK_SIZE + writer->used;
+}
+
+/* Writes the words of one column; adds their length to *length. */
+static int write_words(FlightBinaryWriter* writer, int column, size_t* length) {
+	char buffer[VARINT_MAX + 1 + UINT8_MAX];
+	size_t n = (size_t)(put_varint(buffer, (uint32_t)writer->num_words[column]) - buffer);
+	size_t i;
+
+	if(write_bytes(writer, buffer, n) != 0) {
+		return -1;
+	}
+	*length += n;
+	for(i = 0; i < writer->num_words[column]; ++i) {
+		n = (size_t)(put_string(buffer, &writer->words[column][i]) - buffer);
+		if(write_bytes(writer, buffer, n) != 0) {
+			return -1;
+		}
+		*length += n;
+	}
+	return 0;
+}
+
+#define WRITE_WORDS(name, csv, interned) \
+	if(interned && rc == 0) { \
+		rc = write_words(writer, FLIGHT_STRING_##name, &dictionary_length); \
+	}
+
+int flight_binary_close(FlightBinaryWriter* writer) {
+	size_t dictionary_block = 0;
+	size_t dictionary_length = 0;
+	int rc = 0;
+
+	/* The dictionary starts on a block boundary, after the zero padding of the last block. */
+	if(writer->used > 0) {
+		rc = write_block(writer);
+	}
+	dictionary_block = writer->blocks;
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, WRITE_WORDS, FLIGHT_SCHEMA_SKIP)
+
+	if(rc == 0) {
+		write_header(writer, dictionary_block, dictionary_length);
+		if(fseek(writer->file, 0, SEEK_SET) != 0) {
+			fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+			rc = -1;
+		} else {
+			rc = write_bytes(writer, writer->block, BINARY_HEADER_FIXED);
+		}
+	}
+	if(fclose(writer->file) != 0) {
+		fprintf(stderr, "Error: write failed: %s\n", strerror(errno));
+		rc = -1;
+	}
+
+	free_writer(writer);
+	return rc;
+}
+
+static int get_varint(const unsigned char** in, const unsigned char* end, uint32_t* value) {
+	const unsigned char* p = *in;
+	uint32_t result = 0;
+	int shift = 0;
+
+	do {
+		if(p == end || shift > 28) {
+			return -1;
+		}
+		result |= (uint32_t)(*p & 0x7f) << shift;
+		shift += 7;
+	} while(*p++ & 0x80);
+
+	*value = result;
+	*in = p;
+	return 0;
+}
+
+static int get_string(const unsigned char** in, const unsigned char* end, FlightString* string) {
+	size_t length = 0;
+
+	if(*in == end) {
+		return -1;
+	}
+	length = **in;
+	if((size_t)(end - *in) - 1 < length) {
+		return -1;
+	}
+	string->data = (const char*)*in + 1;
+	string->length = length;
+	*in += 1 + length;
+	return 0;
+}
+
+/* Reads the dictionary of one column; the words point into the file. */
+static int read_words(FlightBinaryFile* file, int column, const unsigned char** in, const unsigned char* end) {
+	uint32_t count = 0;
+	uint32_t i;
+
+	/* A word takes at least its length byte, which bounds a damaged count. */
+	if(get_varint(in, end, &count) != 0 || count > (size_t)(end - *in)) {
+		return -1;
+	}
+	file->words[column] = malloc((count > 0 ? count : 1) * sizeof(FlightString));
+	if(file->words[column] == NULL) {
+		return -1;
+	}
+	for(i = 0; i < count; ++i) {
+		if(get_string(in, end, &file->words[column][i]) != 0) {
+			return -1;
+		}
+	}
+	file->num_words[column] = count;
+	return 0;
+}
+
+#define READ_WORDS(name, csv, interned) \
+	if(interned && rc == 0) { \
+		rc = read_words(file, FLIGHT_STRING_##name, &in, end); \
+	}
+
+int flight_binary_check(const char* data, size_t size, FlightBinaryFile* file) {
+	uint32_t header[BINARY_HEADER_FIELDS];
+	const unsigned char* in = NULL;
+	const unsigned char* end = NULL;
+	size_t records_end = 0;
+	int rc = 0;
+
+	memset(file, 0, sizeof(FlightBinaryFile));
+	if(size < BINARY_MAGIC_LENGTH + 3 * sizeof(uint32_t) || memcmp(data, BINARY_MAGIC, BINARY_MAGIC_LENGTH) != 0) {
+		return 0;
+	}
+	/* Version and byte order come first in every version, so they can be checked before the rest. */
+	memcpy(header, data + BINARY_MAGIC_LENGTH, 2 * sizeof(uint32_t));
+
+	if(header[1] != BINARY_BYTE_ORDER) {
+		fprintf(stderr, "Error: flights binary file was written with another byte order\n");
+		return -1;
+	}
+	if(header[0] != BINARY_VERSION) {
+		fprintf(stderr, "Error: flights binary file has version %u, expected %u; convert it again\n",
+			(unsigned)header[0], (unsigned)BINARY_VERSION);
+		return -1;
+	}
+	if(size < BINARY_HEADER_FIXED) {
+		fprintf(stderr, "Error: flights binary file is truncated\n");
+		return -1;
+	}
+	memcpy(header, data + BINARY_MAGIC_LENGTH, sizeof(header));
+	if(header[2] < BINARY_HEADER_FIXED + header[3] || header[2] > size ||
+		header[3] != sizeof(BINARY_SCHEMA) - 1 ||
+		memcmp(data + BINARY_HEADER_FIXED, BINARY_SCHEMA, header[3]) != 0) {
+		fprintf(stderr, "Error: flights binary file was written for another schema\n");
+		return -1;
+	}
+
+	records_end = (size_t)header[4] * header[2];
+	if(header[4] < 1 || records_end > size || size - records_end != header[5]) {
+		fprintf(stderr, "Error: flights binary file is truncated or was not closed\n");
+		return -1;
+	}
+
+	file->block_size = header[2];
+	file->records_end = records_end;
+	in = (const unsigned char*)data + records_end;
+	end = in + header[5];
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, READ_WORDS, FLIGHT_SCHEMA_SKIP)
+	if(rc != 0 || in != end) {
+		fprintf(stderr, "Error: flights binary file has a damaged dictionary\n");
+		flight_binary_release(file);
+		return -1;
+	}
+
+	return 1;
+}
+
+void flight_binary_release(FlightBinaryFile* file) {
+	int i;
+
+	for(i = 0; i < FLIGHT_NUM_STRINGS; ++i) {
+		free(file->words[i]);
+		file->words[i] = NULL;
+		file->num_words[i] = 0;
+	}
+}
+
+/* Reads a TEXT column; column is the dictionary to look words up in, or -1 if it has none. */
+static int get_text(const FlightBinaryFile* file, int column, const unsigned char** in, const unsigned char* end,
+					FlightString* string) {
+	uint32_t word = 0;
+
+	if(column >= 0) {
+		if(get_varint(in, end, &word) != 0) {
+			return -1;
+		}
+		if(word > 0) {
+			if(word > file->num_words[column]) {
+				return -1;
+			}
+			*string = file->words[column][word - 1];
+			return 0;
+		}
+	}
+	return get_string(in, end, string);
+}
+
+/* FLIGHT_SCHEMA expansions for flight_binary_decode(). */
+#define GET_INT(name, ...) \
+	if(get_varint(&in, end, &value) != 0) { \
+		return -1; \
+	} \
+	flight->name = (int32_t)((value >> 1) ^ (0u - (value & 1)));
+#define GET_TEXT(name, csv, interned) \
+	if(get_text(file, interned ? FLIGHT_STRING_##name : -1, &in, end, &flight->name) != 0) { \
+		return -1; \
+	}
+
+int flight_binary_decode(const FlightBinaryFile* file, const char* data, size_t available, Flight* flight) {
+	const unsigned char* in = (const unsigned char*)data;
+	const unsigned char* end = in + available;
+	uint32_t length = 0;
+	uint32_t value = 0;
+
+	if(available == 0 || *in == 0) {
+		return 0;
+	}
+	if(get_varint(&in, end, &length) != 0 || length > (size_t)(end - in)) {
+		return -1;
+	}
+	end = in + length;
+
+	FLIGHT_SCHEMA(GET_INT, GET_TEXT, FLIGHT_SCHEMA_SKIP)
+	if(in != end) {
+		return -1;
+	}
+
+	return (int)(end - (const unsigned char*)data);
+}
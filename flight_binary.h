@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Compact binary form of flights_from_pg.csv for extracts that are loaded
+  over and over. "Flights Binary Converter.c" writes it once; after that
+  flight_reader recognizes the file by its header and returns rows that
+  point straight into the mapping, with no text to parse.
+
+  The file is a sequence of FLIGHT_BINARY_BLOCK_SIZE byte blocks followed
+  by a dictionary. Block 0 holds the header: magic, version, byte order,
+  block size, the schema the records were written with, and where the
+  dictionary starts and how long it is. Every other block holds whole
+  records, so the input can still be split into parts on block
+  boundaries. The rest of a block after its last record is zero. A record
+  is
+
+    varint  length of the rest of the record, never 0
+    varint  each INT column of flight_schema.h, zigzag encoded
+            then each TEXT column:
+              interned  varint n, the n-th word of the column's
+                        dictionary (1 based), or 0 and a string
+              others    a string
+
+  where a varint is 7 bits per byte, low bits first, and a string is a
+  uint8 length and its bytes. The dictionary has, for each interned
+  column, a varint count and that many strings, in the order the writer
+  first saw them. Both are expanded from FLIGHT_SCHEMA, and the schema
+  in the header says which columns are interned, so a file is refused by
+  a build with any other list of columns.
+
+  The header fields are uint32 in host byte order; a file can only be
+  read on a machine with the byte order it was written with.
+*/
+
+#ifndef FLIGHT_BINARY_H
+#define FLIGHT_BINARY_H
+
+#include <stddef.h>
+
+#include "flight_reader.h"
+
+#define FLIGHT_BINARY_BLOCK_SIZE (64 * 1024)
+
+typedef struct FlightBinaryWriter_ FlightBinaryWriter;
+
+/* Creates path and writes the header. Returns NULL if it cannot be written. */
+FlightBinaryWriter* flight_binary_create(const char* path);
+
+/*
+  Appends one row. Returns 0, 1 if a string column is too long for the
+  format (the row is not written), or -1 if the write failed.
+*/
+int flight_binary_write(FlightBinaryWriter* writer, const Flight* flight);
+
+/* Bytes of the file so far, header and records; the dictionary is written on close. */
+size_t flight_binary_size(const FlightBinaryWriter* writer);
+
+/* Writes the last block and the dictionary, and closes the file. Returns 0 or -1. */
+int flight_binary_close(FlightBinaryWriter* writer);
+
+/*
+  A flights binary file as the reader needs it. Records are in the blocks
+  from block_size up to records_end. The dictionary words are views into
+  the file and stay valid as long as it is mapped.
+*/
+struct FlightBinaryFile_ {
+	size_t			block_size;
+	size_t			records_end;
+	FlightString*	words[FLIGHT_NUM_STRINGS];
+	size_t			num_words[FLIGHT_NUM_STRINGS];
+} ;
+
+typedef struct FlightBinaryFile_ FlightBinaryFile;
+
+/*
+  Checks whether data, the whole of an input, is a flights binary file.
+  Returns 1 and fills file if it is one this build can read, 0 if it is
+  not binary at all, and -1, reported on stderr, if it is binary but has
+  another version, byte order or schema, or is damaged.
+*/
+int flight_binary_check(const char* data, size_t size, FlightBinaryFile* file);
+
+/* Frees what flight_binary_check() allocated. */
+void flight_binary_release(FlightBinaryFile* file);
+
+/*
+  Decodes the record at data, which has available bytes left in its block.
+  The string views of flight point into the file. Returns the length of
+  the record, 0 if the block has no more records, or -1 if it is malformed.
+*/
+int flight_binary_decode(const FlightBinaryFile* file, const char* data, size_t available, Flight* flight);
+
+#endif /* FLIGHT_BINARY_H */
@@ -0,0 +1,93 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flight_binder.h"
+#include "load_cluster.h"
+
+/* FLIGHT_SCHEMA expansions; a bound int or varchar is a 4 byte length and its value. */
+#define BIND_INT(name, ...) cass_statement_bind_int32(statement, FLIGHT_COLUMN_##name, flight->name);
+#define BIND_TEXT(name, ...) \
+	cass_statement_bind_string(statement, FLIGHT_COLUMN_##name, cass_string_init2(flight->name.data, flight->name.length));
+#define BIND_DERIVED(name, value) cass_statement_bind_int32(statement, FLIGHT_COLUMN_##name, (value));
+#define PAYLOAD_INT(name, ...) 4 + 4 +
+#define PAYLOAD_TEXT(name, ...) 4 + flight->name.length +
+
+static long total_allocations = 0;
+static long total_binds = 0;
+
+int flight_binder_init(FlightBinder* binder, const CassPrepared* prepared, int capacity) {
+	binder->prepared = prepared;
+	binder->num_pooled = 0;
+	binder->capacity = capacity;
+	binder->allocations = 0;
+	binder->binds = 0;
+
+	binder->pool = malloc((size_t)capacity * sizeof(CassStatement*));
+	return binder->pool != NULL ? 0 : -1;
+}
+
+void flight_binder_destroy(FlightBinder* binder) {
+	int i;
+
+	for(i = 0; i < binder->num_pooled; ++i) {
+		cass_statement_free(binder->pool[i]);
+	}
+	free(binder->pool);
+	binder->pool = NULL;
+	binder->num_pooled = 0;
+
+	__sync_fetch_and_add(&total_allocations, binder->allocations);
+	__sync_fetch_and_add(&total_binds, binder->binds);
+}
+
+CassStatement* flight_binder_acquire(FlightBinder* binder) {
+	CassStatement* statement = NULL;
+
+	if(binder->num_pooled > 0) {
+		return binder->pool[--binder->num_pooled];
+	}
+
+	binder->allocations++;
+	statement = cass_prepared_bind(binder->prepared);
+	load_cluster_apply(statement);
+	return statement;
+}
+
+void flight_binder_release(FlightBinder* binder, CassStatement* statement) {
+	if(binder->num_pooled < binder->capacity) {
+		binder->pool[binder->num_pooled++] = statement;
+	} else {
+		cass_statement_free(statement);
+	}
+}
+
+void flight_binder_bind(FlightBinder* binder, CassStatement* statement, const Flight* flight) {
+	binder->binds++;
+
+	FLIGHT_SCHEMA(BIND_INT, BIND_TEXT, BIND_DERIVED)
+}
+
+size_t flight_payload_bytes(const Flight* flight) {
+	return FLIGHT_SCHEMA(PAYLOAD_INT, PAYLOAD_TEXT, PAYLOAD_INT) 0;
+}
+
+void flight_binder_report(long rows) {
+	printf("%ld Statements allocated for %ld rows bound (%.4f per row).\n",
+		total_allocations, total_binds, rows > 0 ? (double)total_allocations / rows : 0.0);
+}
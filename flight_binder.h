@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Binds Flight rows to the prepared flights INSERT, as written by
+  flight_schema_insert(), using a pool of bound
+  statements, so steady state ingest does not allocate a statement per row.
+
+  A statement may only be rebound once the driver is done with it, i.e.
+  after the future of the request (or the batch) it was part of has
+  completed. A binder is not thread safe; each loader thread owns one.
+*/
+
+#ifndef FLIGHT_BINDER_H
+#define FLIGHT_BINDER_H
+
+#include "cassandra.h"
+
+#include "flight_reader.h"
+
+struct FlightBinder_ {
+	const CassPrepared*	prepared;
+	CassStatement**		pool;
+	int					num_pooled;
+	int					capacity;
+
+	long				allocations;	/* cass_prepared_bind() calls */
+	long				binds;			/* rows bound */
+} ;
+
+typedef struct FlightBinder_ FlightBinder;
+
+/* capacity is the most idle statements kept for reuse. */
+int flight_binder_init(FlightBinder* binder, const CassPrepared* prepared, int capacity);
+
+/* Frees pooled statements and adds the counters to the process totals. */
+void flight_binder_destroy(FlightBinder* binder);
+
+/* Takes an idle statement, allocating one only if the pool is empty. */
+CassStatement* flight_binder_acquire(FlightBinder* binder);
+
+/* Returns a statement the driver has finished with. */
+void flight_binder_release(FlightBinder* binder, CassStatement* statement);
+
+/* Binds every column of flight_schema.h, overwriting whatever the statement held before. */
+void flight_binder_bind(FlightBinder* binder, CassStatement* statement, const Flight* flight);
+
+/* Approximate bytes a bound row puts on the wire: one length prefixed value per column. */
+size_t flight_payload_bytes(const Flight* flight);
+
+/* Prints the statement allocation totals of all destroyed binders. */
+void flight_binder_report(long rows);
+
+#endif /* FLIGHT_BINDER_H */
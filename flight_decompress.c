@@ -0,0 +1,379 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef FLIGHT_NO_GZIP
+#include <zlib.h>
+#endif
+#ifndef FLIGHT_NO_ZSTD
+#include <zstd.h>
+#endif
+
+#include "flight_decompress.h"
+
+/* Decompressed text waiting for the reader: a few buffers, handed over whole. */
+#define OUTPUT_BUFFERS 4
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+#define INPUT_BUFFER_SIZE (256 * 1024)
+
+struct FlightDecompress_ {
+	int				format;
+	FlightInputRead	read;
+	void*			source;
+
+	/* Compressed input, only touched by the thread. */
+	char*			in;
+	size_t			in_capacity;
+	size_t			in_length;
+	size_t			in_pos;
+	int				in_eof;
+	int				ended;		/* the last member or frame is complete */
+#ifndef FLIGHT_NO_GZIP
+	z_stream		gzip;
+	int				gzip_ready;
+#endif
+#ifndef FLIGHT_NO_ZSTD
+	ZSTD_DStream*	zstd;
+#endif
+
+	char*			buffers[OUTPUT_BUFFERS];
+	size_t			lengths[OUTPUT_BUFFERS];
+	int				produce;
+	int				consume;
+	size_t			consume_pos;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	changed;
+	int				filled;		/* buffers ready for the reader */
+	int				done;
+	int				failed;
+	int				stopping;
+	pthread_t		thread;
+} ;
+
+int flight_decompress_detect(const char* data, size_t length) {
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	if(length >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+		return FLIGHT_DECOMPRESS_GZIP;
+	}
+	if(length >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+		return FLIGHT_DECOMPRESS_ZSTD;
+	}
+	return FLIGHT_DECOMPRESS_NONE;
+}
+
+/* Reads more compressed input once the last of it has been used up. */
+static int fill_input(FlightDecompress* input) {
+	ssize_t n = 0;
+
+	if(input->in_pos < input->in_length || input->in_eof) {
+		return 0;
+	}
+
+	n = input->read(input->source, input->in, input->in_capacity);
+	if(n < 0) {
+		return -1;
+	}
+	input->in_length = (size_t)n;
+	input->in_pos = 0;
+	input->in_eof = n == 0;
+	return 0;
+}
+
+#ifndef FLIGHT_NO_GZIP
+/* Inflates into output until it is full (1), at the end of the input (0), or on an error (-1). */
+static int inflate_some(FlightDecompress* input, char* output, size_t* length) {
+	z_stream* z = &input->gzip;
+
+	while(*length < OUTPUT_BUFFER_SIZE) {
+		int rc = 0;
+
+		if(fill_input(input) != 0) {
+			return -1;
+		}
+		if(input->in_pos == input->in_length) {
+			if(input->ended) {
+				return 0;
+			}
+			fprintf(stderr, "Error: gzip input is truncated\n");
+			return -1;
+		}
+
+		z->next_in = (unsigned char*)input->in + input->in_pos;
+		z->avail_in = (unsigned)(input->in_length - input->in_pos);
+		z->next_out = (unsigned char*)output + *length;
+		z->avail_out = (unsigned)(OUTPUT_BUFFER_SIZE - *length);
+		rc = inflate(z, Z_NO_FLUSH);
+		input->in_pos = input->in_length - z->avail_in;
+		*length = OUTPUT_BUFFER_SIZE - z->avail_out;
+
+		if(rc == Z_STREAM_END) {
+			/* Another member may follow. */
+			input->ended = 1;
+			inflateReset(z);
+		} else if(rc == Z_OK) {
+			input->ended = 0;
+		} else if(rc != Z_BUF_ERROR) {
+			fprintf(stderr, "Error: gzip input is corrupt: %s\n", z->msg != NULL ? z->msg : "inflate failed");
+			return -1;
+		}
+	}
+
+	return 1;
+}
+#endif
+
+#ifndef FLIGHT_NO_ZSTD
+static int zstd_some(FlightDecompress* input, char* output, size_t* length) {
+	while(*length < OUTPUT_BUFFER_SIZE) {
+		ZSTD_inBuffer in;
+		ZSTD_outBuffer out;
+		size_t rc = 0;
+
+		if(fill_input(input) != 0) {
+			return -1;
+		}
+		if(input->in_pos == input->in_length && input->ended) {
+			return 0;
+		}
+
+		in.src = input->in;
+		in.size = input->in_length;
+		in.pos = input->in_pos;
+		out.dst = output;
+		out.size = OUTPUT_BUFFER_SIZE;
+		out.pos = *length;
+		rc = ZSTD_decompressStream(input->zstd, &out, &in);
+		if(ZSTD_isError(rc)) {
+			fprintf(stderr, "Error: zstd input is corrupt: %s\n", ZSTD_getErrorName(rc));
+			return -1;
+		}
+
+		if(in.pos == input->in_pos && out.pos == *length && input->in_eof) {
+			fprintf(stderr, "Error: zstd input is truncated\n");
+			return -1;
+		}
+		input->in_pos = in.pos;
+		*length = out.pos;
+		/* 0 means a frame is complete and everything it decoded has been flushed. */
+		input->ended = rc == 0;
+	}
+
+	return 1;
+}
+#endif
+
+static int decompress_some(FlightDecompress* input, char* output, size_t* length) {
+#ifndef FLIGHT_NO_GZIP
+	if(input->format == FLIGHT_DECOMPRESS_GZIP) {
+		return inflate_some(input, output, length);
+	}
+#endif
+#ifndef FLIGHT_NO_ZSTD
+	if(input->format == FLIGHT_DECOMPRESS_ZSTD) {
+		return zstd_some(input, output, length);
+	}
+#endif
+	return -1;
+}
+
+static void* run_decompress(void* data) {
+	FlightDecompress* input = (FlightDecompress*)data;
+
+	for(;;) {
+		int index = input->produce;
+		int rc = 0;
+
+		pthread_mutex_lock(&input->lock);
+		while(input->filled == OUTPUT_BUFFERS && !input->stopping) {
+			pthread_cond_wait(&input->changed, &input->lock);
+		}
+		if(input->stopping) {
+			pthread_mutex_unlock(&input->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&input->lock);
+
+		input->lengths[index] = 0;
+		rc = decompress_some(input, input->buffers[index], &input->lengths[index]);
+
+		pthread_mutex_lock(&input->lock);
+		if(input->lengths[index] > 0) {
+			input->filled++;
+			input->produce = (index + 1) % OUTPUT_BUFFERS;
+		}
+		if(rc <= 0) {
+			input->done = 1;
+			input->failed = rc < 0;
+		}
+		pthread_cond_signal(&input->changed);
+		pthread_mutex_unlock(&input->lock);
+
+		if(rc <= 0) {
+			return NULL;
+		}
+	}
+}
+
+static void release(FlightDecompress* input) {
+	int i;
+
+#ifndef FLIGHT_NO_GZIP
+	if(input->gzip_ready) {
+		inflateEnd(&input->gzip);
+	}
+#endif
+#ifndef FLIGHT_NO_ZSTD
+	if(input->zstd != NULL) {
+		ZSTD_freeDStream(input->zstd);
+	}
+#endif
+	for(i = 0; i < OUTPUT_BUFFERS; ++i) {
+		free(input->buffers[i]);
+	}
+	free(input->in);
+	free(input);
+}
+
+FlightDecompress* flight_decompress_start(int format, FlightInputRead read, void* source,
+											const char* prefix, size_t prefix_length) {
+	FlightDecompress* input = NULL;
+	int i;
+
+	input = calloc(1, sizeof(FlightDecompress));
+	if(input == NULL) {
+		return NULL;
+	}
+	input->format = format;
+	input->read = read;
+	input->source = source;
+
+	input->in_capacity = prefix_length > INPUT_BUFFER_SIZE ? prefix_length : INPUT_BUFFER_SIZE;
+	input->in = malloc(input->in_capacity);
+	if(input->in == NULL) {
+		release(input);
+		return NULL;
+	}
+	memcpy(input->in, prefix, prefix_length);
+	input->in_length = prefix_length;
+
+	for(i = 0; i < OUTPUT_BUFFERS; ++i) {
+		input->buffers[i] = malloc(OUTPUT_BUFFER_SIZE);
+		if(input->buffers[i] == NULL) {
+			release(input);
+			return NULL;
+		}
+	}
+
+	if(format == FLIGHT_DECOMPRESS_GZIP) {
+#ifndef FLIGHT_NO_GZIP
+		/* 15 + 32: the largest window, with the gzip header detected. */
+		if(inflateInit2(&input->gzip, 15 + 32) != Z_OK) {
+			release(input);
+			return NULL;
+		}
+		input->gzip_ready = 1;
+#else
+		fprintf(stderr, "Error: gzip input needs a build without FLIGHT_NO_GZIP\n");
+		release(input);
+		return NULL;
+#endif
+	} else if(format == FLIGHT_DECOMPRESS_ZSTD) {
+#ifndef FLIGHT_NO_ZSTD
+		input->zstd = ZSTD_createDStream();
+		if(input->zstd == NULL) {
+			release(input);
+			return NULL;
+		}
+		ZSTD_initDStream(input->zstd);
+#else
+		fprintf(stderr, "Error: zstd input needs a build without FLIGHT_NO_ZSTD\n");
+		release(input);
+		return NULL;
+#endif
+	} else {
+		release(input);
+		return NULL;
+	}
+
+	pthread_mutex_init(&input->lock, NULL);
+	pthread_cond_init(&input->changed, NULL);
+	if(pthread_create(&input->thread, NULL, run_decompress, input) != 0) {
+		fprintf(stderr, "Error: unable to start the decompression thread\n");
+		pthread_cond_destroy(&input->changed);
+		pthread_mutex_destroy(&input->lock);
+		release(input);
+		return NULL;
+	}
+
+	return input;
+}
+
+ssize_t flight_decompress_read(FlightDecompress* input, char* buffer, size_t length) {
+	size_t available = 0;
+	int index = input->consume;
+
+	pthread_mutex_lock(&input->lock);
+	while(input->filled == 0 && !input->done) {
+		pthread_cond_wait(&input->changed, &input->lock);
+	}
+	if(input->filled == 0) {
+		int rc = input->failed ? -1 : 0;
+		pthread_mutex_unlock(&input->lock);
+		return rc;
+	}
+	pthread_mutex_unlock(&input->lock);
+
+	available = input->lengths[index] - input->consume_pos;
+	if(length > available) {
+		length = available;
+	}
+	memcpy(buffer, input->buffers[index] + input->consume_pos, length);
+	input->consume_pos += length;
+
+	if(input->consume_pos == input->lengths[index]) {
+		pthread_mutex_lock(&input->lock);
+		input->filled--;
+		input->consume = (index + 1) % OUTPUT_BUFFERS;
+		input->consume_pos = 0;
+		pthread_cond_signal(&input->changed);
+		pthread_mutex_unlock(&input->lock);
+	}
+
+	return (ssize_t)length;
+}
+
+void flight_decompress_stop(FlightDecompress* input) {
+	if(input == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&input->lock);
+	input->stopping = 1;
+	pthread_cond_signal(&input->changed);
+	pthread_mutex_unlock(&input->lock);
+	pthread_join(input->thread, NULL);
+
+	pthread_cond_destroy(&input->changed);
+	pthread_mutex_destroy(&input->lock);
+	release(input);
+}
@@ -0,0 +1,63 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Streaming decompression of gzip and zstd input on a thread of its own.
+  flight_reader recognizes a compressed file or pipe by its first bytes
+  and reads the text through flight_decompress_read() instead; the
+  thread inflates into a few large buffers ahead of it, so the extra CPU
+  overlaps with parsing and with the loader's network waits.
+
+  Concatenated gzip members and zstd frames are read as one stream, as
+  zcat and zstdcat do. Both libraries are linked by default (-lz -lzstd);
+  build with -DFLIGHT_NO_GZIP or -DFLIGHT_NO_ZSTD to leave one out, and
+  input in that format is then refused.
+*/
+
+#ifndef FLIGHT_DECOMPRESS_H
+#define FLIGHT_DECOMPRESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FLIGHT_DECOMPRESS_NONE 0
+#define FLIGHT_DECOMPRESS_GZIP 1
+#define FLIGHT_DECOMPRESS_ZSTD 2
+
+/* Where the compressed bytes come from, with the contract of read(). */
+typedef ssize_t (*FlightInputRead)(void* source, char* buffer, size_t length);
+
+typedef struct FlightDecompress_ FlightDecompress;
+
+/* Returns the format whose magic number starts data, or FLIGHT_DECOMPRESS_NONE. */
+int flight_decompress_detect(const char* data, size_t length);
+
+/*
+  Starts decompressing format from prefix, bytes that were already read
+  to detect it, and then from read(source). read is only called on the
+  decompression thread. Returns NULL if the format was left out of the
+  build or the thread cannot be started.
+*/
+FlightDecompress* flight_decompress_start(int format, FlightInputRead read, void* source,
+											const char* prefix, size_t prefix_length);
+
+/* Copies up to length decompressed bytes into buffer, like read(). Returns 0 at the end or -1. */
+ssize_t flight_decompress_read(FlightDecompress* input, char* buffer, size_t length);
+
+/* Stops the thread, even before the end of the input. */
+void flight_decompress_stop(FlightDecompress* input);
+
+#endif /* FLIGHT_DECOMPRESS_H */
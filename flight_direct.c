@@ -0,0 +1,399 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* O_DIRECT is only declared with _GNU_SOURCE. */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(O_DIRECT)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+
+#include "flight_direct.h"
+
+#ifdef HAVE_IO_URING
+
+/* Offsets, lengths and buffers must be multiples of the device's logical block size. */
+#define DIRECT_ALIGN 4096
+
+enum {
+	BUFFER_IDLE,
+	BUFFER_READING,
+	BUFFER_READY
+} ;
+
+struct DirectBuffer_ {
+	char*			data;
+	struct iovec	iov;
+	size_t			offset;		/* file offset of data[0] */
+	long			result;		/* bytes read, or -errno */
+	int				state;
+} ;
+
+typedef struct DirectBuffer_ DirectBuffer;
+
+struct FlightDirect_ {
+	int				fd;
+	size_t			size;
+
+	int				ring_fd;
+	void*			sq_ring;
+	size_t			sq_ring_size;
+	void*			cq_ring;
+	size_t			cq_ring_size;
+	struct io_uring_sqe* sqes;
+	size_t			sqes_size;
+	unsigned*		sq_tail;
+	unsigned*		sq_mask;
+	unsigned*		sq_array;
+	unsigned*		cq_head;
+	unsigned*		cq_tail;
+	unsigned*		cq_mask;
+	struct io_uring_cqe* cqes;
+
+	/* Buffers are requested in file order, round the array. */
+	DirectBuffer	buffers[FLIGHT_DIRECT_DEPTH];
+	int				head;		/* buffer holding the next bytes */
+	size_t			pos;		/* bytes of it already copied out */
+	size_t			next;		/* file offset of the next block to request */
+	int				in_flight;
+} ;
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int map_ring(FlightDirect* input) {
+	struct io_uring_params params;
+	char* sq = NULL;
+	char* cq = NULL;
+
+	memset(&params, 0, sizeof(params));
+	input->ring_fd = uring_setup(FLIGHT_DIRECT_DEPTH, &params);
+	if(input->ring_fd < 0) {
+		return -1;
+	}
+
+	input->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	input->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	input->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	input->sq_ring = mmap(NULL, input->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						input->ring_fd, IORING_OFF_SQ_RING);
+	input->cq_ring = mmap(NULL, input->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						input->ring_fd, IORING_OFF_CQ_RING);
+	input->sqes = mmap(NULL, input->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						input->ring_fd, IORING_OFF_SQES);
+	if(input->sq_ring == MAP_FAILED || input->cq_ring == MAP_FAILED || input->sqes == MAP_FAILED) {
+		return -1;
+	}
+
+	sq = (char*)input->sq_ring;
+	cq = (char*)input->cq_ring;
+	input->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	input->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+	input->sq_array = (unsigned*)(sq + params.sq_off.array);
+	input->cq_head = (unsigned*)(cq + params.cq_off.head);
+	input->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+	input->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+	input->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	return 0;
+}
+
+/* Requests the next block into buffer. */
+static int submit(FlightDirect* input, DirectBuffer* buffer) {
+	unsigned tail = *input->sq_tail;
+	unsigned index = tail & *input->sq_mask;
+	struct io_uring_sqe* sqe = &input->sqes[index];
+	int rc = 0;
+
+	buffer->offset = input->next;
+	buffer->iov.iov_base = buffer->data;
+	buffer->iov.iov_len = FLIGHT_DIRECT_BLOCK;
+	buffer->state = BUFFER_READING;
+	input->next += FLIGHT_DIRECT_BLOCK;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = input->fd;
+	sqe->addr = (unsigned long)&buffer->iov;
+	sqe->len = 1;
+	sqe->off = buffer->offset;
+	sqe->user_data = (unsigned long)(buffer - input->buffers);
+	input->sq_array[index] = index;
+	__atomic_store_n(input->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	do {
+		rc = uring_enter(input->ring_fd, 1, 0, 0);
+	} while(rc < 0 && errno == EINTR);
+	if(rc < 0) {
+		fprintf(stderr, "Error: io_uring submit failed: %s\n", strerror(errno));
+		buffer->state = BUFFER_IDLE;
+		return -1;
+	}
+
+	input->in_flight++;
+	return 0;
+}
+
+/* Waits for at least one read to complete and marks every completed buffer ready. */
+static int reap(FlightDirect* input) {
+	unsigned head = *input->cq_head;
+	int rc = 0;
+
+	if(head == __atomic_load_n(input->cq_tail, __ATOMIC_ACQUIRE)) {
+		do {
+			rc = uring_enter(input->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+		} while(rc < 0 && errno == EINTR);
+		if(rc < 0) {
+			fprintf(stderr, "Error: io_uring wait failed: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+
+	while(head != __atomic_load_n(input->cq_tail, __ATOMIC_ACQUIRE)) {
+		struct io_uring_cqe* cqe = &input->cqes[head & *input->cq_mask];
+		DirectBuffer* buffer = &input->buffers[cqe->user_data];
+
+		buffer->result = cqe->res;
+		buffer->state = BUFFER_READY;
+		input->in_flight--;
+		head++;
+	}
+	__atomic_store_n(input->cq_head, head, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static int drain(FlightDirect* input) {
+	while(input->in_flight > 0) {
+		if(reap(input) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int restart(FlightDirect* input, size_t offset) {
+	int i;
+
+	if(drain(input) != 0) {
+		return -1;
+	}
+
+	input->head = 0;
+	input->next = offset / DIRECT_ALIGN * DIRECT_ALIGN;
+	input->pos = offset - input->next;
+	for(i = 0; i < FLIGHT_DIRECT_DEPTH; ++i) {
+		input->buffers[i].state = BUFFER_IDLE;
+	}
+	for(i = 0; i < FLIGHT_DIRECT_DEPTH && input->next < input->size; ++i) {
+		if(submit(input, &input->buffers[i]) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+FlightDirect* flight_direct_open(const char* path, size_t offset, const char** error) {
+	FlightDirect* input = NULL;
+	struct stat st;
+	int i;
+
+	input = calloc(1, sizeof(FlightDirect));
+	if(input == NULL) {
+		*error = strerror(ENOMEM);
+		return NULL;
+	}
+	input->ring_fd = -1;
+
+	input->fd = open(path, O_RDONLY | O_DIRECT);
+	if(input->fd < 0 || fstat(input->fd, &st) != 0) {
+		*error = strerror(errno);
+		flight_direct_close(input);
+		return NULL;
+	}
+	input->size = (size_t)st.st_size;
+
+	for(i = 0; i < FLIGHT_DIRECT_DEPTH; ++i) {
+		if(posix_memalign((void**)&input->buffers[i].data, DIRECT_ALIGN, FLIGHT_DIRECT_BLOCK) != 0) {
+			*error = strerror(ENOMEM);
+			flight_direct_close(input);
+			return NULL;
+		}
+	}
+
+	if(map_ring(input) != 0) {
+		*error = strerror(errno);
+		flight_direct_close(input);
+		return NULL;
+	}
+
+	if(restart(input, offset) != 0) {
+		*error = "io_uring read failed";
+		flight_direct_close(input);
+		return NULL;
+	}
+
+	/* Some file systems accept O_DIRECT at open and only refuse the reads. */
+	while(input->buffers[0].state == BUFFER_READING) {
+		if(reap(input) != 0) {
+			*error = "io_uring read failed";
+			flight_direct_close(input);
+			return NULL;
+		}
+	}
+	if(input->buffers[0].state == BUFFER_READY && input->buffers[0].result < 0) {
+		*error = strerror((int)-input->buffers[0].result);
+		flight_direct_close(input);
+		return NULL;
+	}
+
+	return input;
+}
+
+ssize_t flight_direct_read(FlightDirect* input, char* buffer, size_t length) {
+	for(;;) {
+		DirectBuffer* current = &input->buffers[input->head];
+		size_t n = 0;
+
+		if(current->state == BUFFER_IDLE) {
+			return 0;
+		}
+		while(current->state == BUFFER_READING) {
+			if(reap(input) != 0) {
+				return -1;
+			}
+		}
+
+		if(current->result < 0) {
+			fprintf(stderr, "Error: read at offset %lu failed: %s\n",
+				(unsigned long)current->offset, strerror((int)-current->result));
+			return -1;
+		}
+
+		if(input->pos < (size_t)current->result) {
+			n = (size_t)current->result - input->pos;
+			n = n < length ? n : length;
+			memcpy(buffer, current->data + input->pos, n);
+			input->pos += n;
+			return (ssize_t)n;
+		}
+
+		if((size_t)current->result < FLIGHT_DIRECT_BLOCK &&
+			current->offset + (size_t)current->result < input->size) {
+			fprintf(stderr, "Error: short read at offset %lu\n", (unsigned long)current->offset);
+			return -1;
+		}
+
+		/* Used up; it goes to the back of the queue. */
+		current->state = BUFFER_IDLE;
+		input->pos = 0;
+		input->head = (input->head + 1) % FLIGHT_DIRECT_DEPTH;
+		if(input->next < input->size && submit(input, current) != 0) {
+			return -1;
+		}
+	}
+}
+
+int flight_direct_seek(FlightDirect* input, size_t offset) {
+	return restart(input, offset);
+}
+
+void flight_direct_close(FlightDirect* input) {
+	int i;
+
+	if(input == NULL) {
+		return;
+	}
+
+	/* The kernel may still be writing into the buffers. */
+	if(input->ring_fd >= 0) {
+		drain(input);
+	}
+
+	if(input->sqes != NULL && input->sqes != MAP_FAILED) {
+		munmap(input->sqes, input->sqes_size);
+	}
+	if(input->cq_ring != NULL && input->cq_ring != MAP_FAILED) {
+		munmap(input->cq_ring, input->cq_ring_size);
+	}
+	if(input->sq_ring != NULL && input->sq_ring != MAP_FAILED) {
+		munmap(input->sq_ring, input->sq_ring_size);
+	}
+	if(input->ring_fd >= 0) {
+		close(input->ring_fd);
+	}
+	for(i = 0; i < FLIGHT_DIRECT_DEPTH; ++i) {
+		free(input->buffers[i].data);
+	}
+	if(input->fd >= 0) {
+		close(input->fd);
+	}
+	free(input);
+}
+
+#else
+
+struct FlightDirect_ {
+	int	unused;
+} ;
+
+FlightDirect* flight_direct_open(const char* path, size_t offset, const char** error) {
+	(void)path;
+	(void)offset;
+	*error = "io_uring is not available on this platform";
+	return NULL;
+}
+
+ssize_t flight_direct_read(FlightDirect* input, char* buffer, size_t length) {
+	(void)input;
+	(void)buffer;
+	(void)length;
+	return -1;
+}
+
+int flight_direct_seek(FlightDirect* input, size_t offset) {
+	(void)input;
+	(void)offset;
+	return -1;
+}
+
+void flight_direct_close(FlightDirect* input) {
+	(void)input;
+}
+
+#endif /* HAVE_IO_URING */
@@ -0,0 +1,56 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Read-ahead input that bypasses the page cache: the file is opened with
+  O_DIRECT and FLIGHT_DIRECT_DEPTH aligned reads of FLIGHT_DIRECT_BLOCK
+  bytes are kept in flight through io_uring. Each one is resubmitted for
+  the next block as soon as the reader has copied it out, so the device
+  stays busy while the caller parses, and a large extract does not evict
+  the pages of a Cassandra node on the same host.
+
+  io_uring is used through its system calls, so there is nothing extra to
+  link. Where it is missing (other platforms, old kernels, seccomp) or
+  the file system refuses O_DIRECT, flight_direct_open() fails and
+  flight_reader goes back to mapping the file.
+*/
+
+#ifndef FLIGHT_DIRECT_H
+#define FLIGHT_DIRECT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define FLIGHT_DIRECT_DEPTH 8
+#define FLIGHT_DIRECT_BLOCK (1024 * 1024)
+
+typedef struct FlightDirect_ FlightDirect;
+
+/*
+  Opens path and starts reading ahead from offset. Returns NULL, with the
+  reason in *error, if direct input is not available for it.
+*/
+FlightDirect* flight_direct_open(const char* path, size_t offset, const char** error);
+
+/* Copies up to length bytes into buffer, like read(). Returns 0 at end of file or -1. */
+ssize_t flight_direct_read(FlightDirect* input, char* buffer, size_t length);
+
+/* Restarts the read-ahead at offset. Returns 0 or -1. */
+int flight_direct_seek(FlightDirect* input, size_t offset);
+
+void flight_direct_close(FlightDirect* input);
+
+#endif /* FLIGHT_DIRECT_H */
@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flight_intern.h"
+
+/* Open addressing, kept at most half full. */
+#define INTERN_SLOTS (2 * FLIGHT_INTERN_MAX_STRINGS)
+
+#define ARENA_CHUNK_SIZE (16 * 1024)
+
+/* Longer strings are not worth interning; they would not be repeated. */
+#define INTERN_MAX_LENGTH 256
+
+struct ArenaChunk_ {
+	struct ArenaChunk_*	next;
+	size_t				used;
+	char				data[ARENA_CHUNK_SIZE];
+} ;
+
+typedef struct ArenaChunk_ ArenaChunk;
+
+struct FlightIntern_ {
+	ArenaChunk*		arena;			/* newest chunk first */
+	FlightString	strings[FLIGHT_INTERN_MAX_STRINGS];
+	unsigned		hashes[FLIGHT_INTERN_MAX_STRINGS];
+	short			slots[INTERN_SLOTS];	/* id + 1, 0 when empty */
+	int				count;
+} ;
+
+/*
+  The columns are short and mostly distinct in their first and last bytes,
+  so hashing the head and tail words is enough and much cheaper than a
+  byte at a time loop; full equality is checked with memcmp anyway.
+*/
+static unsigned hash_string(const char* data, size_t length) {
+	unsigned long long head = 0, tail = 0;
+	size_t n = length < 8 ? length : 8;
+
+	memcpy(&head, data, n);
+	memcpy(&tail, data + length - n, n);
+	head = (head ^ (tail * 0x9e3779b97f4a7c15ULL) ^ length) * 0xff51afd7ed558ccdULL;
+	return (unsigned)(head >> 32);
+}
+
+static const char* arena_copy(FlightIntern* table, const char* data, size_t length) {
+	ArenaChunk* chunk = table->arena;
+	char* copy = NULL;
+
+	if(chunk == NULL || chunk->used + length > ARENA_CHUNK_SIZE) {
+		chunk = malloc(sizeof(ArenaChunk));
+		if(chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = table->arena;
+		chunk->used = 0;
+		table->arena = chunk;
+	}
+
+	copy = chunk->data + chunk->used;
+	memcpy(copy, data, length);
+	chunk->used += length;
+	return copy;
+}
+
+FlightIntern* flight_intern_new() {
+	return calloc(1, sizeof(FlightIntern));
+}
+
+void flight_intern_free(FlightIntern* table) {
+	ArenaChunk* chunk = NULL;
+
+	if(table == NULL) {
+		return;
+	}
+
+	while((chunk = table->arena) != NULL) {
+		table->arena = chunk->next;
+		free(chunk);
+	}
+	free(table);
+}
+
+int flight_intern(FlightIntern* table, FlightString* string) {
+	unsigned hash = 0;
+	size_t slot = 0;
+	const char* copy = NULL;
+	int id = 0;
+
+	if(string->length > INTERN_MAX_LENGTH) {
+		return -1;
+	}
+
+	hash = hash_string(string->data, string->length);
+	for(slot = hash % INTERN_SLOTS; table->slots[slot] != 0; slot = (slot + 1) % INTERN_SLOTS) {
+		id = table->slots[slot] - 1;
+		if(table->hashes[id] == hash && table->strings[id].length == string->length &&
+			memcmp(table->strings[id].data, string->data, string->length) == 0) {
+			*string = table->strings[id];
+			return id;
+		}
+	}
+
+	if(table->count == FLIGHT_INTERN_MAX_STRINGS) {
+		return -1;
+	}
+	copy = arena_copy(table, string->data, string->length);
+	if(copy == NULL) {
+		return -1;
+	}
+
+	id = table->count++;
+	table->strings[id].data = copy;
+	table->strings[id].length = string->length;
+	table->hashes[id] = hash;
+	table->slots[slot] = (short)(id + 1);
+
+	*string = table->strings[id];
+	return id;
+}
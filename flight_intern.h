@@ -0,0 +1,52 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Interning table for the low cardinality string columns of Flight:
+  carrier, the airports and their cities and states. There are a few
+  dozen carriers and a few hundred airports, so each distinct value is
+  copied once into an append only arena and given a dense id. Arena
+  chunks never move, so an interned view stays valid, and its bytes stay
+  hot in cache, until the table is freed.
+
+  flight_reader keeps one table per reader; like the reader it is not
+  thread safe.
+*/
+
+#ifndef FLIGHT_INTERN_H
+#define FLIGHT_INTERN_H
+
+#include <stddef.h>
+
+#include "flight_reader.h"
+
+/* Distinct strings per table; later ones are left as they are. */
+#define FLIGHT_INTERN_MAX_STRINGS 4096
+
+typedef struct FlightIntern_ FlightIntern;
+
+FlightIntern* flight_intern_new();
+
+void flight_intern_free(FlightIntern* table);
+
+/*
+  Points string at the interned copy of its bytes, adding them if they are
+  new, and returns their id; ids are dense, in the order strings were
+  first seen. Returns -1 and leaves string alone if the table is full.
+*/
+int flight_intern(FlightIntern* table, FlightString* string);
+
+#endif /* FLIGHT_INTERN_H */
@@ -0,0 +1,367 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "flight_pipeline.h"
+
+/* Chunks in circulation per parser: one being parsed, one queued on each side. */
+#define CHUNKS_PER_PARSER 3
+
+/* A waiting stage yields this many times before it starts to sleep. */
+#define WAIT_SPINS 64
+#define WAIT_SLEEP_NS 20000
+
+/*
+  Single producer, single consumer ring of chunk pointers. NULL is pushed
+  to mark the end of input. head is only written by the consumer and tail
+  only by the producer, so they live on separate cache lines.
+*/
+struct ChunkRing_ {
+	FlightChunk**	slots;
+	unsigned		mask;
+	unsigned		head __attribute__((aligned(64)));
+	long			pop_waits;		/* consumer found the ring empty */
+	long long		depth_sum;
+	long			pops;
+	unsigned		tail __attribute__((aligned(64)));
+	long			push_waits;		/* producer found the ring full */
+} ;
+
+typedef struct ChunkRing_ ChunkRing;
+
+struct FlightPipeline_ {
+	int					num_parsers;
+	void*				source;
+	FlightChunkFill		fill;
+	FlightChunkParse	parse;
+
+	FlightChunk*		chunks;
+	int					num_chunks;
+	ChunkRing			free_chunks;	/* submitter to reader */
+	ChunkRing*			input;			/* reader to each parser */
+	ChunkRing*			parsed;			/* each parser to submitter */
+	int					next_parser;	/* submitter's position in the deal */
+	int					ended;
+
+	pthread_t			reader;
+	pthread_t*			parsers;
+	int					num_started;
+	volatile int		stopping;
+	volatile int		failed;
+} ;
+
+struct ParserThread_ {
+	FlightPipeline*	pipeline;
+	int				index;
+} ;
+
+typedef struct ParserThread_ ParserThread;
+
+/* Process totals, added by flight_pipeline_stop(). */
+static long total_pipelines = 0;
+static long total_parsers = 0;
+static long total_reader_waits = 0;
+static long total_input_waits = 0;
+static long total_room_waits = 0;
+static long total_submit_waits = 0;
+static long long total_input_depth = 0;
+static long total_input_pops = 0;
+static long long total_parsed_depth = 0;
+static long total_parsed_pops = 0;
+
+static int ring_init(ChunkRing* ring, int capacity) {
+	unsigned size = 1;
+
+	while(size < (unsigned)capacity) {
+		size *= 2;
+	}
+	memset(ring, 0, sizeof(ChunkRing));
+	ring->slots = calloc(size, sizeof(FlightChunk*));
+	ring->mask = size - 1;
+	return ring->slots != NULL ? 0 : -1;
+}
+
+static void ring_destroy(ChunkRing* ring) {
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+static void wait_a_little(int* spins) {
+	struct timespec ts = { 0, WAIT_SLEEP_NS };
+
+	if(++*spins < WAIT_SPINS) {
+		sched_yield();
+	} else {
+		nanosleep(&ts, NULL);
+	}
+}
+
+/* Returns 0, or -1 if the pipeline is stopping. */
+static int ring_push(FlightPipeline* pipeline, ChunkRing* ring, FlightChunk* chunk) {
+	unsigned tail = ring->tail;
+	int spins = 0;
+
+	if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask) {
+		ring->push_waits++;
+		while(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask) {
+			if(pipeline->stopping) {
+				return -1;
+			}
+			wait_a_little(&spins);
+		}
+	}
+
+	ring->slots[tail & ring->mask] = chunk;
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Returns 0 and sets *chunk, or -1 if the pipeline is stopping. */
+static int ring_pop(FlightPipeline* pipeline, ChunkRing* ring, FlightChunk** chunk) {
+	unsigned head = ring->head;
+	unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	int spins = 0;
+
+	if(tail == head) {
+		ring->pop_waits++;
+		while((tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) == head) {
+			if(pipeline->stopping) {
+				return -1;
+			}
+			wait_a_little(&spins);
+		}
+	}
+
+	ring->depth_sum += tail - head;
+	ring->pops++;
+	*chunk = ring->slots[head & ring->mask];
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void* run_reader(void* data) {
+	FlightPipeline* pipeline = (FlightPipeline*)data;
+	FlightChunk* chunk = NULL;
+	int parser = 0;
+	int i;
+
+	for(;;) {
+		int rc = 0;
+
+		if(ring_pop(pipeline, &pipeline->free_chunks, &chunk) != 0) {
+			return NULL;
+		}
+
+		chunk->num_rows = 0;
+		chunk->errors = 0;
+		rc = pipeline->fill(pipeline->source, chunk);
+		if(rc <= 0) {
+			pipeline->failed = rc < 0;
+			break;
+		}
+
+		if(ring_push(pipeline, &pipeline->input[parser], chunk) != 0) {
+			return NULL;
+		}
+		parser = (parser + 1) % pipeline->num_parsers;
+	}
+
+	/* Every parser gets the end marker, in turn, after its last chunk. */
+	for(i = 0; i < pipeline->num_parsers; ++i) {
+		if(ring_push(pipeline, &pipeline->input[(parser + i) % pipeline->num_parsers], NULL) != 0) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void* run_parser(void* data) {
+	ParserThread* thread = (ParserThread*)data;
+	FlightPipeline* pipeline = thread->pipeline;
+	int index = thread->index;
+	FlightChunk* chunk = NULL;
+
+	free(thread);
+
+	for(;;) {
+		if(ring_pop(pipeline, &pipeline->input[index], &chunk) != 0) {
+			return NULL;
+		}
+		if(chunk != NULL) {
+			pipeline->parse(chunk);
+		}
+		if(ring_push(pipeline, &pipeline->parsed[index], chunk) != 0 || chunk == NULL) {
+			return NULL;
+		}
+	}
+}
+
+FlightPipeline* flight_pipeline_start(int num_parsers, void* source, FlightChunkFill fill,
+										FlightChunkParse parse) {
+	FlightPipeline* pipeline = NULL;
+	int i;
+
+	if(num_parsers < 1) {
+		return NULL;
+	}
+
+	pipeline = calloc(1, sizeof(FlightPipeline));
+	if(pipeline == NULL) {
+		return NULL;
+	}
+	pipeline->num_parsers = num_parsers;
+	pipeline->source = source;
+	pipeline->fill = fill;
+	pipeline->parse = parse;
+	pipeline->num_chunks = num_parsers * CHUNKS_PER_PARSER + 1;
+	pipeline->chunks = calloc((size_t)pipeline->num_chunks, sizeof(FlightChunk));
+	pipeline->input = calloc((size_t)num_parsers, sizeof(ChunkRing));
+	pipeline->parsed = calloc((size_t)num_parsers, sizeof(ChunkRing));
+	pipeline->parsers = calloc((size_t)num_parsers, sizeof(pthread_t));
+	if(pipeline->chunks == NULL || pipeline->input == NULL || pipeline->parsed == NULL ||
+		pipeline->parsers == NULL || ring_init(&pipeline->free_chunks, pipeline->num_chunks) != 0) {
+		flight_pipeline_stop(pipeline);
+		return NULL;
+	}
+
+	/* One extra slot each for the end marker. */
+	for(i = 0; i < num_parsers; ++i) {
+		if(ring_init(&pipeline->input[i], CHUNKS_PER_PARSER + 1) != 0 ||
+			ring_init(&pipeline->parsed[i], CHUNKS_PER_PARSER + 1) != 0) {
+			flight_pipeline_stop(pipeline);
+			return NULL;
+		}
+	}
+	for(i = 0; i < pipeline->num_chunks; ++i) {
+		ring_push(pipeline, &pipeline->free_chunks, &pipeline->chunks[i]);
+	}
+
+	for(i = 0; i < num_parsers; ++i) {
+		ParserThread* thread = malloc(sizeof(ParserThread));
+
+		if(thread == NULL) {
+			break;
+		}
+		thread->pipeline = pipeline;
+		thread->index = i;
+		if(pthread_create(&pipeline->parsers[i], NULL, run_parser, thread) != 0) {
+			free(thread);
+			break;
+		}
+		pipeline->num_started++;
+	}
+	if(pipeline->num_started < num_parsers ||
+		pthread_create(&pipeline->reader, NULL, run_reader, pipeline) != 0) {
+		fprintf(stderr, "Error: unable to start the input pipeline threads\n");
+		flight_pipeline_stop(pipeline);
+		return NULL;
+	}
+	pipeline->num_started++;
+
+	return pipeline;
+}
+
+FlightChunk* flight_pipeline_next(FlightPipeline* pipeline, FlightChunk* done) {
+	FlightChunk* chunk = NULL;
+
+	if(done != NULL) {
+		ring_push(pipeline, &pipeline->free_chunks, done);
+	}
+	if(pipeline->ended) {
+		return NULL;
+	}
+
+	if(ring_pop(pipeline, &pipeline->parsed[pipeline->next_parser], &chunk) != 0 || chunk == NULL) {
+		pipeline->ended = 1;
+		return NULL;
+	}
+	pipeline->next_parser = (pipeline->next_parser + 1) % pipeline->num_parsers;
+	return chunk;
+}
+
+int flight_pipeline_failed(const FlightPipeline* pipeline) {
+	return pipeline->failed;
+}
+
+void flight_pipeline_stop(FlightPipeline* pipeline) {
+	int i;
+
+	if(pipeline == NULL) {
+		return;
+	}
+
+	pipeline->stopping = 1;
+	if(pipeline->num_started > pipeline->num_parsers) {
+		pthread_join(pipeline->reader, NULL);
+	}
+	for(i = 0; i < pipeline->num_started && i < pipeline->num_parsers; ++i) {
+		pthread_join(pipeline->parsers[i], NULL);
+	}
+
+	if(pipeline->num_started > pipeline->num_parsers) {
+		__sync_fetch_and_add(&total_pipelines, 1);
+		__sync_fetch_and_add(&total_parsers, pipeline->num_parsers);
+		__sync_fetch_and_add(&total_reader_waits, pipeline->free_chunks.pop_waits);
+		for(i = 0; i < pipeline->num_parsers; ++i) {
+			__sync_fetch_and_add(&total_input_waits, pipeline->input[i].pop_waits);
+			__sync_fetch_and_add(&total_room_waits, pipeline->parsed[i].push_waits);
+			__sync_fetch_and_add(&total_submit_waits, pipeline->parsed[i].pop_waits);
+			__sync_fetch_and_add(&total_input_depth, pipeline->input[i].depth_sum);
+			__sync_fetch_and_add(&total_input_pops, pipeline->input[i].pops);
+			__sync_fetch_and_add(&total_parsed_depth, pipeline->parsed[i].depth_sum);
+			__sync_fetch_and_add(&total_parsed_pops, pipeline->parsed[i].pops);
+		}
+	}
+
+	for(i = 0; i < pipeline->num_chunks; ++i) {
+		free(pipeline->chunks[i].buffer);
+		free(pipeline->chunks[i].rows);
+		free(pipeline->chunks[i].ends);
+	}
+	for(i = 0; pipeline->input != NULL && i < pipeline->num_parsers; ++i) {
+		ring_destroy(&pipeline->input[i]);
+	}
+	for(i = 0; pipeline->parsed != NULL && i < pipeline->num_parsers; ++i) {
+		ring_destroy(&pipeline->parsed[i]);
+	}
+	ring_destroy(&pipeline->free_chunks);
+	free(pipeline->chunks);
+	free(pipeline->input);
+	free(pipeline->parsed);
+	free(pipeline->parsers);
+	free(pipeline);
+}
+
+void flight_pipeline_report() {
+	if(total_pipelines == 0) {
+		return;
+	}
+
+	printf("Input pipeline: %ld readers, %ld parsers.\n", total_pipelines, total_parsers);
+	printf("  waits: reader for free chunks %ld, parsers for input %ld, parsers for room %ld, submitter for rows %ld\n",
+		total_reader_waits, total_input_waits, total_room_waits, total_submit_waits);
+	printf("  average queue depth: input %.2f, parsed %.2f (of %d chunks per parser)\n",
+		total_input_pops > 0 ? (double)total_input_depth / total_input_pops : 0.0,
+		total_parsed_pops > 0 ? (double)total_parsed_depth / total_parsed_pops : 0.0,
+		CHUNKS_PER_PARSER);
+}
@@ -0,0 +1,93 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Staged input for a flight_reader: a reader thread fills chunks of whole
+  lines, N parser threads turn them into rows, and the thread calling
+  flight_reader_next() (the loader's submitter) takes the parsed chunks
+  back in file order. Reading, parsing and the loader's network waits
+  then overlap instead of running one after another.
+
+  Stages are connected by single producer, single consumer lock free
+  rings. The reader deals chunks to the parsers round robin and the
+  submitter collects them in the same order, so every ring has exactly
+  one producer and one consumer. A fixed set of chunks circulates back to
+  the reader through a ring of its own, which bounds memory.
+
+  Each stage counts the times it found its ring empty or full and the
+  average depth of the rings, which shows the saturated stage: the one
+  after the fullest ring is the slowest.
+
+  Binding has no stage of its own; the submitter binds each row as it
+  takes it. Bound statements come from the loader's FlightBinder pool and
+  may only be rebound once their request has completed, which only the
+  submitter sees. A binder thread would need every statement handed back
+  across another ring, for work that is small next to parsing. The time
+  spent binding still shows as its own stage in load_stats.
+*/
+
+#ifndef FLIGHT_PIPELINE_H
+#define FLIGHT_PIPELINE_H
+
+#include <stddef.h>
+
+#include "flight_reader.h"
+
+/* A run of whole lines and, once parsed, its rows. */
+struct FlightChunk_ {
+	char*		buffer;			/* owned storage for streamed input */
+	size_t		capacity;
+	const char*	data;			/* the lines, in buffer or in a mapping */
+	size_t		length;
+	size_t		offset;			/* file offset of data[0] */
+
+	Flight*		rows;
+	size_t*		ends;			/* file offset just past each row */
+	int			num_rows;
+	int			rows_capacity;
+	size_t		errors;			/* malformed lines skipped */
+} ;
+
+typedef struct FlightChunk_ FlightChunk;
+
+/* Fills chunk with the next lines of source. Returns 1, 0 at end of input, or -1. */
+typedef int (*FlightChunkFill)(void* source, FlightChunk* chunk);
+
+/* Parses chunk->data into chunk->rows; called on a parser thread. */
+typedef void (*FlightChunkParse)(FlightChunk* chunk);
+
+typedef struct FlightPipeline_ FlightPipeline;
+
+/* Starts the reader and num_parsers parser threads. Returns NULL if they cannot be started. */
+FlightPipeline* flight_pipeline_start(int num_parsers, void* source, FlightChunkFill fill,
+										FlightChunkParse parse);
+
+/*
+  Hands back done, the chunk the caller has finished with (or NULL), and
+  waits for the next parsed chunk. Returns NULL at end of input.
+*/
+FlightChunk* flight_pipeline_next(FlightPipeline* pipeline, FlightChunk* done);
+
+/* True if the reader stage hit a read error. */
+int flight_pipeline_failed(const FlightPipeline* pipeline);
+
+/* Stops the threads, even before the end of input, and adds the counters to the process totals. */
+void flight_pipeline_stop(FlightPipeline* pipeline);
+
+/* Prints the stage waits and queue depths of all stopped pipelines, if any ran. */
+void flight_pipeline_report();
+
+#endif /* FLIGHT_PIPELINE_H */
@@ -0,0 +1,784 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_scan.h"
+#include "flight_binary.h"
+#include "flight_decompress.h"
+#include "flight_direct.h"
+#include "flight_intern.h"
+#include "flight_pipeline.h"
+#include "flight_reader.h"
+
+#define STREAM_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Lines handed to a pipeline parser at a time. */
+#define PIPELINE_CHUNK_SIZE (256 * 1024)
+
+struct FlightReader_ {
+	int			fd;
+	int			mapped;
+	char*		data;		/* mapping, or the stream buffer */
+	size_t		size;		/* bytes of data that are valid */
+	size_t		capacity;	/* stream buffer size */
+	size_t		pos;		/* start of the next line within data */
+	size_t		base;		/* file offset of data[0] when streamed */
+	size_t		stop;		/* rows starting at or after this belong to the next part */
+	FlightBinaryFile binary;	/* binary.block_size is 0 for CSV */
+	FlightIntern* intern;	/* streamed CSV only, used by the caller's thread; NULL if it could not be allocated */
+	FlightDirect* direct;	/* streams a regular file with flight_reader_set_direct() */
+	FlightDecompress* decompress;	/* gzip or zstd input */
+	int			eof;
+	size_t		line;
+	size_t		errors;
+
+	/* With flight_reader_set_parsers(); the fields above then belong to the pipeline's reader thread. */
+	int				num_parsers;
+	FlightPipeline*	pipeline;		/* started by the first flight_reader_next() */
+	FlightChunk*	chunk;
+	int				chunk_row;
+	size_t			consumed;		/* file offset past the last row returned */
+} ;
+
+static int pipeline_parsers = 0;
+static int direct_input = 0;
+static int direct_warned = 0;
+
+void flight_reader_set_parsers(int num_parsers) {
+	pipeline_parsers = num_parsers > 0 ? num_parsers : 0;
+}
+
+void flight_reader_set_direct(int direct) {
+	direct_input = direct;
+}
+
+/* FLIGHT_SCHEMA expansions for parse_fields(). */
+#define PARSE_INT(name, csv) \
+	if(csv_decode_int(field[csv].data, field[csv].length, limit, &flight->name) != 0) { \
+		return -1; \
+	}
+#define PARSE_TEXT(name, csv, ...) flight->name = field[csv];
+
+/*
+  Fills flight from a record whose commas have already been located by
+  csv_scan_record(). Leading and trailing blanks are dropped from every
+  column, matching the ", " separators the fscanf format used to accept.
+  limit is the end of the readable buffer, which lets csv_decode_int() use
+  its 8 byte fast path on columns near the end of a line.
+*/
+static int parse_fields(const char* line, const char* end, const char** commas,
+						size_t num_commas, const char* limit, Flight* flight) {
+	FlightString field[FLIGHT_CSV_COLUMNS];
+	const char* start = line;
+	size_t i;
+
+	if(num_commas != FLIGHT_CSV_COLUMNS - 1) {
+		return -1;
+	}
+
+	for(i = 0; i < FLIGHT_CSV_COLUMNS; ++i) {
+		const char* stop = i < FLIGHT_CSV_COLUMNS - 1 ? commas[i] : end;
+
+		while(start < stop && (*start == ' ' || *start == '\t')) {
+			start++;
+		}
+		while(stop > start && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r')) {
+			stop--;
+		}
+		field[i].data = start;
+		field[i].length = (size_t)(stop - start);
+
+		if(i < FLIGHT_CSV_COLUMNS - 1) {
+			start = commas[i] + 1;
+		}
+	}
+
+	FLIGHT_SCHEMA(PARSE_INT, PARSE_TEXT, FLIGHT_SCHEMA_SKIP)
+	flight->stable = 0;
+
+	return 0;
+}
+
+int flight_parse_line(const char* line, const char* end, Flight* flight) {
+	const char* commas[FLIGHT_CSV_COLUMNS - 1];
+	const char* record_end = NULL;
+	size_t num_commas = csv_scan_record(line, end, commas, FLIGHT_CSV_COLUMNS - 1, &record_end);
+
+	return parse_fields(line, record_end, commas, num_commas, end, flight);
+}
+
+/* Interns the TEXT columns flight_schema.h marks as interned. */
+#define INTERN_TEXT(name, csv, interned) \
+	if(interned && flight_intern(table, &flight->name) >= 0) { \
+		flight->stable |= FLIGHT_STABLE(name); \
+	}
+
+/*
+  Marks which columns of a parsed row outlive the next read. A mapped
+  file stays put, so all of them do. A streamed buffer is reused, so the
+  low cardinality columns are moved into the reader's interning table,
+  where rows that are kept need not copy them and binding reads them from
+  a small, hot arena; only fl_date and anything that did not fit remain
+  to be copied.
+*/
+static void intern_columns(FlightReader* reader, Flight* flight) {
+	FlightIntern* table = reader->intern;
+
+	if(reader->mapped) {
+		flight->stable = FLIGHT_STABLE_ALL;
+		return;
+	}
+	if(table == NULL) {
+		return;
+	}
+
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, INTERN_TEXT, FLIGHT_SCHEMA_SKIP)
+}
+
+/* Reads the input as it is stored, possibly compressed. */
+static ssize_t read_raw(FlightReader* reader, char* buffer, size_t length) {
+	ssize_t n = 0;
+
+	if(reader->direct != NULL) {
+		return flight_direct_read(reader->direct, buffer, length);
+	}
+
+	do {
+		n = read(reader->fd, buffer, length);
+	} while(n < 0 && errno == EINTR);
+
+	if(n < 0) {
+		fprintf(stderr, "Error: read failed: %s\n", strerror(errno));
+	}
+	return n;
+}
+
+static ssize_t read_source(void* source, char* buffer, size_t length) {
+	return read_raw((FlightReader*)source, buffer, length);
+}
+
+static ssize_t read_input(FlightReader* reader, char* buffer, size_t length) {
+	if(reader->decompress != NULL) {
+		return flight_decompress_read(reader->decompress, buffer, length);
+	}
+	return read_raw(reader, buffer, length);
+}
+
+/*
+  Sets reader up to stream its input from base, and starts decompressing
+  it if its first bytes say it is compressed. Whatever was read to find
+  out is left in the stream buffer.
+*/
+static int start_stream(FlightReader* reader, size_t base, int sniff) {
+	int format = FLIGHT_DECOMPRESS_NONE;
+	ssize_t n = 0;
+
+	reader->mapped = 0;
+	reader->capacity = STREAM_BLOCK_SIZE;
+	reader->data = malloc(reader->capacity);
+	if(reader->data == NULL) {
+		return -1;
+	}
+	reader->base = base;
+	reader->consumed = base;
+	reader->intern = flight_intern_new();
+	reader->num_parsers = pipeline_parsers;
+
+	if(!sniff) {
+		return 0;
+	}
+
+	/* Pipes may hand over less than a magic number at a time. */
+	while(reader->size < 4 && !reader->eof) {
+		n = read_raw(reader, reader->data + reader->size, reader->capacity - reader->size);
+		if(n < 0) {
+			return -1;
+		}
+		reader->size += (size_t)n;
+		reader->eof = n == 0;
+	}
+
+	format = flight_decompress_detect(reader->data, reader->size);
+	if(format != FLIGHT_DECOMPRESS_NONE) {
+		reader->decompress = flight_decompress_start(format, read_source, reader, reader->data, reader->size);
+		if(reader->decompress == NULL) {
+			return -1;
+		}
+		reader->size = 0;
+		reader->eof = 0;
+	}
+
+	return 0;
+}
+
+/* Moves the unparsed tail of the stream buffer to the front and tops it up. */
+static int refill(FlightReader* reader) {
+	size_t remaining = reader->size - reader->pos;
+	ssize_t n = 0;
+
+	memmove(reader->data, reader->data + reader->pos, remaining);
+	reader->base += reader->pos;
+	reader->size = remaining;
+	reader->pos = 0;
+
+	if(reader->size == reader->capacity) {
+		/* A single line larger than the buffer; grow to hold it. */
+		char* data = realloc(reader->data, reader->capacity * 2);
+		if(data == NULL) {
+			return -1;
+		}
+		reader->data = data;
+		reader->capacity *= 2;
+	}
+
+	n = read_input(reader, reader->data + reader->size, reader->capacity - reader->size);
+	if(n < 0) {
+		return -1;
+	}
+	if(n == 0) {
+		reader->eof = 1;
+	}
+	reader->size += (size_t)n;
+
+	return 0;
+}
+
+FlightReader* flight_reader_open(const char* path) {
+	return flight_reader_open_part(path, 0, 1);
+}
+
+FlightReader* flight_reader_open_part(const char* path, int part, int num_parts) {
+	FlightReader* reader = NULL;
+	struct stat st;
+
+	reader = calloc(1, sizeof(FlightReader));
+	if(reader == NULL) {
+		return NULL;
+	}
+
+	reader->fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : open(path, O_RDONLY);
+	if(reader->fd < 0) {
+		fprintf(stderr, "Error: unable to open %s: %s\n", path, strerror(errno));
+		free(reader);
+		return NULL;
+	}
+	reader->stop = (size_t)-1;
+
+	if(fstat(reader->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+		if(data != MAP_FAILED) {
+			size_t size = (size_t)st.st_size;
+			size_t begin = size / (size_t)num_parts * (size_t)part;
+			size_t stop = part == num_parts - 1 ? size : size / (size_t)num_parts * (size_t)(part + 1);
+			int compressed = flight_decompress_detect(data, size) != FLIGHT_DECOMPRESS_NONE;
+			int binary = compressed ? 0 : flight_binary_check(data, size, &reader->binary);
+
+			if(binary < 0 || (compressed && num_parts > 1)) {
+				if(compressed) {
+					fprintf(stderr, "Error: %s is compressed and cannot be split; load it with a single thread\n", path);
+				}
+				munmap(data, size);
+				close(reader->fd);
+				free(reader);
+				return NULL;
+			}
+
+			if(binary) {
+				/* Parts are whole blocks of records; block 0 is the header and the dictionary follows them. */
+				size_t block_size = reader->binary.block_size;
+				size_t records_end = reader->binary.records_end;
+
+				begin = records_end / (size_t)num_parts * (size_t)part;
+				stop = part == num_parts - 1 ? records_end : records_end / (size_t)num_parts * (size_t)(part + 1);
+				begin = begin < block_size ? block_size : (begin + block_size - 1) / block_size * block_size;
+				stop = (stop + block_size - 1) / block_size * block_size;
+				if(begin > records_end) {
+					begin = records_end;
+				}
+				if(stop > records_end) {
+					stop = records_end;
+				}
+			} else if(begin > 0) {
+				/* A line that straddles begin belongs to the previous part. */
+				const char* newline = memchr((char*)data + begin - 1, '\n', size - begin + 1);
+				begin = newline != NULL ? (size_t)(newline - (char*)data) + 1 : size;
+			}
+
+			if(!binary && direct_input) {
+				const char* error = NULL;
+
+				reader->direct = flight_direct_open(path, begin, &error);
+				if(reader->direct == NULL && !__sync_lock_test_and_set(&direct_warned, 1)) {
+					fprintf(stderr, "Direct input is not available for %s (%s); reading through the page cache.\n",
+						path, error);
+				}
+			}
+
+			if(reader->direct != NULL || compressed) {
+				/* Streamed from here on; the mapping was only needed to find the part. */
+				munmap(data, size);
+				reader->stop = compressed ? (size_t)-1 : stop;
+				if(start_stream(reader, begin, compressed) != 0) {
+					flight_reader_close(reader);
+					return NULL;
+				}
+				return reader;
+			}
+
+			madvise((char*)data + begin, size - begin, MADV_SEQUENTIAL);
+			reader->data = data;
+			reader->size = size;
+			reader->pos = begin;
+			reader->stop = stop;
+			reader->mapped = 1;
+			reader->eof = 1;
+			reader->num_parsers = binary ? 0 : pipeline_parsers;
+			reader->consumed = begin;
+			return reader;
+		}
+	}
+
+	if(num_parts > 1) {
+		fprintf(stderr, "Error: %s cannot be split; only regular files can be read by several threads\n", path);
+		close(reader->fd);
+		free(reader);
+		return NULL;
+	}
+
+	if(start_stream(reader, 0, 1) != 0) {
+		flight_reader_close(reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+/* flight_reader_next() for flight_binary files, which are always mapped. */
+static int next_record(FlightReader* reader, Flight* flight) {
+	while(reader->pos < reader->stop && reader->pos < reader->size) {
+		size_t block_end = (reader->pos / reader->binary.block_size + 1) * reader->binary.block_size;
+		int length = 0;
+
+		if(block_end > reader->size) {
+			block_end = reader->size;
+		}
+
+		length = flight_binary_decode(&reader->binary, reader->data + reader->pos, block_end - reader->pos, flight);
+		if(length > 0) {
+			reader->pos += (size_t)length;
+			reader->line++;
+			flight->stable = FLIGHT_STABLE_ALL;
+			return 1;
+		}
+
+		if(length < 0) {
+			/* Records carry no marker to resynchronize on, so the rest of the block is lost. */
+			reader->errors++;
+			fprintf(stderr, "Error: skipping malformed record at offset %lu and the rest of its block\n",
+				(unsigned long)reader->pos);
+		}
+		reader->pos = block_end;
+	}
+
+	return 0;
+}
+
+/*
+  Pipeline reader stage. A mapped part is cut into runs of whole lines in
+  place, ending where the next part begins. Streamed input is read into
+  the chunk's own buffer, and the partial line at its end is carried over
+  to the next chunk through the reader's stream buffer.
+*/
+static int fill_chunk(void* source, FlightChunk* chunk) {
+	FlightReader* reader = (FlightReader*)source;
+	size_t length = 0;
+	ssize_t n = 0;
+
+	if(reader->mapped) {
+		size_t end = reader->pos + PIPELINE_CHUNK_SIZE;
+
+		if(reader->pos >= reader->stop || reader->pos >= reader->size) {
+			return 0;
+		}
+		if(end > reader->stop) {
+			end = reader->stop;
+		}
+		if(end < reader->size) {
+			const char* newline = memchr(reader->data + end - 1, '\n', reader->size - end + 1);
+			end = newline != NULL ? (size_t)(newline - reader->data) + 1 : reader->size;
+		} else {
+			end = reader->size;
+		}
+
+		chunk->data = reader->data + reader->pos;
+		chunk->length = end - reader->pos;
+		chunk->offset = reader->pos;
+		reader->pos = end;
+		return 1;
+	}
+
+	if(reader->base >= reader->stop) {
+		return 0;
+	}
+	if(chunk->buffer == NULL) {
+		chunk->buffer = malloc(PIPELINE_CHUNK_SIZE);
+		chunk->capacity = PIPELINE_CHUNK_SIZE;
+		if(chunk->buffer == NULL) {
+			return -1;
+		}
+	}
+
+	/* reader->data holds the carried over partial line. */
+	for(;;) {
+		char* newline = NULL;
+
+		if(reader->size >= chunk->capacity) {
+			char* buffer = realloc(chunk->buffer, reader->size * 2);
+			if(buffer == NULL) {
+				return -1;
+			}
+			chunk->buffer = buffer;
+			chunk->capacity = reader->size * 2;
+		}
+		memcpy(chunk->buffer, reader->data, reader->size);
+		length = reader->size;
+		reader->size = 0;
+
+		while(!reader->eof && length < chunk->capacity) {
+			n = read_input(reader, chunk->buffer + length, chunk->capacity - length);
+			if(n < 0) {
+				return -1;
+			}
+			if(n == 0) {
+				reader->eof = 1;
+			}
+			length += (size_t)n;
+		}
+
+		if(reader->eof) {
+			break;
+		}
+
+		for(newline = chunk->buffer + length; newline > chunk->buffer && newline[-1] != '\n'; newline--) {
+		}
+		if(newline > chunk->buffer) {
+			newline--;
+			size_t tail = length - (size_t)(newline + 1 - chunk->buffer);
+
+			if(tail > reader->capacity) {
+				return -1;
+			}
+			memcpy(reader->data, newline + 1, tail);
+			reader->size = tail;
+			length -= tail;
+			break;
+		}
+
+		/* A single line longer than the chunk; keep it and read on into a bigger buffer. */
+		if(length > reader->capacity) {
+			char* data = realloc(reader->data, length);
+			if(data == NULL) {
+				return -1;
+			}
+			reader->data = data;
+			reader->capacity = length;
+		}
+		memcpy(reader->data, chunk->buffer, length);
+		reader->size = length;
+	}
+
+	if(length == 0) {
+		return 0;
+	}
+	if(reader->base + length > reader->stop) {
+		/* A direct part ends with the line that straddles stop. */
+		size_t cut = reader->stop - reader->base;
+		const char* newline = memchr(chunk->buffer + cut - 1, '\n', length - cut + 1);
+		if(newline != NULL) {
+			length = (size_t)(newline + 1 - chunk->buffer);
+		}
+	}
+	chunk->data = chunk->buffer;
+	chunk->length = length;
+	chunk->offset = reader->base;
+	reader->base += length;
+	return 1;
+}
+
+/* Pipeline parser stage, the chunk version of flight_reader_next(). */
+static void parse_chunk(FlightChunk* chunk) {
+	const char* commas[FLIGHT_CSV_COLUMNS - 1];
+	const char* line = chunk->data;
+	const char* limit = chunk->data + chunk->length;
+
+	while(line < limit) {
+		const char* end = NULL;
+		size_t num_commas = csv_scan_record(line, limit, commas, FLIGHT_CSV_COLUMNS - 1, &end);
+		const char* next = end < limit ? end + 1 : limit;
+		Flight* flight = NULL;
+
+		if(end == line || (end == line + 1 && *line == '\r')) {
+			line = next;
+			continue;
+		}
+
+		if(chunk->num_rows == chunk->rows_capacity) {
+			int capacity = chunk->rows_capacity > 0 ? chunk->rows_capacity * 2 : 1024;
+			Flight* rows = realloc(chunk->rows, (size_t)capacity * sizeof(Flight));
+			size_t* ends = NULL;
+
+			if(rows != NULL) {
+				chunk->rows = rows;
+				ends = realloc(chunk->ends, (size_t)capacity * sizeof(size_t));
+			}
+			if(ends == NULL) {
+				fprintf(stderr, "Error: out of memory parsing offset %lu\n", (unsigned long)chunk->offset);
+				chunk->errors++;
+				return;
+			}
+			chunk->ends = ends;
+			chunk->rows_capacity = capacity;
+		}
+
+		flight = &chunk->rows[chunk->num_rows];
+		if(parse_fields(line, end, commas, num_commas, limit, flight) == 0) {
+			/*
+			  Rows in a mapping outlive the chunk; rows in a chunk buffer do not,
+			  and are interned by next_pipelined() as they are handed out.
+			*/
+			flight->stable = chunk->buffer == NULL ? FLIGHT_STABLE_ALL : 0;
+			chunk->ends[chunk->num_rows++] = chunk->offset + (size_t)(next - chunk->data);
+		} else {
+			chunk->errors++;
+			fprintf(stderr, "Error: skipping malformed line at offset %lu: %.*s\n",
+				(unsigned long)(chunk->offset + (size_t)(line - chunk->data)), (int)(end - line), line);
+		}
+		line = next;
+	}
+}
+
+static int next_pipelined(FlightReader* reader, Flight* flight) {
+	for(;;) {
+		if(reader->chunk != NULL && reader->chunk_row < reader->chunk->num_rows) {
+			*flight = reader->chunk->rows[reader->chunk_row];
+			reader->consumed = reader->chunk->ends[reader->chunk_row++];
+			/* The table is the caller's alone; the reader and parser threads never touch it. */
+			if(flight->stable != FLIGHT_STABLE_ALL) {
+				intern_columns(reader, flight);
+			}
+			return 1;
+		}
+
+		if(reader->pipeline == NULL) {
+			if(reader->chunk_row < 0) {
+				return 0;
+			}
+			reader->pipeline = flight_pipeline_start(reader->num_parsers, reader, fill_chunk, parse_chunk);
+			if(reader->pipeline == NULL) {
+				reader->chunk_row = -1;
+				return 0;
+			}
+		}
+
+		reader->chunk = flight_pipeline_next(reader->pipeline, reader->chunk);
+		reader->chunk_row = 0;
+		if(reader->chunk == NULL) {
+			if(flight_pipeline_failed(reader->pipeline)) {
+				reader->errors++;
+			}
+			return 0;
+		}
+		reader->errors += reader->chunk->errors;
+	}
+}
+
+int flight_reader_next(FlightReader* reader, Flight* flight) {
+	const char* commas[FLIGHT_CSV_COLUMNS - 1];
+
+	if(reader->binary.block_size > 0) {
+		return next_record(reader, flight);
+	}
+	if(reader->num_parsers > 0) {
+		return next_pipelined(reader, flight);
+	}
+
+	for(;;) {
+		const char* line = reader->data + reader->pos;
+		const char* limit = reader->data + reader->size;
+		const char* end = NULL;
+		size_t num_commas = 0;
+
+		if(reader->base + reader->pos >= reader->stop) {
+			return 0;
+		}
+
+		num_commas = csv_scan_record(line, limit, commas, FLIGHT_CSV_COLUMNS - 1, &end);
+
+		if(end == limit) {
+			if(!reader->eof) {
+				if(refill(reader) != 0) {
+					return 0;
+				}
+				continue;
+			}
+			if(line == limit) {
+				return 0;
+			}
+			/* Last line without a trailing newline. */
+			reader->pos = reader->size;
+		} else {
+			reader->pos = (size_t)(end - reader->data) + 1;
+		}
+
+		reader->line++;
+		if(end == line || (end == line + 1 && *line == '\r')) {
+			continue;
+		}
+
+		if(parse_fields(line, end, commas, num_commas, limit, flight) == 0) {
+			intern_columns(reader, flight);
+			return 1;
+		}
+
+		reader->errors++;
+		fprintf(stderr, "Error: skipping malformed line %lu: %.*s\n",
+			(unsigned long)reader->line, (int)(end - line), line);
+	}
+}
+
+static void copy_string(FlightString* dst, const FlightString* src, char** storage) {
+	memcpy(*storage, src->data, src->length);
+	dst->data = *storage;
+	dst->length = src->length;
+	*storage += src->length;
+}
+
+#define ROW_SOURCE(name, ...) &flight->name,
+#define ROW_DESTINATION(name, ...) &row->flight.name,
+
+int flight_row_copy(FlightRow* row, const Flight* flight) {
+	const FlightString* src[] = { FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, ROW_SOURCE, FLIGHT_SCHEMA_SKIP) };
+	FlightString* dst[] = { FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, ROW_DESTINATION, FLIGHT_SCHEMA_SKIP) };
+	int num_strings = (int)(sizeof(src) / sizeof(src[0]));
+	char* storage = row->storage;
+	size_t length = 0;
+	int i;
+
+	/* Bit i of stable is string column i, in the order of the schema. */
+	for(i = 0; i < num_strings; ++i) {
+		if(!(flight->stable & (1u << i))) {
+			length += src[i]->length;
+		}
+	}
+	if(length > FLIGHT_ROW_STORAGE) {
+		return -1;
+	}
+
+	row->flight = *flight;
+	for(i = 0; i < num_strings; ++i) {
+		if(!(flight->stable & (1u << i))) {
+			copy_string(dst[i], src[i], &storage);
+		}
+	}
+
+	return 0;
+}
+
+size_t flight_reader_offset(const FlightReader* reader) {
+	if(reader->num_parsers > 0) {
+		return reader->consumed;
+	}
+	return reader->base + reader->pos;
+}
+
+int flight_reader_seek(FlightReader* reader, size_t offset) {
+	if(offset <= flight_reader_offset(reader)) {
+		return 0;
+	}
+	if(reader->pipeline != NULL) {
+		fprintf(stderr, "Error: a pipelined reader can only seek before its first row\n");
+		return -1;
+	}
+	reader->consumed = offset;
+
+	if(reader->mapped) {
+		if(offset > reader->size) {
+			fprintf(stderr, "Error: offset %lu is past the end of the input\n", (unsigned long)offset);
+			return -1;
+		}
+		reader->pos = offset;
+		return 0;
+	}
+
+	if(reader->direct != NULL && reader->decompress == NULL) {
+		if(flight_direct_seek(reader->direct, offset) != 0) {
+			return -1;
+		}
+		reader->base = offset;
+		reader->size = 0;
+		reader->pos = 0;
+		reader->eof = 0;
+		return 0;
+	}
+
+	/* Pipes and compressed input can only skip ahead by reading. */
+	while(reader->base + reader->size < offset) {
+		if(reader->eof) {
+			fprintf(stderr, "Error: offset %lu is past the end of the input\n", (unsigned long)offset);
+			return -1;
+		}
+		reader->pos = reader->size;
+		if(refill(reader) != 0) {
+			return -1;
+		}
+	}
+	reader->pos = offset - reader->base;
+	if(refill(reader) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+size_t flight_reader_errors(const FlightReader* reader) {
+	return reader->errors;
+}
+
+void flight_reader_close(FlightReader* reader) {
+	if(reader == NULL) {
+		return;
+	}
+
+	flight_pipeline_stop(reader->pipeline);
+	flight_decompress_stop(reader->decompress);
+	if(reader->mapped) {
+		munmap(reader->data, reader->size);
+	} else {
+		free(reader->data);
+	}
+	flight_intern_free(reader->intern);
+	flight_binary_release(&reader->binary);
+	flight_direct_close(reader->direct);
+	close(reader->fd);
+	free(reader);
+}
@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Zero-copy reader for flights_from_pg.csv shared by all of the loaders.
+
+  Regular files are memory mapped and parsed in place; anything that cannot
+  be mapped (pipes, character devices, and "-" for stdin) is streamed
+  through a large block buffer instead. gzip and zstd input, file or
+  pipe, is recognized by its magic number and decompressed on a thread of
+  its own (see flight_decompress.h). A mapped file in the binary format
+  of flight_binary.h is recognized by its header and read without any
+  parsing. CSV can also be parsed ahead of the caller on threads of its
+  own, see flight_reader_set_parsers(). Each loader is built together with
+  this file, flight_binary.c, flight_intern.c, flight_pipeline.c,
+  flight_direct.c, flight_decompress.c, flight_schema.c and csv_scan.c, e.g.
+
+    cc "Prepared SQL Inserts.c" flight_reader.c flight_binary.c flight_intern.c flight_pipeline.c csv_scan.c \
+       flight_direct.c flight_decompress.c load_parts.c load_rollup.c load_options.c load_cluster.c flight_binder.c \
+       flight_schema.c load_stats.c latency_histogram.c load_checkpoint.c -lcassandra -lz -lzstd -lpthread
+
+  The async and batch loaders need a few more; their build lines are at the
+  top of their files.
+*/
+
+#ifndef FLIGHT_READER_H
+#define FLIGHT_READER_H
+
+#include <stddef.h>
+
+#include "flight_schema.h"
+
+/* Room for the unstable string columns of one row; real rows use well under half. */
+#define FLIGHT_ROW_STORAGE 128
+
+/*
+  A Flight that owns its unstable strings, for rows that must outlive the
+  reader's buffer (e.g. while they wait in a batch). Stable columns are not
+  copied, so a FlightRow must not outlive the reader it came from. The
+  other views point into storage, so a FlightRow must be filled with
+  flight_row_copy() and never copied by assignment.
+*/
+struct FlightRow_ {
+	Flight		flight;
+	char		storage[FLIGHT_ROW_STORAGE];
+} ;
+
+typedef struct FlightRow_ FlightRow;
+
+/* Returns -1 if the unstable strings of flight do not fit in FLIGHT_ROW_STORAGE. */
+int flight_row_copy(FlightRow* row, const Flight* flight);
+
+typedef struct FlightReader_ FlightReader;
+
+/*
+  Makes CSV readers opened from now on parse through a flight_pipeline
+  with num_parsers parser threads, or directly when it is 0 (the default).
+  Streamed rows are interned as flight_reader_next() returns them, so
+  they are kept as cheaply as without the pipeline.
+*/
+void flight_reader_set_parsers(int num_parsers);
+
+/*
+  Makes CSV readers opened from now on stream regular files with O_DIRECT
+  read-ahead (see flight_direct.h) instead of mapping them, keeping the
+  input out of the page cache. Falls back to the mapping, with a note on
+  stderr, where direct input is not available.
+*/
+void flight_reader_set_direct(int direct);
+
+/* Returns NULL if the file cannot be opened. */
+FlightReader* flight_reader_open(const char* path);
+
+/*
+  Opens one of num_parts byte ranges of equal size, moved to line (or, for
+  binary files, block) boundaries so that every row belongs to exactly one
+  part. Splitting requires an uncompressed regular file; pipes and
+  compressed files can only be opened as a single part.
+*/
+FlightReader* flight_reader_open_part(const char* path, int part, int num_parts);
+
+/*
+  Parses the next row into flight. Returns 1 for a row and 0 at end of
+  input. Malformed lines are reported on stderr, counted and skipped.
+*/
+int flight_reader_next(FlightReader* reader, Flight* flight);
+
+/*
+  File offset just past the last row returned, i.e. where the next line
+  or record starts. Every row before it has been handed to the caller.
+*/
+size_t flight_reader_offset(const FlightReader* reader);
+
+/*
+  Skips ahead to offset, which must be the start of a row, e.g. one
+  returned by flight_reader_offset() in an earlier run. Offsets at or
+  before the current position are ignored. Returns 0 or -1 if the input
+  cannot seek there, or if a pipelined reader has already returned rows.
+*/
+int flight_reader_seek(FlightReader* reader, size_t offset);
+
+/* Number of malformed lines skipped so far. */
+size_t flight_reader_errors(const FlightReader* reader);
+
+void flight_reader_close(FlightReader* reader);
+
+/*
+  Parses a single line, without its terminating newline, into flight.
+  Returns 0 on success and -1 if the line does not have the
+  FLIGHT_CSV_COLUMNS columns of the flights schema.
+*/
+int flight_parse_line(const char* line, const char* end, Flight* flight);
+
+#endif /* FLIGHT_READER_H */
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "flight_schema.h"
+
+/* A query written into a caller's buffer; length keeps counting past size. */
+struct QueryText_ {
+	char*		data;
+	size_t		size;
+	size_t		length;
+} ;
+
+typedef struct QueryText_ QueryText;
+
+static void append(QueryText* text, const char* format, ...) {
+	va_list args;
+	int n = 0;
+
+	va_start(args, format);
+	n = vsnprintf(text->data + (text->length < text->size ? text->length : text->size),
+		text->length < text->size ? text->size - text->length : 0, format, args);
+	va_end(args);
+	text->length += n > 0 ? (size_t)n : 0;
+}
+
+static int finish(const QueryText* text, const char* table) {
+	if(text->length >= text->size) {
+		fprintf(stderr, "Error: a query of %s does not fit in %lu bytes\n", table, (unsigned long)text->size);
+		return -1;
+	}
+	return 0;
+}
+
+/* FLIGHT_SCHEMA expansions; the first column has no separator before it. */
+#define NAME(name, ...) append(&text, "%s" #name, FLIGHT_COLUMN_##name > 0 ? ", " : "");
+#define MARKER(name, ...) append(&text, "%s?", FLIGHT_COLUMN_##name > 0 ? "," : "");
+#define INT_VALUE(name, ...) append(&text, "%s%d", FLIGHT_COLUMN_##name > 0 ? ", " : "", flight->name);
+#define TEXT_VALUE(name, ...) \
+	append(&text, "%s'%.*s'", FLIGHT_COLUMN_##name > 0 ? ", " : "", (int)flight->name.length, flight->name.data);
+#define DERIVED_VALUE(name, value) append(&text, "%s%d", FLIGHT_COLUMN_##name > 0 ? ", " : "", (value));
+
+int flight_schema_insert(char* query, size_t size, const char* table) {
+	QueryText text = { query, size, 0 };
+
+	append(&text, "INSERT INTO %s (", table);
+	FLIGHT_SCHEMA(NAME, NAME, NAME)
+	append(&text, ") VALUES (");
+	FLIGHT_SCHEMA(MARKER, MARKER, MARKER)
+	append(&text, ");");
+	return finish(&text, table);
+}
+
+int flight_schema_insert_values(char* query, size_t size, const char* table, const Flight* flight) {
+	QueryText text = { query, size, 0 };
+
+	append(&text, "INSERT INTO %s (", table);
+	FLIGHT_SCHEMA(NAME, NAME, NAME)
+	append(&text, ") VALUES (");
+	FLIGHT_SCHEMA(INT_VALUE, TEXT_VALUE, DERIVED_VALUE)
+	append(&text, ");\n");
+	return finish(&text, table);
+}
+
+int flight_schema_select(char* query, size_t size, const char* table, const char* where) {
+	QueryText text = { query, size, 0 };
+
+	append(&text, "SELECT ");
+	FLIGHT_SCHEMA(NAME, NAME, FLIGHT_SCHEMA_SKIP)
+	append(&text, " FROM %s %s", table, where);
+	return finish(&text, table);
+}
+
+/* An int takes at most 11 bytes, and every column a separator. */
+#define INT_BYTES(name, ...) 11 +
+#define TEXT_BYTES(name, ...) flight->name.length +
+
+size_t flight_schema_csv_bytes(const Flight* flight) {
+	return FLIGHT_SCHEMA(INT_BYTES, TEXT_BYTES, FLIGHT_SCHEMA_SKIP) FLIGHT_CSV_COLUMNS;
+}
+
+static char* append_int(char* output, int value) {
+	char digits[10];
+	unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+	int n = 0;
+
+	if(value < 0) {
+		*output++ = '-';
+	}
+	do {
+		digits[n++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while(magnitude != 0);
+	while(n > 0) {
+		*output++ = digits[--n];
+	}
+	return output;
+}
+
+/* Writes the separators up to CSV column csv; *column is the column output is at. */
+static char* skip_to(char* output, int* column, int csv) {
+	while(*column < csv) {
+		*output++ = ',';
+		(*column)++;
+	}
+	return output;
+}
+
+#define CSV_INT(name, csv) \
+	end = skip_to(end, &column, csv); \
+	end = append_int(end, flight->name);
+#define CSV_TEXT(name, csv, ...) \
+	end = skip_to(end, &column, csv); \
+	memcpy(end, flight->name.data, flight->name.length); \
+	end += flight->name.length;
+
+size_t flight_schema_csv(char* output, const Flight* flight) {
+	char* end = output;
+	int column = 0;
+
+	FLIGHT_SCHEMA(CSV_INT, CSV_TEXT, FLIGHT_SCHEMA_SKIP)
+	end = skip_to(end, &column, FLIGHT_CSV_COLUMNS - 1);
+	*end++ = '\n';
+
+	return (size_t)(end - output);
+}
@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  The columns of flights, written down once. Each entry maps a column of
+  the CSV input to a column of the table:
+
+    INT(name, csv)				an int read from CSV column csv (0 based)
+    TEXT(name, csv, interned)	a varchar kept as a FlightString view; a
+								streamed reader interns it when interned is 1
+    DERIVED(name, value)		an int computed from const Flight* flight
+
+  in the order of the table's columns, with the INT and TEXT columns in
+  the order of their CSV columns. Everything that handles a whole row is
+  expanded from this list by the preprocessor: the Flight struct and its
+  stable bits, the CSV parser and interning, flight_binder_bind(),
+  flight_row_copy(), the CREATE TABLE columns, the INSERTs and the SELECT
+  below, the CSV writer used for exports, reject files and generated
+  data, the exporter's row decoding and checksum, and the records and
+  dictionary of flight_binary.h, whose header names the columns it was
+  written with. They compile to the same straight-line code as when they
+  were written out, and a column is added or moved by changing its line
+  here.
+
+  Not derived: code that gives columns a meaning, such as the data
+  generator, the rollups and the benchmarks' key lookups.
+*/
+
+#ifndef FLIGHT_SCHEMA_H
+#define FLIGHT_SCHEMA_H
+
+#include <stddef.h>
+
+#define FLIGHT_SCHEMA(INT, TEXT, DERIVED) \
+	INT(id, 0) \
+	INT(year, 1) \
+	INT(day_of_month, 2) \
+	TEXT(fl_date, 3, 0) \
+	INT(airline_id, 4) \
+	TEXT(carrier, 5, 1) \
+	INT(fl_num, 6) \
+	INT(origin_airport_id, 7) \
+	TEXT(origin, 8, 1) \
+	TEXT(origin_city_name, 9, 1) \
+	TEXT(origin_state_abr, 10, 1) \
+	TEXT(dest, 11, 1) \
+	TEXT(dest_city_name, 12, 1) \
+	TEXT(dest_state_abr, 13, 1) \
+	INT(dep_time, 14) \
+	INT(arr_time, 15) \
+	INT(actual_elapsed_time, 16) \
+	INT(air_time, 17) \
+	INT(distance, 18) \
+	DERIVED(air_time_grp, flight->air_time / 10)
+
+/* Columns on a line of flights_from_pg.csv, including any the table does not use. */
+#define FLIGHT_CSV_COLUMNS 19
+
+/* The partition key is carrier alone; token() takes exactly these columns. */
+#define FLIGHT_SCHEMA_PARTITION_KEY "carrier"
+#define FLIGHT_SCHEMA_KEY FLIGHT_SCHEMA_PARTITION_KEY ", origin, air_time_grp, id"
+
+/* Expands to nothing, for the kinds of column an expansion skips. */
+#define FLIGHT_SCHEMA_SKIP(name, ...)
+
+/* Bind marker of every column, e.g. FLIGHT_COLUMN_dest. */
+#define FLIGHT_SCHEMA_ENUM(name, ...) FLIGHT_COLUMN_##name,
+
+enum {
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_ENUM, FLIGHT_SCHEMA_ENUM, FLIGHT_SCHEMA_ENUM)
+	FLIGHT_NUM_COLUMNS
+} ;
+
+/* Index of every TEXT column among the TEXT columns, e.g. FLIGHT_STRING_dest. */
+#define FLIGHT_SCHEMA_STRING_ENUM(name, ...) FLIGHT_STRING_##name,
+
+enum {
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_SKIP, FLIGHT_SCHEMA_STRING_ENUM, FLIGHT_SCHEMA_SKIP)
+	FLIGHT_NUM_STRINGS
+} ;
+
+/*
+  "id int, year int, ..., " for a CREATE TABLE, ending in a separator so
+  the PRIMARY KEY can follow directly.
+*/
+#define FLIGHT_SCHEMA_INT_DEFINITION(name, ...) #name " int, "
+#define FLIGHT_SCHEMA_TEXT_DEFINITION(name, ...) #name " varchar, "
+
+#define FLIGHT_SCHEMA_DEFINITIONS \
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_INT_DEFINITION, FLIGHT_SCHEMA_TEXT_DEFINITION, FLIGHT_SCHEMA_INT_DEFINITION)
+
+/*
+  A string column as it appears in the input; it is not NUL terminated.
+  Views stay valid until the reader is closed when the file is mapped, and
+  only until the next call to flight_reader_next() when it is streamed,
+  except for columns the reader has interned (see Flight.stable).
+*/
+struct FlightString_ {
+	const char*	data;
+	size_t		length;
+} ;
+
+typedef struct FlightString_ FlightString;
+
+#define FLIGHT_SCHEMA_INT_FIELD(name, ...) int name;
+#define FLIGHT_SCHEMA_TEXT_FIELD(name, ...) FlightString name;
+
+/* One field per INT and TEXT column; derived columns are computed when they are written. */
+struct Flight_ {
+	FLIGHT_SCHEMA(FLIGHT_SCHEMA_INT_FIELD, FLIGHT_SCHEMA_TEXT_FIELD, FLIGHT_SCHEMA_SKIP)
+	unsigned		stable;		/* FLIGHT_STABLE() bits */
+} ;
+
+typedef struct Flight_ Flight;
+
+/*
+  Bits of Flight.stable, set for string columns whose views stay valid
+  until the reader is closed: every column of a mapped file, and the
+  columns a streamed reader has interned (see flight_intern.h).
+*/
+#define FLIGHT_STABLE(name)	(1u << FLIGHT_STRING_##name)
+#define FLIGHT_STABLE_ALL	((1u << FLIGHT_NUM_STRINGS) - 1)
+
+/*
+  Writes the INSERT of every column into table, in the order
+  flight_binder_bind() binds them, for preparing. Returns 0, or -1 with
+  the reason on stderr if it does not fit in size bytes.
+*/
+int flight_schema_insert(char* query, size_t size, const char* table);
+
+/*
+  Writes the INSERT of flight into table with its values as literals, as
+  the unprepared loaders send it. Returns 0 or -1 like flight_schema_insert().
+*/
+int flight_schema_insert_values(char* query, size_t size, const char* table, const Flight* flight);
+
+/*
+  Writes a SELECT of the INT and TEXT columns, in their order, from table
+  followed by where, e.g. "WHERE id = ?". Returns 0 or -1 like
+  flight_schema_insert().
+*/
+int flight_schema_select(char* query, size_t size, const char* table, const char* where);
+
+/* Most bytes flight_schema_csv() writes for flight. */
+size_t flight_schema_csv_bytes(const Flight* flight);
+
+/*
+  Writes flight as a line of flights_from_pg.csv, newline included but not
+  NUL terminated, and returns its length. CSV columns that are not in the
+  schema are left empty.
+*/
+size_t flight_schema_csv(char* output, const Flight* flight);
+
+#endif /* FLIGHT_SCHEMA_H */
@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <string.h>
+
+#include "latency_histogram.h"
+
+#define SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define MAX_VALUE ((1LL << LATENCY_HISTOGRAM_MAX_BITS) - 1)
+
+static int bucket_index(long long value) {
+	int msb = 0;
+
+	if(value < 2 * SUB_BUCKETS) {
+		return (int)value;
+	}
+
+	msb = 63 - __builtin_clzll((unsigned long long)value);
+	return 2 * SUB_BUCKETS + (msb - LATENCY_HISTOGRAM_SUB_BITS - 1) * SUB_BUCKETS +
+		(int)(value >> (msb - LATENCY_HISTOGRAM_SUB_BITS)) - SUB_BUCKETS;
+}
+
+/* The middle of the range of values that share bucket index. */
+static long long bucket_value(int index) {
+	int k = index - 2 * SUB_BUCKETS;
+	int shift = 0;
+
+	if(k < 0) {
+		return index;
+	}
+
+	shift = k / SUB_BUCKETS + 1;
+	return ((long long)(k % SUB_BUCKETS + SUB_BUCKETS) << shift) + (1LL << shift) / 2;
+}
+
+void latency_histogram_init(LatencyHistogram* histogram) {
+	memset(histogram, 0, sizeof(LatencyHistogram));
+}
+
+void latency_histogram_record(LatencyHistogram* histogram, long long value) {
+	long long max = histogram->max;
+
+	if(value < 0) {
+		value = 0;
+	} else if(value > MAX_VALUE) {
+		value = MAX_VALUE;
+	}
+
+	__sync_fetch_and_add(&histogram->counts[bucket_index(value)], 1);
+	__sync_fetch_and_add(&histogram->count, 1);
+	__sync_fetch_and_add(&histogram->sum, value);
+
+	while(value > max) {
+		long long seen = __sync_val_compare_and_swap(&histogram->max, max, value);
+		if(seen == max) {
+			break;
+		}
+		max = seen;
+	}
+}
+
+void latency_histogram_copy(LatencyHistogram* snapshot, const LatencyHistogram* histogram) {
+	memcpy(snapshot, histogram, sizeof(LatencyHistogram));
+}
+
+void latency_histogram_subtract(LatencyHistogram* histogram, const LatencyHistogram* earlier) {
+	int i;
+
+	histogram->count -= earlier->count;
+	histogram->sum -= earlier->sum;
+	for(i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		histogram->counts[i] -= earlier->counts[i];
+	}
+}
+
+long long latency_histogram_percentile(const LatencyHistogram* histogram, double percentile) {
+	long total = 0;
+	long seen = 0;
+	long rank = 0;
+	long long value = 0;
+	int i;
+
+	/* The bucket counts may run ahead of count while others record. */
+	for(i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		total += histogram->counts[i];
+	}
+	if(total <= 0) {
+		return 0;
+	}
+
+	rank = (long)(percentile / 100.0 * (double)total + 0.5);
+	if(rank < 1) {
+		rank = 1;
+	}
+
+	for(i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		seen += histogram->counts[i];
+		if(seen >= rank) {
+			value = bucket_value(i);
+			break;
+		}
+	}
+
+	return value < histogram->max || histogram->max == 0 ? value : histogram->max;
+}
+
+double latency_histogram_mean(const LatencyHistogram* histogram) {
+	return histogram->count > 0 ? (double)histogram->sum / (double)histogram->count : 0.0;
+}
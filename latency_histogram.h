@@ -0,0 +1,62 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Log-linear latency histogram in the style of HdrHistogram. Values below
+  64 ns get a bucket each; above that every power of two is split into 32
+  buckets, so any recorded value is reported within about 3%. Recording is
+  a handful of atomic adds and never takes a lock, so loader threads and
+  driver callbacks can share one histogram.
+*/
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#define LATENCY_HISTOGRAM_SUB_BITS 5
+#define LATENCY_HISTOGRAM_MAX_BITS 48	/* values up to about 78 hours */
+#define LATENCY_HISTOGRAM_BUCKETS ((2 << LATENCY_HISTOGRAM_SUB_BITS) + \
+	(LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BITS - 1) * (1 << LATENCY_HISTOGRAM_SUB_BITS))
+
+struct LatencyHistogram_ {
+	long			count;
+	long long		sum;
+	long long		max;
+	long			counts[LATENCY_HISTOGRAM_BUCKETS];
+} ;
+
+typedef struct LatencyHistogram_ LatencyHistogram;
+
+void latency_histogram_init(LatencyHistogram* histogram);
+
+/* Records one value in nanoseconds; negative values count as 0. */
+void latency_histogram_record(LatencyHistogram* histogram, long long value);
+
+/*
+  Copies histogram into snapshot while it may still be recorded into. The
+  copy is not atomic as a whole, which only matters for values recorded
+  during the copy.
+*/
+void latency_histogram_copy(LatencyHistogram* snapshot, const LatencyHistogram* histogram);
+
+/* Leaves in histogram only what was recorded after earlier was copied. max is kept. */
+void latency_histogram_subtract(LatencyHistogram* histogram, const LatencyHistogram* earlier);
+
+/* Value at percentile (0 - 100), in nanoseconds; 0 when empty. */
+long long latency_histogram_percentile(const LatencyHistogram* histogram, double percentile);
+
+double latency_histogram_mean(const LatencyHistogram* histogram);
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -0,0 +1,238 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "load_batch.h"
+
+static double now_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void load_batch_sizer_init(LoadBatchSizer* sizer, int row_limit, int adaptive, size_t max_bytes,
+							double target_latency) {
+	memset(sizer, 0, sizeof(LoadBatchSizer));
+	sizer->adaptive = adaptive;
+	sizer->max_bytes = adaptive ? max_bytes : (size_t)-1;
+	sizer->target_latency = target_latency;
+	sizer->row_limit = row_limit < 1 ? 1 : row_limit > LOAD_BATCH_MAX_ROWS ? LOAD_BATCH_MAX_ROWS : row_limit;
+}
+
+int load_batch_sizer_full(const LoadBatchSizer* sizer, int rows, size_t bytes, size_t row_bytes) {
+	return rows >= sizer->row_limit || (rows > 0 && bytes + row_bytes > sizer->max_bytes);
+}
+
+void load_batch_sizer_update(LoadBatchSizer* sizer, CassError rc, double latency, int rows, size_t bytes) {
+	sizer->batches++;
+	sizer->rows += rows;
+	sizer->bytes += (double)bytes;
+	if(sizer->batches == 1 || rows < sizer->min_rows) {
+		sizer->min_rows = rows;
+	}
+	if(rows > sizer->max_rows) {
+		sizer->max_rows = rows;
+	}
+	if(bytes > sizer->max_batch_bytes) {
+		sizer->max_batch_bytes = bytes;
+	}
+
+	if(!sizer->adaptive) {
+		return;
+	}
+
+	if(rc != CASS_OK || latency > sizer->target_latency) {
+		sizer->row_limit /= 2;
+		if(sizer->row_limit < 1) {
+			sizer->row_limit = 1;
+		}
+	} else if(rows >= sizer->row_limit) {
+		/* Only grow when the limit, not the byte budget, closed the batch. */
+		sizer->row_limit += LOAD_BATCH_ROWS_STEP;
+		if(sizer->row_limit > LOAD_BATCH_MAX_ROWS) {
+			sizer->row_limit = LOAD_BATCH_MAX_ROWS;
+		}
+	}
+}
+
+void load_batch_sizer_merge(LoadBatchSizer* totals, const LoadBatchSizer* sizer) {
+	if(sizer->batches == 0) {
+		return;
+	}
+	if(totals->batches == 0 || sizer->min_rows < totals->min_rows) {
+		totals->min_rows = sizer->min_rows;
+	}
+	if(sizer->max_rows > totals->max_rows) {
+		totals->max_rows = sizer->max_rows;
+	}
+	if(sizer->max_batch_bytes > totals->max_batch_bytes) {
+		totals->max_batch_bytes = sizer->max_batch_bytes;
+	}
+	totals->batches += sizer->batches;
+	totals->rows += sizer->rows;
+	totals->bytes += sizer->bytes;
+}
+
+void load_partitions_init(LoadPartitions* partitions, LoadBatchSizer* sizer, double max_age,
+							LoadPartitionSend send, void* data) {
+	memset(partitions, 0, sizeof(LoadPartitions));
+	partitions->sizer = sizer;
+	partitions->max_age = max_age;
+	partitions->send = send;
+	partitions->data = data;
+}
+
+/* Orders rows by the clustering prefix (origin, air_time_grp), then id. */
+static int compare_clustering(const void* a, const void* b) {
+	const Flight* x = &(*(const FlightRow* const*)a)->flight;
+	const Flight* y = &(*(const FlightRow* const*)b)->flight;
+	size_t length = x->origin.length < y->origin.length ? x->origin.length : y->origin.length;
+	int cmp = memcmp(x->origin.data, y->origin.data, length);
+
+	if(cmp != 0) {
+		return cmp;
+	}
+	if(x->origin.length != y->origin.length) {
+		return x->origin.length < y->origin.length ? -1 : 1;
+	}
+	if(x->air_time / 10 != y->air_time / 10) {
+		return x->air_time / 10 < y->air_time / 10 ? -1 : 1;
+	}
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static void flush_partition(LoadPartitions* partitions, LoadPartitionBuffer* buffer) {
+	FlightRow* order[LOAD_BATCH_MAX_ROWS];
+	int i;
+
+	if(buffer->num_rows == 0) {
+		return;
+	}
+
+	for(i = 0; i < buffer->num_rows; ++i) {
+		order[i] = &buffer->rows[i];
+	}
+	qsort(order, (size_t)buffer->num_rows, sizeof(FlightRow*), compare_clustering);
+
+	partitions->send(partitions->data, order, buffer->num_rows, buffer->first);
+
+	buffer->num_rows = 0;
+	buffer->bytes = 0;
+}
+
+static LoadPartitionBuffer* find_partition(LoadPartitions* partitions, const FlightString* carrier) {
+	LoadPartitionBuffer* buffer = NULL;
+	int i;
+
+	for(i = 0; i < partitions->num_buffers; ++i) {
+		buffer = partitions->buffers[i];
+		if(buffer->carrier_length == carrier->length &&
+			memcmp(buffer->carrier, carrier->data, carrier->length) == 0) {
+			return buffer;
+		}
+	}
+
+	if(partitions->num_buffers == partitions->capacity) {
+		int capacity = partitions->capacity > 0 ? partitions->capacity * 2 : 32;
+		LoadPartitionBuffer** buffers = realloc(partitions->buffers,
+			(size_t)capacity * sizeof(LoadPartitionBuffer*));
+		if(buffers == NULL) {
+			return NULL;
+		}
+		partitions->buffers = buffers;
+		partitions->capacity = capacity;
+	}
+
+	buffer = malloc(sizeof(LoadPartitionBuffer));
+	if(buffer == NULL) {
+		return NULL;
+	}
+	buffer->carrier = malloc(carrier->length + 1);
+	if(buffer->carrier == NULL) {
+		free(buffer);
+		return NULL;
+	}
+	memcpy(buffer->carrier, carrier->data, carrier->length);
+	buffer->carrier_length = carrier->length;
+	buffer->num_rows = 0;
+	buffer->bytes = 0;
+
+	partitions->buffers[partitions->num_buffers++] = buffer;
+	return buffer;
+}
+
+int load_partitions_add(LoadPartitions* partitions, const Flight* flight, size_t row_bytes, size_t offset) {
+	LoadPartitionBuffer* buffer = find_partition(partitions, &flight->carrier);
+
+	if(buffer == NULL) {
+		return -1;
+	}
+	if(load_batch_sizer_full(partitions->sizer, buffer->num_rows, buffer->bytes, row_bytes)) {
+		flush_partition(partitions, buffer);
+	}
+	if(flight_row_copy(&buffer->rows[buffer->num_rows], flight) != 0) {
+		return -1;
+	}
+
+	if(buffer->num_rows++ == 0) {
+		buffer->oldest = now_seconds();
+		buffer->first = offset;
+	}
+	buffer->bytes += row_bytes;
+	return 0;
+}
+
+void load_partitions_age(LoadPartitions* partitions) {
+	double now = now_seconds();
+	int i;
+
+	for(i = 0; i < partitions->num_buffers; ++i) {
+		if(partitions->buffers[i]->num_rows > 0 &&
+			now - partitions->buffers[i]->oldest >= partitions->max_age) {
+			flush_partition(partitions, partitions->buffers[i]);
+		}
+	}
+}
+
+size_t load_partitions_done(const LoadPartitions* partitions, size_t read) {
+	size_t done = read;
+	int i;
+
+	for(i = 0; i < partitions->num_buffers; ++i) {
+		if(partitions->buffers[i]->num_rows > 0 && partitions->buffers[i]->first < done) {
+			done = partitions->buffers[i]->first;
+		}
+	}
+
+	return done;
+}
+
+void load_partitions_finish(LoadPartitions* partitions) {
+	int i;
+
+	for(i = 0; i < partitions->num_buffers; ++i) {
+		flush_partition(partitions, partitions->buffers[i]);
+		free(partitions->buffers[i]->carrier);
+		free(partitions->buffers[i]);
+	}
+	free(partitions->buffers);
+	partitions->buffers = NULL;
+	partitions->num_buffers = 0;
+	partitions->capacity = 0;
+}
@@ -0,0 +1,144 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  How the batch loader decides what goes into a batch, kept apart from how
+  it sends them so the insert strategy benchmark measures the same batches:
+
+  - LoadBatchSizer closes a batch at row_limit rows, or before it would
+    exceed max_bytes of bound payload. When adaptive, row_limit follows
+    AIMD on the measured round trip: it grows by LOAD_BATCH_ROWS_STEP
+    while batches complete within target_latency and halves when they do
+    not, or when the batch fails.
+
+  - LoadPartitions buffers rows per carrier, i.e. per partition of
+    flights, and hands a buffer to its send callback in clustering order
+    when the sizer says it is full, when its oldest row has waited
+    max_age seconds, or at the end. Every batch then stays within one
+    partition and can be UNLOGGED.
+
+  Neither is thread safe; each loader thread has its own.
+*/
+
+#ifndef LOAD_BATCH_H
+#define LOAD_BATCH_H
+
+#include <stddef.h>
+
+#include "cassandra.h"
+
+#include "flight_reader.h"
+
+/* Rows per batch unless sizing is adaptive; also where adaptive sizing starts. */
+#define LOAD_BATCH_ROWS 100
+
+/* Upper bound for adaptive sizing, and the capacity of a partition buffer. */
+#define LOAD_BATCH_MAX_ROWS 256
+
+/* Rows added per batch while latency stays under target. */
+#define LOAD_BATCH_ROWS_STEP 5
+
+/* Reading the clock for every row is wasteful; partition buffers are aged this often. */
+#define LOAD_BATCH_AGE_CHECK_ROWS 1024
+
+struct LoadBatchSizer_ {
+	int			adaptive;
+	size_t		max_bytes;
+	double		target_latency;
+	int			row_limit;
+
+	long		batches;
+	long		rows;
+	double		bytes;
+	int			min_rows;
+	int			max_rows;
+	size_t		max_batch_bytes;
+} ;
+
+typedef struct LoadBatchSizer_ LoadBatchSizer;
+
+/*
+  Starts at row_limit rows per batch (at most LOAD_BATCH_MAX_ROWS). Without
+  adaptive, the limit stays there and max_bytes is ignored.
+*/
+void load_batch_sizer_init(LoadBatchSizer* sizer, int row_limit, int adaptive, size_t max_bytes,
+							double target_latency);
+
+/* True if a row of row_bytes must go into a new batch. */
+int load_batch_sizer_full(const LoadBatchSizer* sizer, int rows, size_t bytes, size_t row_bytes);
+
+/* Records a sent batch and, when adaptive, moves row_limit. latency is in seconds. */
+void load_batch_sizer_update(LoadBatchSizer* sizer, CassError rc, double latency, int rows, size_t bytes);
+
+/* Folds the statistics of a finished sizer into totals; the caller serializes. */
+void load_batch_sizer_merge(LoadBatchSizer* totals, const LoadBatchSizer* sizer);
+
+/*
+  Sends num_rows rows of one carrier, ordered by origin, air_time_grp and
+  id. first is the input offset of the oldest of them. The rows are only
+  valid during the call.
+*/
+typedef void (*LoadPartitionSend)(void* data, FlightRow* const* rows, int num_rows, size_t first);
+
+/*
+  Rows waiting for one carrier. first is the file offset of the oldest row,
+  which holds back a checkpoint until the buffer has been sent.
+*/
+struct LoadPartitionBuffer_ {
+	char*		carrier;
+	size_t		carrier_length;
+	int			num_rows;
+	size_t		bytes;
+	double		oldest;
+	size_t		first;
+	FlightRow	rows[LOAD_BATCH_MAX_ROWS];
+} ;
+
+typedef struct LoadPartitionBuffer_ LoadPartitionBuffer;
+
+struct LoadPartitions_ {
+	LoadBatchSizer*			sizer;
+	double					max_age;
+	LoadPartitionSend		send;
+	void*					data;
+	LoadPartitionBuffer**	buffers;
+	int						num_buffers;
+	int						capacity;
+} ;
+
+typedef struct LoadPartitions_ LoadPartitions;
+
+void load_partitions_init(LoadPartitions* partitions, LoadBatchSizer* sizer, double max_age,
+							LoadPartitionSend send, void* data);
+
+/*
+  Copies flight into the buffer of its carrier, sending the buffer first if
+  the row would not fit by the sizer's limits. offset is where the row
+  starts in the input. Returns 0, or -1 if the row could not be buffered;
+  the caller must then send it on its own while its views are valid.
+*/
+int load_partitions_add(LoadPartitions* partitions, const Flight* flight, size_t row_bytes, size_t offset);
+
+/* Sends every buffer whose oldest row has waited max_age seconds. */
+void load_partitions_age(LoadPartitions* partitions);
+
+/* Offset below which every row is sent: the oldest buffered row, or read if none is. */
+size_t load_partitions_done(const LoadPartitions* partitions, size_t read);
+
+/* Sends the rows still buffered and frees the buffers. */
+void load_partitions_finish(LoadPartitions* partitions);
+
+#endif /* LOAD_BATCH_H */
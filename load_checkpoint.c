@@ -0,0 +1,258 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "load_checkpoint.h"
+
+/*
+  The checkpoint file is plain text:
+
+    flights checkpoint 1
+    input 123456789
+    parts 4
+    0 30864197
+    ...
+*/
+#define CHECKPOINT_VERSION 1
+
+static int read_checkpoint(LoadCheckpoint* checkpoint) {
+	FILE* file = fopen(checkpoint->path, "r");
+	unsigned long input_size = 0, offset = 0;
+	int version = 0, num_parts = 0, part = 0, i;
+
+	if(file == NULL) {
+		fprintf(stderr, "Error: unable to open checkpoint %s: %s\n", checkpoint->path, strerror(errno));
+		return -1;
+	}
+
+	if(fscanf(file, "flights checkpoint %d input %lu parts %d", &version, &input_size, &num_parts) != 3 ||
+		version != CHECKPOINT_VERSION) {
+		fprintf(stderr, "Error: %s is not a flights checkpoint\n", checkpoint->path);
+		fclose(file);
+		return -1;
+	}
+	if((size_t)input_size != checkpoint->input_size || num_parts != checkpoint->num_parts) {
+		fprintf(stderr, "Error: %s was saved for %lu bytes of input in %d parts, not %lu bytes in %d parts\n",
+			checkpoint->path, input_size, num_parts, (unsigned long)checkpoint->input_size, checkpoint->num_parts);
+		fclose(file);
+		return -1;
+	}
+
+	for(i = 0; i < num_parts; ++i) {
+		if(fscanf(file, "%d %lu", &part, &offset) != 2 || part != i) {
+			fprintf(stderr, "Error: %s is truncated\n", checkpoint->path);
+			fclose(file);
+			return -1;
+		}
+		if((size_t)offset > checkpoint->offsets[i]) {
+			checkpoint->offsets[i] = (size_t)offset;
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+int load_checkpoint_init(LoadCheckpoint* checkpoint, const char* path, const char* input,
+						int num_parts, int resume) {
+	struct stat st;
+	int i;
+
+	memset(checkpoint, 0, sizeof(LoadCheckpoint));
+	if(num_parts < 1) {
+		fprintf(stderr, "Error: --threads must be at least 1\n");
+		return -1;
+	}
+
+	checkpoint->path = path;
+	checkpoint->num_parts = num_parts;
+	checkpoint->resume = resume;
+	checkpoint->offsets = calloc((size_t)num_parts, sizeof(size_t));
+	checkpoint->begins = calloc((size_t)num_parts, sizeof(size_t));
+	if(checkpoint->offsets == NULL || checkpoint->begins == NULL) {
+		free(checkpoint->offsets);
+		free(checkpoint->begins);
+		checkpoint->offsets = NULL;
+		checkpoint->begins = NULL;
+		return -1;
+	}
+	if(stat(input, &st) == 0 && S_ISREG(st.st_mode)) {
+		checkpoint->input_size = (size_t)st.st_size;
+	}
+
+	/* Offsets stay 0, before any part, until a part's reader says where it begins. */
+	if(resume && read_checkpoint(checkpoint) != 0) {
+		free(checkpoint->offsets);
+		free(checkpoint->begins);
+		checkpoint->offsets = NULL;
+		checkpoint->begins = NULL;
+		return -1;
+	}
+	for(i = 0; i < num_parts; ++i) {
+		checkpoint->begins[i] = checkpoint->offsets[i];
+	}
+
+	pthread_mutex_init(&checkpoint->lock, NULL);
+	pthread_cond_init(&checkpoint->wake, NULL);
+
+	return 0;
+}
+
+void load_checkpoint_destroy(LoadCheckpoint* checkpoint) {
+	pthread_cond_destroy(&checkpoint->wake);
+	pthread_mutex_destroy(&checkpoint->lock);
+	free(checkpoint->offsets);
+	free(checkpoint->begins);
+	checkpoint->offsets = NULL;
+	checkpoint->begins = NULL;
+}
+
+void load_checkpoint_begin(LoadCheckpoint* checkpoint, int part, size_t begin) {
+	size_t offset = __sync_fetch_and_add(&checkpoint->offsets[part], 0);
+
+	checkpoint->begins[part] = begin;
+	if(offset > begin) {
+		checkpoint->resumed += offset - begin;
+	} else {
+		__sync_lock_test_and_set(&checkpoint->offsets[part], begin);
+	}
+}
+
+size_t load_checkpoint_offset(const LoadCheckpoint* checkpoint, int part) {
+	return checkpoint->offsets[part];
+}
+
+void load_checkpoint_update(LoadCheckpoint* checkpoint, int part, size_t offset) {
+	if(checkpoint != NULL) {
+		__sync_lock_test_and_set(&checkpoint->offsets[part], offset);
+	}
+}
+
+int load_checkpoint_save(LoadCheckpoint* checkpoint) {
+	char temp[1024];
+	FILE* file = NULL;
+	int i;
+
+	snprintf(temp, sizeof(temp), "%s.tmp", checkpoint->path);
+	file = fopen(temp, "w");
+	if(file == NULL) {
+		fprintf(stderr, "Error: unable to write checkpoint %s: %s\n", temp, strerror(errno));
+		return -1;
+	}
+
+	fprintf(file, "flights checkpoint %d\ninput %lu\nparts %d\n",
+		CHECKPOINT_VERSION, (unsigned long)checkpoint->input_size, checkpoint->num_parts);
+	for(i = 0; i < checkpoint->num_parts; ++i) {
+		fprintf(file, "%d %lu\n", i, (unsigned long)__sync_fetch_and_add(&checkpoint->offsets[i], 0));
+	}
+
+	/* The new checkpoint must be on disk before it replaces the old one. */
+	if(fflush(file) != 0 || fsync(fileno(file)) != 0) {
+		fprintf(stderr, "Error: unable to write checkpoint %s: %s\n", temp, strerror(errno));
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+
+	if(rename(temp, checkpoint->path) != 0) {
+		fprintf(stderr, "Error: unable to replace checkpoint %s: %s\n", checkpoint->path, strerror(errno));
+		return -1;
+	}
+
+	checkpoint->saves++;
+	return 0;
+}
+
+static void* save_periodically(void* data) {
+	LoadCheckpoint* checkpoint = (LoadCheckpoint*)data;
+
+	pthread_mutex_lock(&checkpoint->lock);
+	while(!checkpoint->stopping) {
+		struct timespec deadline;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)checkpoint->interval;
+		deadline.tv_nsec += (long)((checkpoint->interval - (long)checkpoint->interval) * 1e9);
+		if(deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while(!checkpoint->stopping &&
+			pthread_cond_timedwait(&checkpoint->wake, &checkpoint->lock, &deadline) != ETIMEDOUT) {
+		}
+		if(checkpoint->stopping) {
+			break;
+		}
+
+		load_checkpoint_save(checkpoint);
+	}
+	pthread_mutex_unlock(&checkpoint->lock);
+
+	return NULL;
+}
+
+void load_checkpoint_start(LoadCheckpoint* checkpoint, double interval) {
+	/* Record where this run starts, so a crash before the first interval can resume too. */
+	load_checkpoint_save(checkpoint);
+
+	if(interval > 0.0 && !checkpoint->running) {
+		checkpoint->interval = interval;
+		checkpoint->stopping = 0;
+		checkpoint->running = pthread_create(&checkpoint->saver, NULL, save_periodically, checkpoint) == 0;
+	}
+}
+
+void load_checkpoint_stop(LoadCheckpoint* checkpoint) {
+	if(checkpoint->running) {
+		pthread_mutex_lock(&checkpoint->lock);
+		checkpoint->stopping = 1;
+		pthread_cond_signal(&checkpoint->wake);
+		pthread_mutex_unlock(&checkpoint->lock);
+
+		pthread_join(checkpoint->saver, NULL);
+		checkpoint->running = 0;
+	}
+
+	load_checkpoint_save(checkpoint);
+}
+
+void load_checkpoint_report(const LoadCheckpoint* checkpoint) {
+	size_t done = 0;
+	int i;
+
+	for(i = 0; i < checkpoint->num_parts; ++i) {
+		done += checkpoint->offsets[i] - checkpoint->begins[i];
+	}
+
+	if(checkpoint->resumed > 0) {
+		printf("Resumed after %lu bytes already loaded.\n", (unsigned long)checkpoint->resumed);
+	}
+	if(done > checkpoint->input_size) {
+		/* A pipe, or compressed input; offsets count the text read, not the file. */
+		printf("Checkpoint at %lu bytes after %ld saves to %s.\n",
+			(unsigned long)done, checkpoint->saves, checkpoint->path);
+	} else {
+		printf("Checkpoint at %lu of %lu bytes after %ld saves to %s.\n",
+			(unsigned long)done, (unsigned long)checkpoint->input_size, checkpoint->saves, checkpoint->path);
+	}
+}
@@ -0,0 +1,95 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Lets a load that died part way be resumed instead of redone. For each
+  part of the input the loader publishes the file offset below which every
+  row has been acknowledged (or written to the reject file), and a
+  background thread saves those offsets to the checkpoint file every
+  interval seconds. The file is replaced by rename, so a crash leaves
+  either the previous checkpoint or the new one.
+
+  A resumed load seeks each part to its saved offset. Rows between the
+  checkpoint and the crash are sent again, which is harmless because an
+  INSERT of the same primary key simply overwrites the row. Parts are
+  byte ranges of the input, so a checkpoint can only be resumed with the
+  same input size and the same number of threads.
+*/
+
+#ifndef LOAD_CHECKPOINT_H
+#define LOAD_CHECKPOINT_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+struct LoadCheckpoint_ {
+	const char*		path;
+	int				num_parts;
+	size_t			input_size;
+	int				resume;
+	size_t*			offsets;		/* per part, published by the loader threads */
+	size_t*			begins;			/* per part, where its reader started */
+	size_t			resumed;		/* bytes skipped by resuming */
+
+	pthread_t		saver;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;
+	int				running;
+	int				stopping;
+	double			interval;
+	long			saves;
+} ;
+
+typedef struct LoadCheckpoint_ LoadCheckpoint;
+
+/*
+  With resume, reads the offsets saved by an earlier run of the same
+  input and thread count; otherwise every part starts at its beginning.
+  Returns 0 or -1 if the checkpoint is missing or does not match.
+*/
+int load_checkpoint_init(LoadCheckpoint* checkpoint, const char* path, const char* input,
+						int num_parts, int resume);
+
+void load_checkpoint_destroy(LoadCheckpoint* checkpoint);
+
+/*
+  Records where the reader of part begins, which only the reader knows:
+  CSV parts move to a line boundary and binary parts to a block of
+  records. A part with nothing saved for it is done up to there.
+*/
+void load_checkpoint_begin(LoadCheckpoint* checkpoint, int part, size_t begin);
+
+/* Offset at which part should start reading: its saved offset, or 0 if nothing was saved. */
+size_t load_checkpoint_offset(const LoadCheckpoint* checkpoint, int part);
+
+/*
+  Publishes that every row of part before offset is done. Cheap enough to
+  call per row; a NULL checkpoint is ignored.
+*/
+void load_checkpoint_update(LoadCheckpoint* checkpoint, int part, size_t offset);
+
+/* Writes the checkpoint file now. Returns 0 or -1. */
+int load_checkpoint_save(LoadCheckpoint* checkpoint);
+
+/* Saves every interval seconds until load_checkpoint_stop(), if interval is positive. */
+void load_checkpoint_start(LoadCheckpoint* checkpoint, double interval);
+
+/* Stops the saver and saves the final offsets. */
+void load_checkpoint_stop(LoadCheckpoint* checkpoint);
+
+void load_checkpoint_report(const LoadCheckpoint* checkpoint);
+
+#endif /* LOAD_CHECKPOINT_H */
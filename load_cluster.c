@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <strings.h>
+
+#include "load_cluster.h"
+
+struct ConsistencyName_ {
+	const char*		name;
+	CassConsistency	consistency;
+} ;
+
+typedef struct ConsistencyName_ ConsistencyName;
+
+static const ConsistencyName consistency_names[] = {
+	{ "any", CASS_CONSISTENCY_ANY },
+	{ "one", CASS_CONSISTENCY_ONE },
+	{ "two", CASS_CONSISTENCY_TWO },
+	{ "three", CASS_CONSISTENCY_THREE },
+	{ "quorum", CASS_CONSISTENCY_QUORUM },
+	{ "all", CASS_CONSISTENCY_ALL },
+	{ "local_quorum", CASS_CONSISTENCY_LOCAL_QUORUM },
+	{ "each_quorum", CASS_CONSISTENCY_EACH_QUORUM },
+	{ "local_one", CASS_CONSISTENCY_LOCAL_ONE }
+};
+
+/* Set once by load_cluster_create(), before any loader thread starts. */
+static CassConsistency consistency = CASS_CONSISTENCY_ONE;
+
+void load_cluster_init(LoadCluster* settings) {
+	settings->contact_points = "127.0.0.1";
+	settings->port = 0;
+	settings->io_threads = 0;
+	settings->core_connections = 0;
+	settings->max_connections = 0;
+	settings->queue_size_io = 0;
+	settings->pending_requests = 0;
+	settings->connect_timeout_ms = 0;
+	settings->request_timeout_ms = 0;
+	settings->consistency = "one";
+}
+
+static int set(const char* name, CassError rc) {
+	if(rc != CASS_OK) {
+		fprintf(stderr, "Error: invalid %s: %s\n", name, cass_error_desc(rc));
+		return -1;
+	}
+	return 0;
+}
+
+CassCluster* load_cluster_create(const LoadCluster* settings) {
+	CassCluster* cluster = NULL;
+	size_t i;
+	int rc = 0;
+
+	for(i = 0; i < sizeof(consistency_names) / sizeof(consistency_names[0]); ++i) {
+		if(strcasecmp(settings->consistency, consistency_names[i].name) == 0) {
+			break;
+		}
+	}
+	if(i == sizeof(consistency_names) / sizeof(consistency_names[0])) {
+		fprintf(stderr, "Error: unknown consistency level %s\n", settings->consistency);
+		return NULL;
+	}
+	consistency = consistency_names[i].consistency;
+
+	cluster = cass_cluster_new();
+	rc |= set("--contact-points", cass_cluster_set_contact_points(cluster, settings->contact_points));
+	if(settings->port > 0) {
+		rc |= set("--port", cass_cluster_set_port(cluster, settings->port));
+	}
+	if(settings->io_threads > 0) {
+		rc |= set("--io-threads", cass_cluster_set_num_threads_io(cluster, (unsigned)settings->io_threads));
+	}
+	if(settings->core_connections > 0) {
+		rc |= set("--core-connections",
+			cass_cluster_set_core_connections_per_host(cluster, (unsigned)settings->core_connections));
+	}
+	if(settings->max_connections > 0) {
+		rc |= set("--max-connections",
+			cass_cluster_set_max_connections_per_host(cluster, (unsigned)settings->max_connections));
+	}
+	if(settings->queue_size_io > 0) {
+		rc |= set("--queue-size-io", cass_cluster_set_queue_size_io(cluster, (unsigned)settings->queue_size_io));
+	}
+	if(settings->pending_requests > 0) {
+		rc |= set("--pending-requests",
+			cass_cluster_set_pending_requests_high_water_mark(cluster, (unsigned)settings->pending_requests));
+	}
+	if(settings->connect_timeout_ms > 0) {
+		rc |= set("--connect-timeout-ms",
+			cass_cluster_set_connect_timeout(cluster, (unsigned)settings->connect_timeout_ms));
+	}
+	if(settings->request_timeout_ms > 0) {
+		rc |= set("--request-timeout-ms",
+			cass_cluster_set_request_timeout(cluster, (unsigned)settings->request_timeout_ms));
+	}
+
+	if(rc != 0) {
+		cass_cluster_free(cluster);
+		return NULL;
+	}
+	return cluster;
+}
+
+void load_cluster_apply(CassStatement* statement) {
+	cass_statement_set_consistency(statement, consistency);
+}
+
+void load_cluster_apply_batch(CassBatch* batch) {
+	cass_batch_set_consistency(batch, consistency);
+}
+
+CassError load_cluster_execute(CassSession* session, const char* query) {
+	CassError rc = CASS_OK;
+	CassStatement* statement = cass_statement_new(cass_string_init(query), 0);
+	CassFuture* future = NULL;
+
+	load_cluster_apply(statement);
+	future = cass_session_execute(session, statement);
+	cass_future_wait(future);
+
+	rc = cass_future_error_code(future);
+	if(rc != CASS_OK) {
+		CassString message = cass_future_error_message(future);
+		fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+	}
+
+	cass_future_free(future);
+	cass_statement_free(statement);
+	return rc;
+}
+
+static void print_setting(FILE* out, const char* name, int value) {
+	if(value > 0) {
+		fprintf(out, ", %s %d", name, value);
+	} else {
+		fprintf(out, ", %s default", name);
+	}
+}
+
+void load_cluster_report(const LoadCluster* settings, FILE* out) {
+	fprintf(out, "Cluster: contact points %s", settings->contact_points);
+	print_setting(out, "port", settings->port);
+	print_setting(out, "io threads", settings->io_threads);
+	print_setting(out, "core connections", settings->core_connections);
+	print_setting(out, "max connections", settings->max_connections);
+	print_setting(out, "io queue", settings->queue_size_io);
+	print_setting(out, "pending requests", settings->pending_requests);
+	print_setting(out, "connect timeout ms", settings->connect_timeout_ms);
+	print_setting(out, "request timeout ms", settings->request_timeout_ms);
+	fprintf(out, ", consistency %s.\n", settings->consistency);
+}
@@ -0,0 +1,82 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Driver and session settings shared by the loaders: contact points, I/O
+  threads, connections per host, request queue limits, timeouts and the
+  consistency level. Each loader adds LOAD_CLUSTER_OPTIONS() to its
+  options, so they can be given on the command line or in a --config
+  file, and prints the effective values with its summary so a throughput
+  number can be reproduced. Numeric settings left at 0 keep the driver's
+  default.
+*/
+
+#ifndef LOAD_CLUSTER_H
+#define LOAD_CLUSTER_H
+
+#include <stdio.h>
+
+#include "cassandra.h"
+
+#include "load_options.h"
+
+struct LoadCluster_ {
+	const char*	contact_points;		/* comma separated */
+	int			port;
+	int			io_threads;
+	int			core_connections;	/* per host, per I/O thread */
+	int			max_connections;
+	int			queue_size_io;		/* requests waiting for an I/O thread */
+	int			pending_requests;	/* per connection before it is marked busy */
+	int			connect_timeout_ms;
+	int			request_timeout_ms;
+	const char*	consistency;		/* e.g. "one", "local_quorum" */
+} ;
+
+typedef struct LoadCluster_ LoadCluster;
+
+#define LOAD_CLUSTER_OPTIONS(settings) \
+	{ "--contact-points", LOAD_OPTION_STRING, &(settings)->contact_points, "comma separated hosts (default 127.0.0.1)" }, \
+	{ "--port", LOAD_OPTION_INT, &(settings)->port, "native protocol port" }, \
+	{ "--io-threads", LOAD_OPTION_INT, &(settings)->io_threads, "driver I/O threads" }, \
+	{ "--core-connections", LOAD_OPTION_INT, &(settings)->core_connections, "connections per host and I/O thread to start with" }, \
+	{ "--max-connections", LOAD_OPTION_INT, &(settings)->max_connections, "connections per host and I/O thread to grow to" }, \
+	{ "--queue-size-io", LOAD_OPTION_INT, &(settings)->queue_size_io, "requests queued for the I/O threads before sends fail" }, \
+	{ "--pending-requests", LOAD_OPTION_INT, &(settings)->pending_requests, "requests pending on a connection before another is used" }, \
+	{ "--connect-timeout-ms", LOAD_OPTION_INT, &(settings)->connect_timeout_ms, "connection timeout" }, \
+	{ "--request-timeout-ms", LOAD_OPTION_INT, &(settings)->request_timeout_ms, "client side request timeout" }, \
+	{ "--consistency", LOAD_OPTION_STRING, &(settings)->consistency, "consistency level of every statement (default one)" }
+
+/* Sets the defaults: 127.0.0.1, consistency one, and driver defaults for the rest. */
+void load_cluster_init(LoadCluster* settings);
+
+/*
+  Creates a cluster with settings applied and makes their consistency the
+  one load_cluster_apply() sets. Returns NULL if a setting is invalid.
+*/
+CassCluster* load_cluster_create(const LoadCluster* settings);
+
+/* Sets the configured consistency level on a statement or a batch. */
+void load_cluster_apply(CassStatement* statement);
+void load_cluster_apply_batch(CassBatch* batch);
+
+/* Runs query at the configured consistency and waits for it, printing any error. */
+CassError load_cluster_execute(CassSession* session, const char* query);
+
+/* Prints the effective settings to out. */
+void load_cluster_report(const LoadCluster* settings, FILE* out);
+
+#endif /* LOAD_CLUSTER_H */
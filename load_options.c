@@ -0,0 +1,187 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "load_options.h"
+
+static void print_usage(const char* program, const LoadOption* options, int num_options) {
+	int i;
+
+	fprintf(stderr, "Usage: %s [options]\n", program);
+	for(i = 0; i < num_options; ++i) {
+		const char* arg = options[i].type == LOAD_OPTION_FLAG ? "" :
+			options[i].type == LOAD_OPTION_STRING ? " VALUE" : " N";
+		char name[64];
+
+		snprintf(name, sizeof(name), "%s%s", options[i].name, arg);
+		fprintf(stderr, "  %-28s %s\n", name, options[i].help);
+	}
+	fprintf(stderr, "  %-28s %s\n", "--config FILE", "read options from FILE, one \"name value\" per line");
+}
+
+static const LoadOption* find_option(const char* name, const LoadOption* options, int num_options) {
+	int i;
+
+	for(i = 0; i < num_options; ++i) {
+		if(strcmp(name, options[i].name) == 0) {
+			return &options[i];
+		}
+	}
+	return NULL;
+}
+
+static int parse_value(const LoadOption* option, const char* text) {
+	char* end = NULL;
+
+	switch(option->type) {
+		case LOAD_OPTION_INT: {
+			long value = strtol(text, &end, 10);
+			if(end == text || *end != '\0') {
+				return -1;
+			}
+			*(int*)option->value = (int)value;
+			break;
+		}
+		case LOAD_OPTION_DOUBLE: {
+			double value = strtod(text, &end);
+			if(end == text || *end != '\0') {
+				return -1;
+			}
+			*(double*)option->value = value;
+			break;
+		}
+		case LOAD_OPTION_STRING:
+			*(const char**)option->value = text;
+			break;
+		default:
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+  Applies a file of "name value" lines, e.g. "threads 4" or
+  "--consistency = quorum". Blank lines and # comments are skipped, and a
+  flag on its own line is set. Values are copied and never freed, since
+  string options keep pointers to them.
+*/
+static int parse_config(const char* path, const LoadOption* options, int num_options) {
+	char line[1024];
+	int number = 0;
+	FILE* file = fopen(path, "r");
+
+	if(file == NULL) {
+		fprintf(stderr, "Error: unable to open %s\n", path);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		const LoadOption* option = NULL;
+		char name[128];
+		char* key = line + strspn(line, " \t");
+		char* end = key + strcspn(key, "\r\n");
+		char* value = NULL;
+		char* copy = NULL;
+
+		number++;
+		while(end > key && isspace((unsigned char)end[-1])) {
+			end--;
+		}
+		*end = '\0';
+		if(*key == '\0' || *key == '#') {
+			continue;
+		}
+
+		value = key + strcspn(key, " \t=");
+		if(*value != '\0') {
+			*value++ = '\0';
+			value += strspn(value, " \t=");
+		}
+
+		snprintf(name, sizeof(name), "%s%s", strncmp(key, "--", 2) == 0 ? "" : "--", key);
+		option = find_option(name, options, num_options);
+		if(option == NULL) {
+			fprintf(stderr, "Error: %s line %d: unknown option %s\n", path, number, key);
+			fclose(file);
+			return -1;
+		}
+
+		if(option->type == LOAD_OPTION_FLAG) {
+			*(int*)option->value = strcmp(value, "0") != 0 && strcasecmp(value, "false") != 0 &&
+				strcasecmp(value, "no") != 0;
+			continue;
+		}
+
+		copy = strdup(value);
+		if(copy == NULL || *copy == '\0' || parse_value(option, copy) != 0) {
+			fprintf(stderr, "Error: %s line %d: %s needs a %s value\n", path, number, option->name,
+				option->type == LOAD_OPTION_STRING ? "string" : "numeric");
+			free(copy);
+			fclose(file);
+			return -1;
+		}
+		if(option->type != LOAD_OPTION_STRING) {
+			free(copy);
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+int load_options_parse(int argc, char* argv[], const LoadOption* options, int num_options) {
+	int i;
+
+	for(i = 1; i < argc; ++i) {
+		const LoadOption* option = NULL;
+
+		if(strcmp(argv[i], "--config") == 0) {
+			if(i + 1 >= argc || parse_config(argv[i + 1], options, num_options) != 0) {
+				print_usage(argv[0], options, num_options);
+				return -1;
+			}
+			i++;
+			continue;
+		}
+
+		option = find_option(argv[i], options, num_options);
+		if(option == NULL) {
+			print_usage(argv[0], options, num_options);
+			return -1;
+		}
+
+		if(option->type == LOAD_OPTION_FLAG) {
+			*(int*)option->value = 1;
+			continue;
+		}
+
+		if(i + 1 >= argc || parse_value(option, argv[i + 1]) != 0) {
+			fprintf(stderr, "Error: %s needs a %s value\n", option->name,
+				option->type == LOAD_OPTION_STRING ? "string" : "numeric");
+			print_usage(argv[0], options, num_options);
+			return -1;
+		}
+		i++;
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Table driven command line parsing for the loaders. Each loader lists the
+  options it understands; values are written straight into its variables,
+  which keep their defaults when an option is not given.
+
+  Every program also accepts --config FILE, which applies the options in
+  FILE at that point of the command line, so options given after it win.
+*/
+
+#ifndef LOAD_OPTIONS_H
+#define LOAD_OPTIONS_H
+
+typedef enum LoadOptionType_ {
+	LOAD_OPTION_FLAG,		/* int, set to 1 when present */
+	LOAD_OPTION_INT,		/* int */
+	LOAD_OPTION_DOUBLE,		/* double */
+	LOAD_OPTION_STRING		/* const char* */
+} LoadOptionType;
+
+struct LoadOption_ {
+	const char*		name;		/* e.g. "--threads" */
+	LoadOptionType	type;
+	void*			value;
+	const char*		help;
+} ;
+
+typedef struct LoadOption_ LoadOption;
+
+/* Prints usage and returns -1 for unknown options or malformed values. */
+int load_options_parse(int argc, char* argv[], const LoadOption* options, int num_options);
+
+#endif /* LOAD_OPTIONS_H */
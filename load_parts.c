@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "load_parts.h"
+
+struct PartThread_ {
+	LoadPart		part;
+	LoadPartFn		fn;
+	pthread_t		thread;
+	int				started;
+} ;
+
+typedef struct PartThread_ PartThread;
+
+static void* run_part(void* data) {
+	PartThread* thread = (PartThread*)data;
+
+	thread->fn(&thread->part);
+
+	return NULL;
+}
+
+long load_parts_run(const char* path, int num_parts, LoadCheckpoint* checkpoint,
+					void* context, LoadPartFn fn, int* failed) {
+	PartThread* threads = NULL;
+	long rows = 0;
+	int i;
+
+	*failed = 0;
+
+	if(num_parts < 1) {
+		fprintf(stderr, "Error: --threads must be at least 1\n");
+		*failed = 1;
+		return 0;
+	}
+
+	threads = calloc((size_t)num_parts, sizeof(PartThread));
+	if(threads == NULL) {
+		*failed = 1;
+		return 0;
+	}
+
+	for(i = 0; i < num_parts; ++i) {
+		PartThread* thread = &threads[i];
+
+		thread->fn = fn;
+		thread->part.context = context;
+		thread->part.checkpoint = checkpoint;
+		thread->part.part = i;
+		thread->part.num_parts = num_parts;
+		if(load_rollup_init(&thread->part.rollup) != 0) {
+			fprintf(stderr, "Error: out of memory for the rollup of part %d\n", i);
+			thread->part.failed = 1;
+			continue;
+		}
+		thread->part.reader = flight_reader_open_part(path, i, num_parts);
+		if(thread->part.reader == NULL) {
+			thread->part.failed = 1;
+			continue;
+		}
+		if(checkpoint != NULL) {
+			/* The part starts where its reader does; resuming also skips what the saved offset covers. */
+			load_checkpoint_begin(checkpoint, i, flight_reader_offset(thread->part.reader));
+			if(checkpoint->resume &&
+				flight_reader_seek(thread->part.reader, load_checkpoint_offset(checkpoint, i)) != 0) {
+				thread->part.failed = 1;
+				continue;
+			}
+		}
+
+		if(num_parts == 1) {
+			run_part(thread);
+		} else if(pthread_create(&thread->thread, NULL, run_part, thread) == 0) {
+			thread->started = 1;
+		} else {
+			fprintf(stderr, "Error: unable to start thread for part %d\n", i);
+			thread->part.failed = 1;
+		}
+	}
+
+	for(i = 0; i < num_parts; ++i) {
+		PartThread* thread = &threads[i];
+
+		if(thread->started) {
+			pthread_join(thread->thread, NULL);
+		}
+		if(thread->part.reader != NULL) {
+			flight_reader_close(thread->part.reader);
+		}
+		load_rollup_destroy(&thread->part.rollup);
+
+		rows += thread->part.rows;
+		if(thread->part.failed) {
+			*failed = 1;
+		}
+	}
+
+	free(threads);
+
+	return rows;
+}
@@ -0,0 +1,58 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Runs a loader's per-row work on several threads, each reading its own
+  newline aligned byte range of the input through flight_reader. Workers
+  share whatever the loader puts in context, typically the CassSession and
+  the prepared INSERT, which the driver allows to be used concurrently.
+*/
+
+#ifndef LOAD_PARTS_H
+#define LOAD_PARTS_H
+
+#include "flight_reader.h"
+#include "load_checkpoint.h"
+#include "load_rollup.h"
+
+struct LoadPart_ {
+	void*			context;
+	FlightReader*	reader;
+	LoadCheckpoint*	checkpoint;		/* may be NULL */
+	int				part;
+	int				num_parts;
+	long			rows;
+	int				failed;
+	LoadRollup		rollup;			/* for load_rollup_add() of each row read */
+} ;
+
+typedef struct LoadPart_ LoadPart;
+
+/* Reads rows from part->reader, counting them in part->rows. */
+typedef void (*LoadPartFn)(LoadPart* part);
+
+/*
+  Runs fn once per part, each on its own thread when num_parts > 1, and
+  returns the total row count. *failed is set if any part failed or its
+  range could not be opened. With a checkpoint, each part records where
+  its reader begins, a resumed part skips ahead to its saved offset, and
+  fn publishes its progress through part->checkpoint.
+  Each part's rollup is merged into the process totals once it is done.
+*/
+long load_parts_run(const char* path, int num_parts, LoadCheckpoint* checkpoint,
+					void* context, LoadPartFn fn, int* failed);
+
+#endif /* LOAD_PARTS_H */
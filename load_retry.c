@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flight_schema.h"
+#include "load_retry.h"
+#include "load_stats.h"
+
+static int is_transient(CassError rc) {
+	switch(rc) {
+		case CASS_ERROR_LIB_REQUEST_QUEUE_FULL:
+		case CASS_ERROR_LIB_REQUEST_TIMED_OUT:
+		case CASS_ERROR_LIB_NO_HOSTS_AVAILABLE:
+		case CASS_ERROR_LIB_WRITE_ERROR:
+		case CASS_ERROR_SERVER_OVERLOADED:
+		case CASS_ERROR_SERVER_IS_BOOTSTRAPPING:
+		case CASS_ERROR_SERVER_UNAVAILABLE:
+		case CASS_ERROR_SERVER_WRITE_TIMEOUT:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+int load_retry_init(LoadRetry* retry, int max_retries, double base_delay_ms, double max_delay_ms,
+					const char* reject_path) {
+	if(max_retries < 0 || base_delay_ms < 0.0 || max_delay_ms < base_delay_ms) {
+		fprintf(stderr, "Error: retries and retry delays must not be negative\n");
+		return -1;
+	}
+
+	retry->max_attempts = max_retries + 1;
+	retry->base_delay = (long long)(base_delay_ms * 1e6);
+	retry->max_delay = (long long)(max_delay_ms * 1e6);
+	retry->reject_path = reject_path;
+
+	pthread_mutex_init(&retry->lock, NULL);
+	retry->rejects = NULL;
+	retry->random = (unsigned long long)load_stats_now();
+	retry->retries = 0;
+	retry->rejected = 0;
+
+	return 0;
+}
+
+void load_retry_destroy(LoadRetry* retry) {
+	if(retry->rejects != NULL) {
+		fclose(retry->rejects);
+		retry->rejects = NULL;
+	}
+	pthread_mutex_destroy(&retry->lock);
+}
+
+int load_retry_should_retry(LoadRetry* retry, CassError rc, int attempts) {
+	if(!is_transient(rc) || attempts >= retry->max_attempts) {
+		return 0;
+	}
+
+	__sync_fetch_and_add(&retry->retries, 1);
+	return 1;
+}
+
+long long load_retry_due(LoadRetry* retry, int attempts) {
+	long long delay = retry->base_delay;
+	unsigned long long z = __sync_add_and_fetch(&retry->random, 0x9E3779B97F4A7C15ULL);
+
+	while(--attempts > 0 && delay < retry->max_delay) {
+		delay *= 2;
+	}
+	if(delay > retry->max_delay) {
+		delay = retry->max_delay;
+	}
+
+	/* Half fixed, half random, so retries of a burst of failures spread out. */
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+
+	return load_stats_now() + delay / 2 + (delay > 1 ? (long long)(z % (unsigned long long)(delay / 2 + 1)) : 0);
+}
+
+void load_retry_reject(LoadRetry* retry, const Flight* flight, const char* reason) {
+	pthread_mutex_lock(&retry->lock);
+
+	if(retry->rejects == NULL && retry->reject_path != NULL) {
+		retry->rejects = fopen(retry->reject_path, "a");
+		if(retry->rejects == NULL) {
+			fprintf(stderr, "Error: unable to open reject file %s\n", retry->reject_path);
+			retry->reject_path = NULL;
+		}
+	}
+
+	retry->rejected++;
+	fprintf(stderr, "Error: rejected row %d: %s\n", flight->id, reason);
+
+	if(retry->rejects != NULL) {
+		char* line = malloc(flight_schema_csv_bytes(flight));
+
+		if(line != NULL) {
+			fwrite(line, 1, flight_schema_csv(line, flight), retry->rejects);
+			free(line);
+		}
+	}
+
+	pthread_mutex_unlock(&retry->lock);
+}
+
+void load_retry_report(const LoadRetry* retry) {
+	printf("%ld Retries sent; %ld rows rejected", retry->retries, retry->rejected);
+	if(retry->rejected > 0 && retry->reject_path != NULL) {
+		printf(" to %s", retry->reject_path);
+	}
+	printf(".\n");
+}
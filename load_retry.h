@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Retry policy and reject file shared by the loaders. A failed insert is
+  sent again when its error is transient (timeouts, overload, unavailable
+  replicas, connection trouble) and it has attempts left, after an
+  exponential backoff with jitter. Rows that still fail are appended to
+  the reject file in the input's CSV format, so they can be loaded again
+  on their own. The loaders decide what to keep while a retry waits.
+*/
+
+#ifndef LOAD_RETRY_H
+#define LOAD_RETRY_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+
+#include "flight_reader.h"
+
+struct LoadRetry_ {
+	int					max_attempts;	/* including the first */
+	long long			base_delay;		/* ns before the second attempt */
+	long long			max_delay;
+	const char*			reject_path;
+
+	pthread_mutex_t		lock;
+	FILE*				rejects;		/* opened on the first reject */
+	unsigned long long	random;
+	long				retries;
+	long				rejected;
+} ;
+
+typedef struct LoadRetry_ LoadRetry;
+
+/* Returns 0 or -1 for bad settings. */
+int load_retry_init(LoadRetry* retry, int max_retries, double base_delay_ms, double max_delay_ms,
+					const char* reject_path);
+
+void load_retry_destroy(LoadRetry* retry);
+
+/* True, and counted as a retry, if attempt number attempts failed with rc and may be repeated. */
+int load_retry_should_retry(LoadRetry* retry, CassError rc, int attempts);
+
+/* Monotonic time (see load_stats_now()) at which the attempt after attempts may be sent. */
+long long load_retry_due(LoadRetry* retry, int attempts);
+
+/* Appends flight to the reject file and reports why on stderr. Thread safe. */
+void load_retry_reject(LoadRetry* retry, const Flight* flight, const char* reason);
+
+void load_retry_report(const LoadRetry* retry);
+
+#endif /* LOAD_RETRY_H */
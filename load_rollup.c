@@ -0,0 +1,400 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "load_cluster.h"
+#include "load_rollup.h"
+
+#define INITIAL_CAPACITY 1024
+
+/* Summary rows being inserted at a time. */
+#define WRITE_IN_FLIGHT 64
+
+static const char* create_tables[] = {
+	"DROP TABLE IF EXISTS flights_by_carrier_origin_month;",
+	"CREATE TABLE flights_by_carrier_origin_month ( \
+		carrier varchar, origin varchar, year int, month int, flights bigint, \
+		total_air_time bigint, total_elapsed_time bigint, total_distance bigint, \
+		avg_air_time double, avg_elapsed_time double, avg_distance double, \
+		PRIMARY KEY (carrier, origin, year, month));",
+	"DROP TABLE IF EXISTS flights_by_carrier_month;",
+	"CREATE TABLE flights_by_carrier_month ( \
+		carrier varchar, year int, month int, flights bigint, \
+		total_air_time bigint, total_elapsed_time bigint, total_distance bigint, \
+		avg_air_time double, avg_elapsed_time double, avg_distance double, \
+		PRIMARY KEY (carrier, year, month));"
+};
+
+#define INSERT_BY_ORIGIN "INSERT INTO flights_by_carrier_origin_month \
+							(carrier, origin, year, month, flights, total_air_time, total_elapsed_time, \
+							total_distance, avg_air_time, avg_elapsed_time, avg_distance) \
+							VALUES (?,?,?,?,?,?,?,?,?,?,?);"
+
+#define INSERT_BY_CARRIER "INSERT INTO flights_by_carrier_month \
+							(carrier, year, month, flights, total_air_time, total_elapsed_time, \
+							total_distance, avg_air_time, avg_elapsed_time, avg_distance) \
+							VALUES (?,?,?,?,?,?,?,?,?,?);"
+
+/* Written before any loader thread starts. */
+static int enabled = 0;
+
+/* Merged into from the main thread as load_parts_run() joins each part. */
+static LoadRollup totals = { NULL, 0, 0, 0 };
+static size_t written_by_origin = 0;
+static size_t written_by_carrier = 0;
+
+void load_rollup_set_enabled(int enable) {
+	enabled = enable;
+}
+
+int load_rollup_init(LoadRollup* rollup) {
+	memset(rollup, 0, sizeof(LoadRollup));
+	if(!enabled) {
+		return 0;
+	}
+	rollup->groups = calloc(INITIAL_CAPACITY, sizeof(LoadRollupGroup));
+	if(rollup->groups == NULL) {
+		return -1;
+	}
+	rollup->capacity = INITIAL_CAPACITY;
+	return 0;
+}
+
+static unsigned hash_key(const char* carrier, size_t carrier_length, const char* origin, size_t origin_length,
+							int year, int month) {
+	unsigned hash = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < carrier_length; ++i) {
+		hash = (hash ^ (unsigned char)carrier[i]) * 16777619u;
+	}
+	hash = (hash ^ 0xffu) * 16777619u;
+	for(i = 0; i < origin_length; ++i) {
+		hash = (hash ^ (unsigned char)origin[i]) * 16777619u;
+	}
+	hash = (hash ^ (unsigned)year) * 16777619u;
+	hash = (hash ^ (unsigned)month) * 16777619u;
+
+	return hash != 0 ? hash : 1;
+}
+
+/* Doubles the table; existing groups keep their hashes. */
+static int grow(LoadRollup* rollup) {
+	size_t capacity = rollup->capacity * 2;
+	LoadRollupGroup* groups = calloc(capacity, sizeof(LoadRollupGroup));
+	size_t i;
+
+	if(groups == NULL) {
+		return -1;
+	}
+	for(i = 0; i < rollup->capacity; ++i) {
+		size_t slot = 0;
+
+		if(rollup->groups[i].hash == 0) {
+			continue;
+		}
+		slot = rollup->groups[i].hash & (capacity - 1);
+		while(groups[slot].hash != 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		groups[slot] = rollup->groups[i];
+	}
+	free(rollup->groups);
+	rollup->groups = groups;
+	rollup->capacity = capacity;
+	return 0;
+}
+
+/* Returns the group of a key, adding an empty one if it is new, or NULL if the table cannot grow. */
+static LoadRollupGroup* find_group(LoadRollup* rollup, const char* carrier, size_t carrier_length,
+									const char* origin, size_t origin_length, int year, int month) {
+	unsigned hash = hash_key(carrier, carrier_length, origin, origin_length, year, month);
+	size_t slot = hash & (rollup->capacity - 1);
+	LoadRollupGroup* group = NULL;
+
+	for(;;) {
+		group = &rollup->groups[slot];
+		if(group->hash == 0) {
+			break;
+		}
+		if(group->hash == hash && group->year == year && group->month == month &&
+			group->carrier_length == carrier_length && group->origin_length == origin_length &&
+			memcmp(group->carrier, carrier, carrier_length) == 0 &&
+			memcmp(group->origin, origin, origin_length) == 0) {
+			return group;
+		}
+		slot = (slot + 1) & (rollup->capacity - 1);
+	}
+
+	/* Keep the table at most three quarters full. */
+	if((rollup->count + 1) * 4 > rollup->capacity * 3) {
+		if(grow(rollup) != 0) {
+			return NULL;
+		}
+		return find_group(rollup, carrier, carrier_length, origin, origin_length, year, month);
+	}
+
+	group->hash = hash;
+	group->carrier_length = (unsigned char)carrier_length;
+	group->origin_length = (unsigned char)origin_length;
+	memcpy(group->carrier, carrier, carrier_length);
+	memcpy(group->origin, origin, origin_length);
+	group->year = year;
+	group->month = month;
+	rollup->count++;
+	return group;
+}
+
+/* The month of a YYYY-MM-DD fl_date, or 0. */
+static int flight_month(const FlightString* fl_date) {
+	const char* date = fl_date->data;
+	int month = 0;
+
+	if(fl_date->length >= 7 && date[4] == '-' &&
+		date[5] >= '0' && date[5] <= '1' && date[6] >= '0' && date[6] <= '9') {
+		month = (date[5] - '0') * 10 + (date[6] - '0');
+	}
+	return month <= 12 ? month : 0;
+}
+
+static void add_totals(LoadRollupGroup* group, long flights, long long air_time, long long elapsed_time,
+						long long distance) {
+	group->flights += flights;
+	group->air_time += air_time;
+	group->elapsed_time += elapsed_time;
+	group->distance += distance;
+}
+
+void load_rollup_add(LoadRollup* rollup, const Flight* flight) {
+	LoadRollupGroup* group = NULL;
+
+	if(rollup->groups == NULL) {
+		return;
+	}
+	if(flight->carrier.length > LOAD_ROLLUP_KEY_SIZE || flight->origin.length > LOAD_ROLLUP_KEY_SIZE) {
+		rollup->skipped++;
+		return;
+	}
+
+	group = find_group(rollup, flight->carrier.data, flight->carrier.length,
+		flight->origin.data, flight->origin.length, flight->year, flight_month(&flight->fl_date));
+	if(group == NULL) {
+		rollup->skipped++;
+		return;
+	}
+	add_totals(group, 1, flight->air_time, flight->actual_elapsed_time, flight->distance);
+}
+
+/* Adds every group of from to into; returns the number of rows that could not be added. */
+static long merge(LoadRollup* into, const LoadRollup* from, int by_origin) {
+	long lost = 0;
+	size_t i;
+
+	for(i = 0; i < from->capacity; ++i) {
+		const LoadRollupGroup* source = &from->groups[i];
+		LoadRollupGroup* group = NULL;
+
+		if(source->hash == 0) {
+			continue;
+		}
+		group = find_group(into, source->carrier, source->carrier_length,
+			source->origin, by_origin ? source->origin_length : 0, source->year, source->month);
+		if(group == NULL) {
+			lost += source->flights;
+			continue;
+		}
+		add_totals(group, source->flights, source->air_time, source->elapsed_time, source->distance);
+	}
+	return lost;
+}
+
+void load_rollup_destroy(LoadRollup* rollup) {
+	if(rollup->groups == NULL) {
+		return;
+	}
+
+	if(totals.groups == NULL && load_rollup_init(&totals) != 0) {
+		fprintf(stderr, "Error: out of memory for the rollup totals\n");
+		totals.skipped += rollup->skipped;
+	} else {
+		totals.skipped += rollup->skipped + merge(&totals, rollup, 1);
+	}
+
+	free(rollup->groups);
+	rollup->groups = NULL;
+}
+
+int load_rollup_create_tables(CassSession* session) {
+	size_t i;
+
+	for(i = 0; i < sizeof(create_tables) / sizeof(create_tables[0]); ++i) {
+		if(load_cluster_execute(session, create_tables[i]) != CASS_OK) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static const CassPrepared* prepare(CassSession* session, const char* query) {
+	CassFuture* future = cass_session_prepare(session, cass_string_init(query));
+	const CassPrepared* prepared = NULL;
+
+	cass_future_wait(future);
+	if(cass_future_error_code(future) == CASS_OK) {
+		prepared = cass_future_get_prepared(future);
+	} else {
+		CassString message = cass_future_error_message(future);
+		fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+	}
+	cass_future_free(future);
+	return prepared;
+}
+
+static void bind_group(CassStatement* statement, const LoadRollupGroup* group, int by_origin) {
+	double flights = (double)group->flights;
+	size_t i = 0;
+
+	cass_statement_bind_string(statement, i++, cass_string_init2(group->carrier, group->carrier_length));
+	if(by_origin) {
+		cass_statement_bind_string(statement, i++, cass_string_init2(group->origin, group->origin_length));
+	}
+	cass_statement_bind_int32(statement, i++, group->year);
+	cass_statement_bind_int32(statement, i++, group->month);
+	cass_statement_bind_int64(statement, i++, group->flights);
+	cass_statement_bind_int64(statement, i++, group->air_time);
+	cass_statement_bind_int64(statement, i++, group->elapsed_time);
+	cass_statement_bind_int64(statement, i++, group->distance);
+	cass_statement_bind_double(statement, i++, (double)group->air_time / flights);
+	cass_statement_bind_double(statement, i++, (double)group->elapsed_time / flights);
+	cass_statement_bind_double(statement, i++, (double)group->distance / flights);
+}
+
+/*
+  A ring of requests in flight: a slot is reused once the request sent
+  from it has completed, so at most size are outstanding.
+*/
+struct WriteWindow_ {
+	CassSession*	session;
+	CassStatement**	statements;
+	CassFuture**	futures;
+	int				size;
+	int				next;
+	int				failed;
+} ;
+
+typedef struct WriteWindow_ WriteWindow;
+
+static void window_finish(WriteWindow* window, int slot) {
+	if(window->futures[slot] == NULL) {
+		return;
+	}
+
+	cass_future_wait(window->futures[slot]);
+	if(cass_future_error_code(window->futures[slot]) != CASS_OK) {
+		CassString message = cass_future_error_message(window->futures[slot]);
+		fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+		window->failed = 1;
+	}
+	cass_future_free(window->futures[slot]);
+	cass_statement_free(window->statements[slot]);
+	window->futures[slot] = NULL;
+	window->statements[slot] = NULL;
+}
+
+static void window_send(WriteWindow* window, const CassPrepared* prepared, const LoadRollupGroup* group,
+						int by_origin) {
+	int slot = window->next;
+
+	window_finish(window, slot);
+	window->statements[slot] = cass_prepared_bind(prepared);
+	load_cluster_apply(window->statements[slot]);
+	bind_group(window->statements[slot], group, by_origin);
+	window->futures[slot] = cass_session_execute(window->session, window->statements[slot]);
+	window->next = (slot + 1) % window->size;
+}
+
+/* Sends every group of the totals, and of the totals by carrier that come from them. */
+static void write_totals(WriteWindow* window, const CassPrepared* by_origin, const CassPrepared* by_carrier) {
+	LoadRollup carriers;
+	size_t i;
+	int slot;
+
+	if(load_rollup_init(&carriers) != 0 || merge(&carriers, &totals, 0) != 0) {
+		fprintf(stderr, "Error: out of memory for the carrier rollups\n");
+		window->failed = 1;
+	}
+
+	for(i = 0; i < totals.capacity; ++i) {
+		if(totals.groups[i].hash != 0) {
+			window_send(window, by_origin, &totals.groups[i], 1);
+			written_by_origin++;
+		}
+	}
+	for(i = 0; i < carriers.capacity; ++i) {
+		if(carriers.groups[i].hash != 0) {
+			window_send(window, by_carrier, &carriers.groups[i], 0);
+			written_by_carrier++;
+		}
+	}
+	for(slot = 0; slot < window->size; ++slot) {
+		window_finish(window, slot);
+	}
+
+	free(carriers.groups);
+}
+
+int load_rollup_write(CassSession* session) {
+	const CassPrepared* by_origin = NULL;
+	const CassPrepared* by_carrier = NULL;
+	WriteWindow window;
+
+	if(totals.groups == NULL) {
+		return 0;
+	}
+
+	memset(&window, 0, sizeof(window));
+	window.session = session;
+	window.size = WRITE_IN_FLIGHT;
+	window.statements = calloc((size_t)window.size, sizeof(CassStatement*));
+	window.futures = calloc((size_t)window.size, sizeof(CassFuture*));
+	by_origin = prepare(session, INSERT_BY_ORIGIN);
+	by_carrier = prepare(session, INSERT_BY_CARRIER);
+
+	if(by_origin != NULL && by_carrier != NULL && window.statements != NULL && window.futures != NULL) {
+		write_totals(&window, by_origin, by_carrier);
+	} else {
+		window.failed = 1;
+	}
+
+	free(window.statements);
+	free(window.futures);
+	if(by_origin != NULL) {
+		cass_prepared_free(by_origin);
+	}
+	if(by_carrier != NULL) {
+		cass_prepared_free(by_carrier);
+	}
+	return window.failed ? -1 : 0;
+}
+
+void load_rollup_report() {
+	printf("Rollups: %lu carrier, origin and month groups and %lu carrier and month groups written",
+		(unsigned long)written_by_origin, (unsigned long)written_by_carrier);
+	printf(", %ld rows left out.\n", totals.skipped);
+}
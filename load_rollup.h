@@ -0,0 +1,95 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Summaries computed during the load, so they need no second scan of
+  flights: per carrier, origin and month, the number of flights and the
+  totals of air_time, actual_elapsed_time and distance, written with their
+  averages to flights_by_carrier_origin_month, and the same per carrier
+  and month to flights_by_carrier_month.
+
+  Every part of the load adds the rows it reads to a rollup of its own,
+  a hash table no other thread touches. load_parts_run() sets them up and
+  merges each into the process totals when its part is done, and the
+  loader writes the totals with load_rollup_write() at the end of the
+  input. The rollups count every row that was read, including any the
+  cluster then rejected, and cover the whole input only when the load
+  starts from its beginning, so a loader refuses --rollup with --resume.
+*/
+
+#ifndef LOAD_ROLLUP_H
+#define LOAD_ROLLUP_H
+
+#include <stddef.h>
+
+#include "cassandra.h"
+
+#include "flight_reader.h"
+
+/* Longest carrier or origin kept in a key; longer ones are counted as skipped. */
+#define LOAD_ROLLUP_KEY_SIZE 15
+
+struct LoadRollupGroup_ {
+	unsigned		hash;			/* 0 for an empty slot */
+	unsigned char	carrier_length;
+	unsigned char	origin_length;
+	char			carrier[LOAD_ROLLUP_KEY_SIZE];
+	char			origin[LOAD_ROLLUP_KEY_SIZE];
+	int				year;
+	int				month;			/* 0 when fl_date has none */
+	long			flights;
+	long long		air_time;
+	long long		elapsed_time;
+	long long		distance;
+} ;
+
+typedef struct LoadRollupGroup_ LoadRollupGroup;
+
+struct LoadRollup_ {
+	LoadRollupGroup*	groups;		/* NULL when rollups are off */
+	size_t				capacity;	/* a power of two */
+	size_t				count;
+	long				skipped;
+} ;
+
+typedef struct LoadRollup_ LoadRollup;
+
+/* Makes rollups initialized from now on collect rows (1) or ignore them (0, the default). */
+void load_rollup_set_enabled(int enabled);
+
+/* Returns 0, or -1 if there is no memory for the table. */
+int load_rollup_init(LoadRollup* rollup);
+
+/* Adds one row; does nothing when rollups are off. */
+void load_rollup_add(LoadRollup* rollup, const Flight* flight);
+
+/* Merges rollup into the process totals and frees it. Not thread safe. */
+void load_rollup_destroy(LoadRollup* rollup);
+
+/* Drops and creates the summary tables in the current keyspace. Returns 0 or -1. */
+int load_rollup_create_tables(CassSession* session);
+
+/*
+  Inserts the process totals into the summary tables through prepared
+  statements, a window of requests at a time. Returns 0, or -1 if any
+  insert failed.
+*/
+int load_rollup_write(CassSession* session);
+
+/* Prints how many groups were collected and written. */
+void load_rollup_report();
+
+#endif /* LOAD_ROLLUP_H */
@@ -0,0 +1,220 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "latency_histogram.h"
+#include "load_stats.h"
+
+#define MAX_ERROR_CODES 16
+
+struct StageTotal_ {
+	long long		nanos;
+	long			count;
+} ;
+
+typedef struct StageTotal_ StageTotal;
+
+/* One slot per distinct error code, claimed with a compare and swap; code 0 (CASS_OK) is free. */
+struct ErrorCount_ {
+	int				code;
+	long			count;
+} ;
+
+typedef struct ErrorCount_ ErrorCount;
+
+static const char* stage_names[LOAD_STAGE_COUNT] = { "parse", "bind", "submit", "await" };
+
+static LatencyHistogram requests;
+static StageTotal stages[LOAD_STAGE_COUNT];
+static ErrorCount errors[MAX_ERROR_CODES];
+static long failed = 0;
+static long long started = 0;
+
+static pthread_t reporter;
+static pthread_mutex_t reporter_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reporter_wake = PTHREAD_COND_INITIALIZER;
+static int reporter_running = 0;
+static int reporter_stopping = 0;
+static double reporter_interval = 0.0;
+
+long long load_stats_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long load_stats_stage(LoadStage stage, long long start) {
+	long long now = load_stats_now();
+
+	__sync_fetch_and_add(&stages[stage].nanos, now - start);
+	__sync_fetch_and_add(&stages[stage].count, 1);
+
+	return now;
+}
+
+int load_stats_next(FlightReader* reader, Flight* flight) {
+	long long start = load_stats_now();
+	int more = flight_reader_next(reader, flight);
+
+	if(more) {
+		load_stats_stage(LOAD_STAGE_PARSE, start);
+	}
+	return more;
+}
+
+static void count_error(CassError rc) {
+	int i;
+
+	__sync_fetch_and_add(&failed, 1);
+
+	for(i = 0; i < MAX_ERROR_CODES; ++i) {
+		int code = errors[i].code;
+
+		if(code == 0) {
+			code = __sync_val_compare_and_swap(&errors[i].code, 0, (int)rc);
+			if(code == 0) {
+				code = (int)rc;
+			}
+		}
+		if(code == (int)rc) {
+			__sync_fetch_and_add(&errors[i].count, 1);
+			return;
+		}
+	}
+}
+
+void load_stats_request(long long start, CassError rc) {
+	latency_histogram_record(&requests, load_stats_now() - start);
+
+	if(rc != CASS_OK) {
+		count_error(rc);
+	}
+}
+
+static void print_line(const LatencyHistogram* interval, long rows, double seconds, double elapsed) {
+	fprintf(stderr, "stats %.1fs rows %ld (%.0f/s) requests %ld (%.0f/s) latency ms p50 %.2f p99 %.2f p999 %.2f max %.2f failed %ld\n",
+		elapsed, rows, rows / seconds, interval->count, interval->count / seconds,
+		latency_histogram_percentile(interval, 50.0) / 1e6,
+		latency_histogram_percentile(interval, 99.0) / 1e6,
+		latency_histogram_percentile(interval, 99.9) / 1e6,
+		latency_histogram_percentile(interval, 100.0) / 1e6, failed);
+}
+
+/* Prints the requests of each interval rather than the running totals. */
+static void* report_periodically(void* data) {
+	static LatencyHistogram last, current, interval;
+	long long previous = load_stats_now();
+	long last_rows = 0;
+
+	(void)data;
+	latency_histogram_init(&last);
+
+	pthread_mutex_lock(&reporter_lock);
+	while(!reporter_stopping) {
+		struct timespec deadline;
+		long long now = 0;
+		long rows = 0;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)reporter_interval;
+		deadline.tv_nsec += (long)((reporter_interval - (long)reporter_interval) * 1e9);
+		if(deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while(!reporter_stopping &&
+			pthread_cond_timedwait(&reporter_wake, &reporter_lock, &deadline) != ETIMEDOUT) {
+		}
+		if(reporter_stopping) {
+			break;
+		}
+
+		now = load_stats_now();
+		latency_histogram_copy(&current, &requests);
+		latency_histogram_copy(&interval, &current);
+		latency_histogram_subtract(&interval, &last);
+		latency_histogram_copy(&last, &current);
+		rows = stages[LOAD_STAGE_PARSE].count;
+
+		print_line(&interval, rows - last_rows, (now - previous) / 1e9, (now - started) / 1e9);
+		previous = now;
+		last_rows = rows;
+	}
+	pthread_mutex_unlock(&reporter_lock);
+
+	return NULL;
+}
+
+void load_stats_start(double interval) {
+	latency_histogram_init(&requests);
+	memset(stages, 0, sizeof(stages));
+	memset(errors, 0, sizeof(errors));
+	failed = 0;
+	started = load_stats_now();
+
+	if(interval > 0.0 && !reporter_running) {
+		reporter_interval = interval;
+		reporter_stopping = 0;
+		reporter_running = pthread_create(&reporter, NULL, report_periodically, NULL) == 0;
+	}
+}
+
+void load_stats_stop() {
+	if(!reporter_running) {
+		return;
+	}
+
+	pthread_mutex_lock(&reporter_lock);
+	reporter_stopping = 1;
+	pthread_cond_signal(&reporter_wake);
+	pthread_mutex_unlock(&reporter_lock);
+
+	pthread_join(reporter, NULL);
+	reporter_running = 0;
+}
+
+void load_stats_report() {
+	double elapsed = (load_stats_now() - started) / 1e9;
+	long long total = 0;
+	int i;
+
+	printf("Requests %ld in %.3f seconds; latency ms mean %.2f p50 %.2f p90 %.2f p99 %.2f p999 %.2f max %.2f\n",
+		requests.count, elapsed, latency_histogram_mean(&requests) / 1e6,
+		latency_histogram_percentile(&requests, 50.0) / 1e6,
+		latency_histogram_percentile(&requests, 90.0) / 1e6,
+		latency_histogram_percentile(&requests, 99.0) / 1e6,
+		latency_histogram_percentile(&requests, 99.9) / 1e6,
+		requests.max / 1e6);
+
+	for(i = 0; i < LOAD_STAGE_COUNT; ++i) {
+		total += stages[i].nanos;
+	}
+	for(i = 0; i < LOAD_STAGE_COUNT; ++i) {
+		printf("Stage %-6s %10.3f s %5.1f%% %10ld calls %9.2f us/call\n", stage_names[i],
+			stages[i].nanos / 1e9, total > 0 ? 100.0 * stages[i].nanos / total : 0.0, stages[i].count,
+			stages[i].count > 0 ? stages[i].nanos / 1e3 / stages[i].count : 0.0);
+	}
+
+	printf("%ld Requests failed.\n", failed);
+	for(i = 0; i < MAX_ERROR_CODES && errors[i].code != 0; ++i) {
+		printf("  %ld x %s\n", errors[i].count, cass_error_desc((CassError)errors[i].code));
+	}
+}
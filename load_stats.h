@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Process wide instrumentation for the loaders: a latency histogram of
+  every insert request (a row, or a whole batch), the time spent in each
+  stage of the load, and failed requests by error code. All of it is
+  lock free, so every loader thread and driver callback records into the
+  same counters. load_stats_start() resets them and can print a stats line
+  to stderr periodically; load_stats_report() prints the totals.
+
+  A typical synchronous insert:
+
+    long long start = load_stats_now();
+    future = cass_session_execute(session, statement);
+    long long t = load_stats_stage(LOAD_STAGE_SUBMIT, start);
+    cass_future_wait(future);
+    load_stats_stage(LOAD_STAGE_AWAIT, t);
+    load_stats_request(start, cass_future_error_code(future));
+*/
+
+#ifndef LOAD_STATS_H
+#define LOAD_STATS_H
+
+#include "cassandra.h"
+
+#include "flight_reader.h"
+
+typedef enum LoadStage_ {
+	LOAD_STAGE_PARSE,		/* reading and splitting a row */
+	LOAD_STAGE_BIND,		/* binding a row, or formatting its CQL */
+	LOAD_STAGE_SUBMIT,		/* handing a request to the driver */
+	LOAD_STAGE_AWAIT,		/* waiting for requests, or for room to send more */
+	LOAD_STAGE_COUNT
+} LoadStage;
+
+/* Monotonic time in nanoseconds. */
+long long load_stats_now();
+
+/* Adds the time since start to stage and returns the current time. */
+long long load_stats_stage(LoadStage stage, long long start);
+
+/* flight_reader_next(), timed as LOAD_STAGE_PARSE. */
+int load_stats_next(FlightReader* reader, Flight* flight);
+
+/* Records the latency of a request submitted at start and counts it if it failed. */
+void load_stats_request(long long start, CassError rc);
+
+/*
+  Clears everything recorded so far (e.g. schema setup) and, when interval
+  is positive, prints a stats line every interval seconds until
+  load_stats_stop().
+*/
+void load_stats_start(double interval);
+
+void load_stats_stop();
+
+/* Prints request latency, the time spent in each stage and failures. */
+void load_stats_report();
+
+#endif /* LOAD_STATS_H */
@@ -0,0 +1,215 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "flight_schema.h"
+#include "load_cluster.h"
+#include "load_targets.h"
+
+#define TARGET_COLUMN(name, ...) #name,
+
+static const char* column_names[] = { FLIGHT_SCHEMA(TARGET_COLUMN, TARGET_COLUMN, TARGET_COLUMN) };
+
+static int is_column(const char* name, size_t length) {
+	size_t i;
+
+	for(i = 0; i < sizeof(column_names) / sizeof(column_names[0]); ++i) {
+		if(strlen(column_names[i]) == length && strncmp(column_names[i], name, length) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int is_identifier(const char* name, size_t length) {
+	size_t i;
+
+	if(length == 0 || isdigit((unsigned char)name[0])) {
+		return 0;
+	}
+	for(i = 0; i < length; ++i) {
+		if(!isalnum((unsigned char)name[i]) && name[i] != '_') {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Checks a comma separated list of columns; sets *has_id if id is one of them. */
+static int check_columns(const char* list, size_t length, const char* table, int* has_id) {
+	const char* end = list + length;
+
+	if(length == 0) {
+		fprintf(stderr, "Error: target %s needs at least one partition column\n", table);
+		return -1;
+	}
+	while(list < end) {
+		const char* comma = memchr(list, ',', (size_t)(end - list));
+		size_t n = (size_t)((comma != NULL ? comma : end) - list);
+
+		if(!is_column(list, n)) {
+			fprintf(stderr, "Error: target %s: %.*s is not a column of flights\n", table, (int)n, list);
+			return -1;
+		}
+		if(n == 2 && strncmp(list, "id", 2) == 0) {
+			*has_id = 1;
+		}
+		list += n + (comma != NULL ? 1 : 0);
+	}
+	return 0;
+}
+
+/* Parses one TABLE:PARTITION[:CLUSTERING] of length bytes. */
+static int parse_target(LoadTarget* target, const char* spec, size_t length) {
+	const char* end = spec + length;
+	const char* partition = memchr(spec, ':', length);
+	const char* clustering = NULL;
+	size_t partition_length = 0, clustering_length = 0;
+	int has_id = 0;
+	int n = 0;
+
+	memset(target, 0, sizeof(LoadTarget));
+	if(partition == NULL || !is_identifier(spec, (size_t)(partition - spec)) ||
+		(size_t)(partition - spec) >= sizeof(target->table)) {
+		fprintf(stderr, "Error: target %.*s must be TABLE:PARTITION_COLUMNS[:CLUSTERING_COLUMNS]\n",
+			(int)length, spec);
+		return -1;
+	}
+	memcpy(target->table, spec, (size_t)(partition - spec));
+	if(strcmp(target->table, "flights") == 0) {
+		fprintf(stderr, "Error: flights is always loaded and cannot be a target\n");
+		return -1;
+	}
+
+	partition++;
+	clustering = memchr(partition, ':', (size_t)(end - partition));
+	partition_length = (size_t)((clustering != NULL ? clustering : end) - partition);
+	if(clustering != NULL) {
+		clustering++;
+		clustering_length = (size_t)(end - clustering);
+	}
+
+	if(check_columns(partition, partition_length, target->table, &has_id) != 0 ||
+		(clustering_length > 0 && check_columns(clustering, clustering_length, target->table, &has_id) != 0)) {
+		return -1;
+	}
+
+	n = snprintf(target->primary_key, sizeof(target->primary_key), "(%.*s)%s%.*s%s",
+		(int)partition_length, partition, clustering_length > 0 ? ", " : "",
+		(int)clustering_length, clustering != NULL ? clustering : "", has_id ? "" : ", id");
+	if(n < 0 || (size_t)n >= sizeof(target->primary_key)) {
+		fprintf(stderr, "Error: the key of target %s is too long\n", target->table);
+		return -1;
+	}
+	return 0;
+}
+
+int load_targets_parse(LoadTargets* targets, const char* spec) {
+	memset(targets, 0, sizeof(LoadTargets));
+	if(spec == NULL) {
+		return 0;
+	}
+
+	for(;;) {
+		size_t length = 0;
+		int i;
+
+		spec += strspn(spec, " \t");
+		if(*spec == '\0') {
+			return 0;
+		}
+		length = strcspn(spec, " \t");
+		if(targets->count == LOAD_TARGETS_MAX) {
+			fprintf(stderr, "Error: at most %d targets\n", LOAD_TARGETS_MAX);
+			return -1;
+		}
+		if(parse_target(&targets->targets[targets->count], spec, length) != 0) {
+			return -1;
+		}
+		for(i = 0; i < targets->count; ++i) {
+			if(strcmp(targets->targets[i].table, targets->targets[targets->count].table) == 0) {
+				fprintf(stderr, "Error: target %s is listed twice\n", targets->targets[i].table);
+				return -1;
+			}
+		}
+		targets->count++;
+		spec += length;
+	}
+}
+
+int load_targets_prepare(LoadTargets* targets, CassSession* session, int drop) {
+	char query[1024];
+	int i;
+
+	for(i = 0; i < targets->count; ++i) {
+		LoadTarget* target = &targets->targets[i];
+		CassFuture* future = NULL;
+
+		if(drop) {
+			snprintf(query, sizeof(query), "DROP TABLE IF EXISTS %s;", target->table);
+			if(load_cluster_execute(session, query) != CASS_OK) {
+				return -1;
+			}
+		}
+		snprintf(query, sizeof(query), "CREATE TABLE IF NOT EXISTS %s (" FLIGHT_SCHEMA_DEFINITIONS "PRIMARY KEY (%s));",
+			target->table, target->primary_key);
+		if(load_cluster_execute(session, query) != CASS_OK) {
+			return -1;
+		}
+
+		if(flight_schema_insert(query, sizeof(query), target->table) != 0) {
+			return -1;
+		}
+		future = cass_session_prepare(session, cass_string_init(query));
+		cass_future_wait(future);
+		if(cass_future_error_code(future) == CASS_OK) {
+			target->prepared = cass_future_get_prepared(future);
+		} else {
+			CassString message = cass_future_error_message(future);
+			fprintf(stderr, "Error: %.*s\n", (int)message.length, message.data);
+		}
+		cass_future_free(future);
+		if(target->prepared == NULL) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void load_targets_free(LoadTargets* targets) {
+	int i;
+
+	for(i = 0; i < targets->count; ++i) {
+		if(targets->targets[i].prepared != NULL) {
+			cass_prepared_free(targets->targets[i].prepared);
+			targets->targets[i].prepared = NULL;
+		}
+	}
+}
+
+void load_targets_report(const LoadTargets* targets) {
+	int i;
+
+	for(i = 0; i < targets->count; ++i) {
+		const LoadTarget* target = &targets->targets[i];
+		printf("Target %s, PRIMARY KEY (%s): %ld rows inserted, %ld rejected.\n",
+			target->table, target->primary_key, target->inserted, target->rejected);
+	}
+}
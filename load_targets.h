@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Extra tables a load writes every row to, each with the columns of
+  flights under a primary key of its own, for readers that look flights
+  up by something other than (carrier, origin, air_time_grp). They are
+  listed in one option, separated by spaces, as
+
+    TABLE:PARTITION_COLUMNS[:CLUSTERING_COLUMNS]
+
+  with comma separated column lists, e.g.
+
+    --targets "flights_by_dest:dest,fl_date flights_by_flight:airline_id,fl_num:fl_date"
+
+  id is added to the clustering columns when it is not in the key, so
+  every flight stays a row of its own. All targets take the INSERT of
+  flights with its columns in the same order, so flight_binder binds a
+  row to any of them.
+*/
+
+#ifndef LOAD_TARGETS_H
+#define LOAD_TARGETS_H
+
+#include "cassandra.h"
+
+#define LOAD_TARGETS_MAX 8
+
+struct LoadTarget_ {
+	char				table[64];
+	char				primary_key[256];	/* as it goes in PRIMARY KEY (...) */
+	const CassPrepared*	prepared;
+	long				inserted;			/* added to by driver callbacks */
+	long				rejected;
+} ;
+
+typedef struct LoadTarget_ LoadTarget;
+
+struct LoadTargets_ {
+	LoadTarget	targets[LOAD_TARGETS_MAX];
+	int			count;
+} ;
+
+typedef struct LoadTargets_ LoadTargets;
+
+/* Parses spec, which may be NULL for none. Returns 0, or -1 with the reason on stderr. */
+int load_targets_parse(LoadTargets* targets, const char* spec);
+
+/*
+  Creates the tables in the current keyspace, dropping them first when
+  drop is set, and prepares their INSERTs. Returns 0 or -1.
+*/
+int load_targets_prepare(LoadTargets* targets, CassSession* session, int drop);
+
+void load_targets_free(LoadTargets* targets);
+
+/* Prints the rows inserted into and rejected by each target. */
+void load_targets_report(const LoadTargets* targets);
+
+#endif /* LOAD_TARGETS_H */
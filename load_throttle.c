@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "load_stats.h"
+#include "load_throttle.h"
+
+/* A bucket holds up to this many seconds of tokens. */
+#define BURST_SECONDS 0.1
+
+static void bucket_init(TokenBucket* bucket, double rate) {
+	bucket->rate = rate;
+	bucket->burst = rate * BURST_SECONDS;
+	bucket->tokens = bucket->burst;
+	bucket->updated = load_stats_now();
+}
+
+/* Takes amount tokens and returns how long to sleep, in nanoseconds, to repay any overdraft. */
+static long long bucket_take(TokenBucket* bucket, double amount, long long now) {
+	if(bucket->rate <= 0.0) {
+		return 0;
+	}
+
+	bucket->tokens += (now - bucket->updated) * bucket->rate / 1e9;
+	if(bucket->tokens > bucket->burst) {
+		bucket->tokens = bucket->burst;
+	}
+	bucket->updated = now;
+
+	bucket->tokens -= amount;
+	return bucket->tokens < 0.0 ? (long long)(-bucket->tokens / bucket->rate * 1e9) : 0;
+}
+
+static int is_overload(CassError rc) {
+	return rc == CASS_ERROR_SERVER_WRITE_TIMEOUT ||
+		rc == CASS_ERROR_SERVER_OVERLOADED ||
+		rc == CASS_ERROR_LIB_REQUEST_TIMED_OUT ||
+		rc == CASS_ERROR_LIB_REQUEST_QUEUE_FULL;
+}
+
+int load_throttle_init(LoadThrottle* throttle, double rows_per_sec, double bytes_per_sec, int max_in_flight) {
+	if(rows_per_sec < 0.0 || bytes_per_sec < 0.0 || max_in_flight < 1) {
+		fprintf(stderr, "Error: throttle rates must not be negative and in flight must be at least 1\n");
+		return -1;
+	}
+
+	pthread_mutex_init(&throttle->lock, NULL);
+	pthread_cond_init(&throttle->slot_freed, NULL);
+	bucket_init(&throttle->rows, rows_per_sec);
+	bucket_init(&throttle->bytes, bytes_per_sec);
+
+	throttle->in_flight = 0;
+	throttle->limit = max_in_flight;
+	throttle->max_limit = max_in_flight;
+	throttle->completions = 0;
+	throttle->successes = 0;
+	throttle->reduce_after = 0;
+	throttle->reductions = 0;
+	throttle->min_seen = max_in_flight;
+	throttle->rate_wait_nanos = 0;
+
+	return 0;
+}
+
+void load_throttle_destroy(LoadThrottle* throttle) {
+	pthread_cond_destroy(&throttle->slot_freed);
+	pthread_mutex_destroy(&throttle->lock);
+}
+
+void load_throttle_rate(LoadThrottle* throttle, long rows, size_t bytes) {
+	long long now = 0, wait = 0, bytes_wait = 0;
+
+	if(throttle->rows.rate <= 0.0 && throttle->bytes.rate <= 0.0) {
+		return;
+	}
+
+	now = load_stats_now();
+	pthread_mutex_lock(&throttle->lock);
+	wait = bucket_take(&throttle->rows, (double)rows, now);
+	bytes_wait = bucket_take(&throttle->bytes, (double)bytes, now);
+	if(bytes_wait > wait) {
+		wait = bytes_wait;
+	}
+	throttle->rate_wait_nanos += wait;
+	pthread_mutex_unlock(&throttle->lock);
+
+	if(wait > 0) {
+		struct timespec ts;
+		ts.tv_sec = (time_t)(wait / 1000000000LL);
+		ts.tv_nsec = (long)(wait % 1000000000LL);
+		nanosleep(&ts, NULL);
+	}
+}
+
+void load_throttle_begin(LoadThrottle* throttle) {
+	pthread_mutex_lock(&throttle->lock);
+	while(throttle->in_flight >= throttle->limit) {
+		pthread_cond_wait(&throttle->slot_freed, &throttle->lock);
+	}
+	throttle->in_flight++;
+	pthread_mutex_unlock(&throttle->lock);
+}
+
+void load_throttle_end(LoadThrottle* throttle, CassError rc) {
+	pthread_mutex_lock(&throttle->lock);
+	throttle->in_flight--;
+	throttle->completions++;
+
+	if(is_overload(rc)) {
+		if(throttle->completions > throttle->reduce_after) {
+			throttle->limit = throttle->limit > 1 ? throttle->limit / 2 : 1;
+			throttle->reduce_after = throttle->completions + throttle->in_flight;
+			throttle->successes = 0;
+			throttle->reductions++;
+			if(throttle->limit < throttle->min_seen) {
+				throttle->min_seen = throttle->limit;
+			}
+		}
+	} else if(rc == CASS_OK && throttle->limit < throttle->max_limit &&
+		++throttle->successes >= throttle->limit) {
+		throttle->limit++;
+		throttle->successes = 0;
+	}
+
+	pthread_cond_broadcast(&throttle->slot_freed);
+	pthread_mutex_unlock(&throttle->lock);
+}
+
+void load_throttle_report(const LoadThrottle* throttle) {
+	printf("Concurrency limit %d of %d at the end (lowest %d, reduced %ld times); %.3f seconds waiting on rate limits.\n",
+		throttle->limit, throttle->max_limit, throttle->min_seen, throttle->reductions,
+		throttle->rate_wait_nanos / 1e9);
+}
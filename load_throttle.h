@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2014 DataStax
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/*
+  Keeps a load from crowding out other users of the cluster. One throttle
+  is shared by all loader threads and applies two limits:
+
+  - Rate: token buckets for rows/sec and bytes/sec. Callers may overdraw a
+    bucket and then sleep until it is paid back, so a large batch is never
+    starved by smaller ones.
+
+  - Concurrency: at most limit requests in flight. limit starts at
+    max_in_flight, halves when a request fails with a write timeout,
+    overloaded or client side timeout, and grows by one per limit
+    successful requests (AIMD). Only requests sent after a reduction can
+    reduce it again, so one burst of timeouts counts once.
+*/
+
+#ifndef LOAD_THROTTLE_H
+#define LOAD_THROTTLE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+
+struct TokenBucket_ {
+	double			rate;		/* tokens per second, 0 for no limit */
+	double			burst;
+	double			tokens;
+	long long		updated;
+} ;
+
+typedef struct TokenBucket_ TokenBucket;
+
+struct LoadThrottle_ {
+	pthread_mutex_t	lock;
+	pthread_cond_t	slot_freed;
+	TokenBucket		rows;
+	TokenBucket		bytes;
+
+	int				in_flight;
+	int				limit;
+	int				max_limit;
+	long			completions;
+	long			successes;			/* since limit last grew */
+	long			reduce_after;		/* completions before another reduction counts */
+
+	long			reductions;
+	int				min_seen;
+	long long		rate_wait_nanos;
+} ;
+
+typedef struct LoadThrottle_ LoadThrottle;
+
+/* A rate of 0 disables that bucket. Returns 0 or -1. */
+int load_throttle_init(LoadThrottle* throttle, double rows_per_sec, double bytes_per_sec, int max_in_flight);
+
+void load_throttle_destroy(LoadThrottle* throttle);
+
+/* Takes rows and bytes from the buckets, sleeping if they are overdrawn. */
+void load_throttle_rate(LoadThrottle* throttle, long rows, size_t bytes);
+
+/* Blocks while limit requests are in flight. */
+void load_throttle_begin(LoadThrottle* throttle);
+
+/* Ends a request started with load_throttle_begin and adapts limit to rc. */
+void load_throttle_end(LoadThrottle* throttle, CassError rc);
+
+void load_throttle_report(const LoadThrottle* throttle);
+
+#endif /* LOAD_THROTTLE_H */